@@ -1,6 +1,9 @@
 
 #include <stdlib.h>
+#include <string.h>
 #include "alloc.h"
+#include "arena.h"
+#include "pool.h"
 
 //
 // cstdlib allocator wrapper functions
@@ -45,3 +48,106 @@ allocator get_std_alloc() {
 
   return result;
 }
+
+//
+// arena allocator wrapper functions
+//
+
+void* arena_alloc_wrapper(void* data, size_type size) {
+  void* result = arena_alloc((arena)data, size);
+
+  return result;
+}
+
+void arena_free_wrapper(void*, void*) {
+  ; //no-op, memory is released by pop
+}
+
+void* arena_realloc_wrapper(void* data, void* ptr, size_type new_size) {
+  arena a = (arena)data;
+  u8* arena_byte_ptr = (u8*)a;
+
+  if(ptr == 0)
+    return arena_alloc(a, new_size);
+
+  usize ptr_offset = (usize)((u8*)ptr - arena_byte_ptr);
+
+  // the last region is resized in place by arena_realloc
+
+  if(ptr_offset == a->last)
+    return arena_realloc(a, ptr, new_size);
+
+  // otherwise move it, everything between ptr and the tail is arena memory
+  // so copying up to the new size is safe even without knowing the old size
+
+  usize old_size_bound = a->tail - ptr_offset;
+  void* result = arena_alloc(a, new_size);
+
+  memcpy(result, ptr, MINIMUM(old_size_bound, (usize)new_size));
+
+  return result;
+}
+
+void arena_push_wrapper(void* data) {
+  arena_push((arena)data);
+}
+
+void arena_pop_wrapper(void* data) {
+  arena_pop((arena)data);
+}
+
+allocator_interface arena_alloc_impl =
+  {
+    arena_alloc_wrapper,
+    arena_free_wrapper,
+    arena_realloc_wrapper,
+    arena_push_wrapper,
+    arena_pop_wrapper
+  };
+
+extern
+allocator get_arena_alloc(arena a) {
+  allocator result = { &arena_alloc_impl, (void*)a };
+
+  return result;
+}
+
+//
+// pool allocator wrapper functions
+//
+
+void* pool_alloc_wrapper(void* data, size_type size) {
+  void* result = pool_alloc((pool*)data, size);
+
+  return result;
+}
+
+void pool_free_wrapper(void* data, void* ptr) {
+  pool_free((pool*)data, ptr);
+}
+
+void* pool_realloc_wrapper(void* data, void* ptr, size_type new_size) {
+  void* result = pool_realloc((pool*)data, ptr, new_size);
+
+  return result;
+}
+
+void pool_push_and_pop_wrapper(void*) {
+  ; //no-op
+}
+
+allocator_interface pool_alloc_impl =
+  {
+    pool_alloc_wrapper,
+    pool_free_wrapper,
+    pool_realloc_wrapper,
+    pool_push_and_pop_wrapper,
+    pool_push_and_pop_wrapper
+  };
+
+extern
+allocator get_pool_alloc(pool* p) {
+  allocator result = { &pool_alloc_impl, (void*)p };
+
+  return result;
+}
@@ -5,6 +5,11 @@
 #include "types.h"
 #include "macro.h"
 
+// arena.h and pool.h, only the pointer types are needed here
+
+typedef struct arena_head* arena;
+struct pool;
+
 // allocator function-pointer type aliases
 
 typedef FPTR(alloc_fptr, void*, void*, size_type);
@@ -67,4 +72,14 @@ allocator get_std_alloc();
 extern
 allocator std_alloc;
 
+// allocator view of an arena, free is a no-op and push/pop map to arena_push/arena_pop
+
+extern
+allocator get_arena_alloc(arena a);
+
+// allocator view of a pool, push/pop are no-ops
+
+extern
+allocator get_pool_alloc(pool* p);
+
 #endif
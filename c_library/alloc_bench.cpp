@@ -0,0 +1,517 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "arena.h"
+#include "pool.h"
+#include "array_u32.h"
+#include "array_u32_filter.h"
+#include "array_u32_generate.h"
+#include "array_u32_scan.h"
+#include "parallel.h"
+#include "bench.h"
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+// replays allocation patterns of the compiler and the array code through
+// each allocator, on one thread and on all threads (one allocator instance
+// per thread, std shares malloc):
+//
+//   tokens       - a growing token array plus a small string per token
+//   ast          - tree nodes kept until the end, with push/pop scratch scopes per function
+//   arrays       - array_u32 temporaries of an expression, freed per round
+//   random_free  - allocations of mixed sizes freed in random order
+//
+// memory use is the peak of the bytes requested and not yet freed against
+// the growth of the resident set over a run on fresh allocator instances;
+// with glibc the memory malloc keeps after free is trimmed before each
+// measurement, elsewhere it makes the rss of later cases look smaller
+//
+// usage: alloc_bench [--filter substring] [--reps n] [--cpu n] [--json path]
+
+#define ALLOC_BENCH_THREAD_ARENA (512ULL << 20)
+
+#define TOKEN_COUNT          200000U
+#define AST_FUNCTION_COUNT   64U
+#define AST_NODES_PER_FUNC   2000U
+#define ARRAY_ROUNDS         16U
+#define ARRAY_COUNT          65536U
+#define RANDOM_OPS           200000U
+#define RANDOM_SLOTS         16384U
+#define RANDOM_WORDS         (1U << 20) // Philox words the patterns draw from, more than a run uses
+
+static bench_state state;
+
+enum alloc_kind_enum {
+  alloc_kind_std,
+  alloc_kind_arena_raw, // arena_alloc called directly, not through allocator_interface
+  alloc_kind_arena,
+  alloc_kind_pool,
+  alloc_kind_count,
+};
+
+inline
+cstring alloc_kind_name(u32 kind) {
+  switch(kind) {
+    case alloc_kind_std:       return "std";
+    case alloc_kind_arena_raw: return "arena_raw";
+    case alloc_kind_arena:     return "arena";
+    default:                   return "pool";
+  }
+}
+
+//
+// the patterns are templates over an allocator or a raw arena
+//
+
+inline void* pattern_alloc(allocator a, usize size) { return cpeak_alloc(a, size); }
+inline void* pattern_alloc(arena a, usize size)     { return arena_alloc(a, size); }
+
+inline void pattern_free(allocator a, void* ptr) { cpeak_free(a, ptr); }
+inline void pattern_free(arena, void*)           { ; }
+
+inline void pattern_push(allocator a) { cpeak_push(a); }
+inline void pattern_push(arena a)     { arena_push(a); }
+
+inline void pattern_pop(allocator a) { cpeak_pop(a); }
+inline void pattern_pop(arena a)     { arena_pop(a); }
+
+inline
+void* pattern_realloc(allocator a, void* ptr, usize, usize new_size) {
+  return cpeak_realloc(a, ptr, new_size);
+}
+
+// arena_realloc only grows the last allocation in place, anything else is a fresh allocation
+
+inline
+void* pattern_realloc(arena a, void* ptr, usize old_size, usize new_size) {
+  void* result = arena_realloc(a, ptr, new_size);
+
+  if(ptr && result != ptr)
+    memcpy(result, ptr, old_size);
+
+  return result;
+}
+
+inline allocator pattern_allocator(allocator a) { return a; }
+inline allocator pattern_allocator(arena a)     { return get_arena_alloc(a); }
+
+typedef struct pattern_stats {
+  usize live;      // bytes requested and not yet freed
+  usize peak_live;
+  usize peak_rss;
+  bool  sample_rss;
+} pattern_stats;
+
+inline
+pattern_stats make_pattern_stats(bool sample_rss) {
+  pattern_stats result = { 0U, 0U, 0U, sample_rss };
+
+  return result;
+}
+
+inline
+void stats_alloc(pattern_stats* s, usize size) {
+  s->live += size;
+  s->peak_live = MAXIMUM(s->peak_live, s->live);
+}
+
+inline
+void stats_free(pattern_stats* s, usize size) {
+  s->live -= size;
+}
+
+inline
+void stats_sample(pattern_stats* s) {
+  if(s->sample_rss)
+    s->peak_rss = MAXIMUM(s->peak_rss, bench_current_rss());
+}
+
+// the patterns draw from a table made once by random_u32, so that a draw
+// in the timed loops is two loads; *state is the position in the table
+
+static array_u32 pattern_words;
+
+inline
+u64 pattern_random(u64* state) {
+  u64 i = 2U * (*state)++;
+
+  return ((u64)pattern_words.ptr[i % RANDOM_WORDS] << 32) | pattern_words.ptr[(i + 1U) % RANDOM_WORDS];
+}
+
+typedef struct bench_token {
+  u32   tag;
+  u32   length;
+  char* text;
+} bench_token;
+
+template <typename A>
+inline
+void pattern_tokens(A a, pattern_stats* s, u64 seed) {
+  size_type capacity = 256U;
+  bench_token* tokens;
+
+  pattern_push(a);
+
+  tokens = (bench_token*)pattern_realloc(a, 0, 0U, capacity * sizeof(bench_token));
+  stats_alloc(s, capacity * sizeof(bench_token));
+
+  for(size_type i = 0; i < TOKEN_COUNT; ++i) {
+    if(i == capacity) {
+      tokens = (bench_token*)pattern_realloc(a, tokens, capacity * sizeof(bench_token), 2U * capacity * sizeof(bench_token));
+      stats_alloc(s, capacity * sizeof(bench_token));
+      capacity *= 2U;
+    }
+
+    u32 length = 1U + (u32)(pattern_random(&seed) & 15U);
+
+    tokens[i].tag    = (u32)i & 31U;
+    tokens[i].length = length;
+    tokens[i].text   = (char*)pattern_alloc(a, length + 1U);
+
+    memset(tokens[i].text, 'a' + (int)(i % 26U), length);
+    tokens[i].text[length] = 0;
+    stats_alloc(s, length + 1U);
+  }
+
+  stats_sample(s);
+
+  for(size_type i = 0; i < TOKEN_COUNT; ++i) {
+    stats_free(s, tokens[i].length + 1U);
+    pattern_free(a, tokens[i].text);
+  }
+
+  stats_free(s, capacity * sizeof(bench_token));
+  pattern_free(a, tokens);
+  pattern_pop(a);
+}
+
+typedef struct bench_node {
+  struct bench_node* first_child;
+  struct bench_node* next_sibling;
+  struct bench_node* next_allocated;
+  u32                kind;
+  u32                size;
+} bench_node;
+
+template <typename A>
+inline
+void pattern_ast(A a, pattern_stats* s, u64 seed) {
+  bench_node* allocated = 0;
+
+  pattern_push(a);
+
+  for(u32 f = 0U; f < AST_FUNCTION_COUNT; ++f) {
+    bench_node* function_nodes[AST_NODES_PER_FUNC];
+
+    for(u32 i = 0U; i < AST_NODES_PER_FUNC; ++i) {
+      u64 r = pattern_random(&seed);
+      u32 size = (u32)sizeof(bench_node) + 8U * (u32)(r & 7U);
+
+      bench_node* node = (bench_node*)pattern_alloc(a, size);
+      stats_alloc(s, size);
+
+      node->first_child    = 0;
+      node->next_allocated = allocated;
+      node->kind           = (u32)(r >> 8) & 63U;
+      node->size           = size;
+      allocated = node;
+
+      // attach to one of the recent nodes, trees are mostly shallow and wide
+
+      if(i > 0U) {
+        bench_node* parent = function_nodes[i - 1U - (u32)((r >> 16) % MINIMUM(i, 8U))];
+
+        node->next_sibling = parent->first_child;
+        parent->first_child = node;
+      } else {
+        node->next_sibling = 0;
+      }
+
+      function_nodes[i] = node;
+    }
+
+    // scratch memory of the checks on the function, gone after them
+
+    pattern_push(a);
+
+    usize table_size = AST_NODES_PER_FUNC * sizeof(bench_node*);
+    bench_node** table = (bench_node**)pattern_alloc(a, table_size);
+    stats_alloc(s, table_size);
+
+    for(u32 i = 0U; i < AST_NODES_PER_FUNC; ++i)
+      table[i] = function_nodes[AST_NODES_PER_FUNC - 1U - i];
+
+    void* scratch[16];
+
+    for(u32 i = 0U; i < 16U; ++i) {
+      scratch[i] = pattern_alloc(a, 32U + 16U * i);
+      stats_alloc(s, 32U + 16U * i);
+    }
+
+    for(u32 i = 0U; i < 16U; ++i) {
+      stats_free(s, 32U + 16U * i);
+      pattern_free(a, scratch[15U - i]);
+    }
+
+    stats_free(s, table_size);
+    pattern_free(a, table);
+
+    pattern_pop(a);
+  }
+
+  stats_sample(s);
+
+  while(allocated) {
+    bench_node* next = allocated->next_allocated;
+
+    stats_free(s, allocated->size);
+    pattern_free(a, allocated);
+    allocated = next;
+  }
+
+  pattern_pop(a);
+}
+
+template <typename A>
+inline
+void pattern_arrays(A pa, pattern_stats* s, u64 seed) {
+  allocator a = pattern_allocator(pa);
+  usize array_size = ARRAY_COUNT * sizeof(u32);
+
+  cpeak_push(a);
+
+  array_u32 x = random_u32(a, ARRAY_COUNT, seed);
+  array_u32 y = random_u32(a, ARRAY_COUNT, seed + 1U);
+  stats_alloc(s, 2U * array_size);
+
+  for(u32 round = 0U; round < ARRAY_ROUNDS; ++round) {
+    cpeak_push(a);
+
+    array_u32 t1 = add(a, x, y);
+    array_u32 t2 = mul(a, t1, 3U);
+    bitset mask  = compare<compare_op_lt>(a, t2, x.ptr, 1U, ARRAY_COUNT);
+    array_u32 t3 = compress(a, t2, mask);
+    array_u32 t4 = inclusive_scan(a, t3);
+
+    usize mask_size = bitset_word_count(mask.count) * sizeof(u64);
+    usize live = 2U * array_size + mask_size + 2U * t3.count * sizeof(u32);
+
+    stats_alloc(s, live);
+
+    if(round == 0U)
+      stats_sample(s);
+
+    bench_do_not_optimize(t4.ptr);
+
+    cpeak_free(a, t4.ptr);
+    cpeak_free(a, t3.ptr);
+    cpeak_free(a, mask.words);
+    cpeak_free(a, t2.ptr);
+    cpeak_free(a, t1.ptr);
+    stats_free(s, live);
+
+    cpeak_pop(a);
+  }
+
+  cpeak_free(a, y.ptr);
+  cpeak_free(a, x.ptr);
+  stats_free(s, 2U * array_size);
+
+  cpeak_pop(a);
+}
+
+template <typename A>
+inline
+void pattern_random_free(A a, pattern_stats* s, u64 seed) {
+  pattern_push(a);
+
+  void** slots = (void**)pattern_alloc(a, RANDOM_SLOTS * sizeof(void*));
+  u32*   sizes = (u32*)pattern_alloc(a, RANDOM_SLOTS * sizeof(u32));
+
+  memset(slots, 0, RANDOM_SLOTS * sizeof(void*));
+
+  for(u32 i = 0U; i < RANDOM_OPS; ++i) {
+    u64 r = pattern_random(&seed);
+    u32 slot = (u32)(r % RANDOM_SLOTS);
+
+    if(slots[slot]) {
+      stats_free(s, sizes[slot]);
+      pattern_free(a, slots[slot]);
+      slots[slot] = 0;
+    } else {
+      // 16 bytes to 2 KB, roughly log-uniform
+      u32 size = (16U << ((r >> 32) % 8U)) + (u32)((r >> 40) & 15U);
+
+      slots[slot] = pattern_alloc(a, size);
+      sizes[slot] = size;
+      *(u8*)slots[slot] = (u8)i;
+      stats_alloc(s, size);
+    }
+
+    if((i & 16383U) == 0U)
+      stats_sample(s);
+  }
+
+  for(u32 slot = 0U; slot < RANDOM_SLOTS; ++slot) {
+    if(slots[slot]) {
+      stats_free(s, sizes[slot]);
+      pattern_free(a, slots[slot]);
+    }
+  }
+
+  pattern_free(a, sizes);
+  pattern_free(a, slots);
+  pattern_pop(a);
+}
+
+//
+// running a pattern on 'thread_count' threads with one allocator instance each
+//
+
+typedef struct alloc_instances {
+  arena arenas[PARALLEL_MAX_THREADS];
+  pool  pools[PARALLEL_MAX_THREADS];
+} alloc_instances;
+
+static alloc_instances instances;
+
+inline
+void init_instances(u32 kind, u32 thread_count) {
+  for(u32 t = 0U; t < thread_count; ++t) {
+    if(kind == alloc_kind_arena || kind == alloc_kind_arena_raw)
+      instances.arenas[t] = make_system_arena(ALLOC_BENCH_THREAD_ARENA);
+
+    if(kind == alloc_kind_pool)
+      instances.pools[t] = make_pool();
+  }
+}
+
+inline
+void free_instances(u32 kind, u32 thread_count) {
+  for(u32 t = 0U; t < thread_count; ++t) {
+    if(kind == alloc_kind_arena || kind == alloc_kind_arena_raw)
+      free_system_arena(instances.arenas[t]);
+
+    if(kind == alloc_kind_pool)
+      free_pool(&instances.pools[t]);
+  }
+}
+
+template <typename Pattern>
+inline
+void run_pattern(u32 kind, u32 thread_count, pattern_stats* stats, bool sample_rss, Pattern pattern) {
+  parallel_run(thread_count, [&](u32 t) {
+    u64 seed = (u64)t * (RANDOM_WORDS / PARALLEL_MAX_THREADS / 2U); // every thread starts at its own place in the table
+
+    stats[t] = make_pattern_stats(sample_rss);
+
+    switch(kind) {
+      case alloc_kind_std:       pattern(std_alloc, &stats[t], seed); break;
+      case alloc_kind_arena_raw: pattern(instances.arenas[t], &stats[t], seed); break;
+      case alloc_kind_arena:     pattern(get_arena_alloc(instances.arenas[t]), &stats[t], seed); break;
+      default:                   pattern(get_pool_alloc(&instances.pools[t]), &stats[t], seed); break;
+    }
+  });
+}
+
+// returns the memory malloc keeps after free to the system where possible
+
+inline
+void release_free_memory() {
+#if defined(__GLIBC__)
+  malloc_trim(0);
+#endif
+}
+
+// runs the pattern once on fresh allocator instances to record its memory use, then times it
+
+template <typename Pattern>
+inline
+void bench_pattern(cstring pattern_name, u64 allocations, u32 kind, u32 thread_count, Pattern pattern) {
+  char name[BENCH_NAME_SIZE];
+  pattern_stats stats[PARALLEL_MAX_THREADS];
+
+  snprintf(name, BENCH_NAME_SIZE, "%s/%s/t%u", pattern_name, alloc_kind_name(kind), thread_count);
+
+  if(!bench_selected(&state, name))
+    return;
+
+  init_instances(kind, thread_count);
+  release_free_memory();
+
+  usize rss_before = bench_current_rss();
+
+  run_pattern(kind, thread_count, stats, true, pattern);
+
+  usize peak_live = 0U;
+  usize peak_rss = rss_before;
+
+  for(u32 t = 0U; t < thread_count; ++t) {
+    peak_live += stats[t].peak_live;
+    peak_rss = MAXIMUM(peak_rss, stats[t].peak_rss);
+  }
+
+  bench_run(&state, name, allocations * thread_count, 0U, [&]() {
+    run_pattern(kind, thread_count, stats, false, pattern);
+  });
+
+  bench_record_memory(&state, name, peak_live, peak_rss - rss_before);
+
+  free_instances(kind, thread_count);
+  release_free_memory();
+}
+
+void bench_patterns(u32 thread_count) {
+  for(u32 kind = 0U; kind < alloc_kind_count; ++kind) {
+    bench_pattern("tokens", TOKEN_COUNT, kind, thread_count,
+                  [](auto a, pattern_stats* s, u64 seed) { pattern_tokens(a, s, seed); });
+    bench_pattern("ast", AST_FUNCTION_COUNT * (AST_NODES_PER_FUNC + 17U), kind, thread_count,
+                  [](auto a, pattern_stats* s, u64 seed) { pattern_ast(a, s, seed); });
+    bench_pattern("arrays", ARRAY_ROUNDS * 5U, kind, thread_count,
+                  [](auto a, pattern_stats* s, u64 seed) { pattern_arrays(a, s, seed); });
+    bench_pattern("random_free", RANDOM_OPS, kind, thread_count,
+                  [](auto a, pattern_stats* s, u64 seed) { pattern_random_free(a, s, seed); });
+  }
+}
+
+int main(int argc, char** argv) {
+  bench_config config = default_bench_config();
+  cstring json_path = 0;
+
+  config.reps = 7U;
+
+  if(!bench_parse_args(argc, argv, &config, &json_path))
+    return 1;
+
+  bench_init(&state, config);
+
+  pattern_words = random_u32(std_alloc, RANDOM_WORDS, 0x9E3779B97F4A7C15ULL);
+
+  u32 thread_count = parallel_default_thread_count();
+
+  bench_patterns(1U);
+
+  if(thread_count > 1U)
+    bench_patterns(thread_count);
+
+  printf("peak rss: %.2f MB\n", bench_peak_rss() / 1048576.0);
+
+  if(json_path) {
+    FILE* f = fopen(json_path, "w");
+
+    if(f) {
+      bench_write_json(&state, f);
+      fclose(f);
+    } else {
+      printf("can't write %s\n", json_path);
+    }
+  }
+
+  bench_finish(&state);
+
+  return 0;
+}
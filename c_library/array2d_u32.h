@@ -0,0 +1,479 @@
+/**
+ *  array2d_u32.h
+ *
+ *  Row-major 2D views over u32 storage.
+ *
+ *  An array2d_u32 is rows x cols elements where row r starts at
+ *  ptr + r * row_stride, so a sub-block of a matrix is a view of the same
+ *  storage with the parent's row stride.
+ *
+ *  transpose       - blocked transpose: the matrix is walked in blocks of
+ *                    TRANSPOSE_BLOCK x TRANSPOSE_BLOCK whose source and
+ *                    destination both stay in cache, each block is
+ *                    transposed as 8x8 (AVX2) or 4x4 (SSE2) register tiles
+ *  for_each_tiled  - visits the elements tile by tile
+ *  reduce_rows     - sum/min/max of every row
+ *  reduce_cols     - sum/min/max of every column, computed row by row
+ *                    into a row of accumulators so that memory is still
+ *                    read sequentially
+ *
+ *  Sums wrap mod 2^32 like the rest of array_u32.
+ */
+
+#ifndef U32_ARRAY2D_H
+#define U32_ARRAY2D_H
+
+#include <assert.h>
+#include <stdio.h>
+#include "types.h"
+#include "macro.h"
+#include "alloc.h"
+#include "simd.h"
+#include "array_u32.h"
+
+#define TRANSPOSE_BLOCK 64U
+
+typedef struct array2d_u32 {
+  u32*      ptr;
+  size_type rows;
+  size_type cols;
+  size_type row_stride;
+} array2d_u32;
+
+enum reduce_op_enum {
+  reduce_op_sum,
+  reduce_op_min,
+  reduce_op_max,
+};
+
+inline
+array2d_u32 make_array2d_u32(allocator a, size_type rows, size_type cols) {
+  array2d_u32 result;
+
+  result.ptr        = (u32*)cpeak_alloc(a, rows * cols * sizeof(u32));
+  result.rows       = rows;
+  result.cols       = cols;
+  result.row_stride = cols;
+
+  return result;
+}
+
+// the first rows * cols elements of arr as a matrix
+
+inline
+array2d_u32 view_2d(array_u32 arr, size_type rows, size_type cols) {
+  array2d_u32 result;
+
+  assert((u64)rows * cols <= (u64)arr.count);
+
+  result.ptr        = arr.ptr;
+  result.rows       = rows;
+  result.cols       = cols;
+  result.row_stride = cols;
+
+  return result;
+}
+
+inline
+array2d_u32 sub_view(array2d_u32 m, size_type row, size_type col, size_type rows, size_type cols) {
+  array2d_u32 result;
+
+  assert(row + rows <= m.rows && col + cols <= m.cols);
+
+  result.ptr        = m.ptr + row * m.row_stride + col;
+  result.rows       = rows;
+  result.cols       = cols;
+  result.row_stride = m.row_stride;
+
+  return result;
+}
+
+inline
+u32* at(array2d_u32 m, size_type row, size_type col) {
+  assert(row < m.rows && col < m.cols);
+
+  return m.ptr + row * m.row_stride + col;
+}
+
+inline
+array_u32 row(array2d_u32 m, size_type r) {
+  array_u32 result;
+
+  assert(r < m.rows);
+
+  result.ptr   = m.ptr + r * m.row_stride;
+  result.count = m.cols;
+
+  return result;
+}
+
+inline
+array_slice_u32 column(array2d_u32 m, size_type c) {
+  array_slice_u32 result;
+
+  assert(c < m.cols);
+
+  result.ptr   = m.ptr + c;
+  result.count = m.rows;
+  result.step  = (index_type)m.row_stride;
+
+  return result;
+}
+
+inline
+void print(array2d_u32 m) {
+  printf("[");
+
+  for(size_type r = 0; r < m.rows; ++r) {
+    if(r != 0U)
+      printf(",\n ");
+
+    print(row(m, r));
+  }
+
+  printf("]");
+}
+
+//
+// transpose
+//
+
+#if defined(CPEAK_AVX2)
+inline
+void transpose_8x8_avx2(u32* dest, size_type dest_stride, const u32* src, size_type src_stride) {
+  __m256i r0 = _mm256_loadu_si256((const __m256i*)(src + 0U * src_stride));
+  __m256i r1 = _mm256_loadu_si256((const __m256i*)(src + 1U * src_stride));
+  __m256i r2 = _mm256_loadu_si256((const __m256i*)(src + 2U * src_stride));
+  __m256i r3 = _mm256_loadu_si256((const __m256i*)(src + 3U * src_stride));
+  __m256i r4 = _mm256_loadu_si256((const __m256i*)(src + 4U * src_stride));
+  __m256i r5 = _mm256_loadu_si256((const __m256i*)(src + 5U * src_stride));
+  __m256i r6 = _mm256_loadu_si256((const __m256i*)(src + 6U * src_stride));
+  __m256i r7 = _mm256_loadu_si256((const __m256i*)(src + 7U * src_stride));
+
+  // pairs of rows interleaved: [a0, b0, a1, b1 | a4, b4, a5, b5]
+  __m256i t0 = _mm256_unpacklo_epi32(r0, r1);
+  __m256i t1 = _mm256_unpackhi_epi32(r0, r1);
+  __m256i t2 = _mm256_unpacklo_epi32(r2, r3);
+  __m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+  __m256i t4 = _mm256_unpacklo_epi32(r4, r5);
+  __m256i t5 = _mm256_unpackhi_epi32(r4, r5);
+  __m256i t6 = _mm256_unpacklo_epi32(r6, r7);
+  __m256i t7 = _mm256_unpackhi_epi32(r6, r7);
+
+  // quads: [a0, b0, c0, d0 | a4, b4, c4, d4]
+  __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+  __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+  __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+  __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+  __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+  __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+  __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+  __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+  _mm256_storeu_si256((__m256i*)(dest + 0U * dest_stride), _mm256_permute2x128_si256(u0, u4, 0x20));
+  _mm256_storeu_si256((__m256i*)(dest + 1U * dest_stride), _mm256_permute2x128_si256(u1, u5, 0x20));
+  _mm256_storeu_si256((__m256i*)(dest + 2U * dest_stride), _mm256_permute2x128_si256(u2, u6, 0x20));
+  _mm256_storeu_si256((__m256i*)(dest + 3U * dest_stride), _mm256_permute2x128_si256(u3, u7, 0x20));
+  _mm256_storeu_si256((__m256i*)(dest + 4U * dest_stride), _mm256_permute2x128_si256(u0, u4, 0x31));
+  _mm256_storeu_si256((__m256i*)(dest + 5U * dest_stride), _mm256_permute2x128_si256(u1, u5, 0x31));
+  _mm256_storeu_si256((__m256i*)(dest + 6U * dest_stride), _mm256_permute2x128_si256(u2, u6, 0x31));
+  _mm256_storeu_si256((__m256i*)(dest + 7U * dest_stride), _mm256_permute2x128_si256(u3, u7, 0x31));
+}
+
+#define TRANSPOSE_TILE 8U
+
+inline
+void transpose_tile(u32* dest, size_type dest_stride, const u32* src, size_type src_stride) {
+  transpose_8x8_avx2(dest, dest_stride, src, src_stride);
+}
+#elif defined(CPEAK_SSE2)
+inline
+void transpose_4x4_sse2(u32* dest, size_type dest_stride, const u32* src, size_type src_stride) {
+  __m128i r0 = _mm_loadu_si128((const __m128i*)(src + 0U * src_stride));
+  __m128i r1 = _mm_loadu_si128((const __m128i*)(src + 1U * src_stride));
+  __m128i r2 = _mm_loadu_si128((const __m128i*)(src + 2U * src_stride));
+  __m128i r3 = _mm_loadu_si128((const __m128i*)(src + 3U * src_stride));
+
+  __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+  __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+  __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+  __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+  _mm_storeu_si128((__m128i*)(dest + 0U * dest_stride), _mm_unpacklo_epi64(t0, t1));
+  _mm_storeu_si128((__m128i*)(dest + 1U * dest_stride), _mm_unpackhi_epi64(t0, t1));
+  _mm_storeu_si128((__m128i*)(dest + 2U * dest_stride), _mm_unpacklo_epi64(t2, t3));
+  _mm_storeu_si128((__m128i*)(dest + 3U * dest_stride), _mm_unpackhi_epi64(t2, t3));
+}
+
+#define TRANSPOSE_TILE 4U
+
+inline
+void transpose_tile(u32* dest, size_type dest_stride, const u32* src, size_type src_stride) {
+  transpose_4x4_sse2(dest, dest_stride, src, src_stride);
+}
+#endif
+
+// dest[c][r] = src[r][c] for the block [row, row_end) x [col, col_end)
+
+inline
+void transpose_block(array2d_u32 dest, array2d_u32 src, size_type row, size_type row_end, size_type col, size_type col_end) {
+  size_type r = row;
+
+#if defined(TRANSPOSE_TILE)
+  for(; r + TRANSPOSE_TILE <= row_end; r += TRANSPOSE_TILE) {
+    size_type c = col;
+
+    for(; c + TRANSPOSE_TILE <= col_end; c += TRANSPOSE_TILE) {
+      transpose_tile(dest.ptr + c * dest.row_stride + r, dest.row_stride, src.ptr + r * src.row_stride + c, src.row_stride);
+    }
+
+    for(; c < col_end; ++c) {
+      for(size_type i = r; i < r + TRANSPOSE_TILE; ++i)
+        dest.ptr[c * dest.row_stride + i] = src.ptr[i * src.row_stride + c];
+    }
+  }
+#endif
+
+  for(; r < row_end; ++r) {
+    for(size_type c = col; c < col_end; ++c)
+      dest.ptr[c * dest.row_stride + r] = src.ptr[r * src.row_stride + c];
+  }
+}
+
+// precondition: dest is src.cols x src.rows and doesn't overlap src
+
+inline
+void transpose_into(array2d_u32 dest, array2d_u32 src) {
+  assert(dest.rows == src.cols && dest.cols == src.rows);
+
+  for(size_type r = 0; r < src.rows; r += TRANSPOSE_BLOCK) {
+    size_type row_end = MINIMUM(r + TRANSPOSE_BLOCK, src.rows);
+
+    for(size_type c = 0; c < src.cols; c += TRANSPOSE_BLOCK) {
+      transpose_block(dest, src, r, row_end, c, MINIMUM(c + TRANSPOSE_BLOCK, src.cols));
+    }
+  }
+}
+
+inline
+array2d_u32 transpose(allocator a, array2d_u32 m) {
+  array2d_u32 result = make_array2d_u32(a, m.cols, m.rows);
+
+  transpose_into(result, m);
+
+  return result;
+}
+
+//
+// traversal
+//
+
+// calls op(u32* element, size_type row, size_type col) row by row
+
+template <typename Op>
+inline
+void for_each(array2d_u32 m, Op op) {
+  for(size_type r = 0; r < m.rows; ++r) {
+    u32* p = m.ptr + r * m.row_stride;
+
+    for(size_type c = 0; c < m.cols; ++c)
+      op(p + c, r, c);
+  }
+}
+
+// calls op(u32* element, size_type row, size_type col) for every tile_rows x tile_cols tile in turn,
+// row by row within a tile
+
+template <typename Op>
+inline
+void for_each_tiled(array2d_u32 m, size_type tile_rows, size_type tile_cols, Op op) {
+  assert(tile_rows != 0U && tile_cols != 0U);
+
+  for(size_type tr = 0; tr < m.rows; tr += tile_rows) {
+    size_type row_end = MINIMUM(tr + tile_rows, m.rows);
+
+    for(size_type tc = 0; tc < m.cols; tc += tile_cols) {
+      size_type col_end = MINIMUM(tc + tile_cols, m.cols);
+
+      for(size_type r = tr; r < row_end; ++r) {
+        u32* p = m.ptr + r * m.row_stride;
+
+        for(size_type c = tc; c < col_end; ++c)
+          op(p + c, r, c);
+      }
+    }
+  }
+}
+
+//
+// reductions
+//
+
+template <u32 Op>
+inline
+u32 reduce_scalar(u32 x, u32 y) {
+  switch(Op) {
+    case reduce_op_sum: return x + y;
+    case reduce_op_min: return MINIMUM(x, y);
+    default:            return MAXIMUM(x, y);
+  }
+}
+
+template <u32 Op>
+inline
+u32 reduce_identity() {
+  switch(Op) {
+    case reduce_op_sum: return 0U;
+    case reduce_op_min: return 0xFFFFFFFFU;
+    default:            return 0U;
+  }
+}
+
+#if defined(CPEAK_AVX2)
+template <u32 Op>
+inline
+__m256i reduce_avx2(__m256i x, __m256i y) {
+  switch(Op) {
+    case reduce_op_sum: return _mm256_add_epi32(x, y);
+    case reduce_op_min: return _mm256_min_epu32(x, y);
+    default:            return _mm256_max_epu32(x, y);
+  }
+}
+#endif
+
+#if defined(CPEAK_SSE2)
+// unsigned min/max from a biased signed compare
+
+template <u32 Op>
+inline
+__m128i reduce_sse2(__m128i x, __m128i y) {
+  __m128i bias = _mm_set1_epi32((int)0x80000000U);
+  __m128i x_greater = _mm_cmpgt_epi32(_mm_xor_si128(x, bias), _mm_xor_si128(y, bias));
+
+  switch(Op) {
+    case reduce_op_sum: return _mm_add_epi32(x, y);
+    case reduce_op_min: return _mm_or_si128(_mm_and_si128(x_greater, y), _mm_andnot_si128(x_greater, x));
+    default:            return _mm_or_si128(_mm_and_si128(x_greater, x), _mm_andnot_si128(x_greater, y));
+  }
+}
+#endif
+
+// acc[i] = op(acc[i], x[i])
+
+template <u32 Op>
+inline
+void reduce_accumulate(u32* acc, const u32* x, size_type count) {
+  size_type i = 0;
+
+#if defined(CPEAK_AVX2)
+  for(; i + 8U <= count; i += 8U) {
+    __m256i v = reduce_avx2<Op>(_mm256_loadu_si256((const __m256i*)(acc + i)), _mm256_loadu_si256((const __m256i*)(x + i)));
+
+    _mm256_storeu_si256((__m256i*)(acc + i), v);
+  }
+#elif defined(CPEAK_SSE2)
+  for(; i + 4U <= count; i += 4U) {
+    __m128i v = reduce_sse2<Op>(_mm_loadu_si128((const __m128i*)(acc + i)), _mm_loadu_si128((const __m128i*)(x + i)));
+
+    _mm_storeu_si128((__m128i*)(acc + i), v);
+  }
+#endif
+
+  for(; i < count; ++i) {
+    acc[i] = reduce_scalar<Op>(acc[i], x[i]);
+  }
+}
+
+// op over all of x
+
+template <u32 Op>
+inline
+u32 reduce_all(const u32* x, size_type count) {
+  size_type i = 0;
+  u32 result = reduce_identity<Op>();
+
+#if defined(CPEAK_AVX2)
+  if(count >= 8U) {
+    __m256i acc = _mm256_loadu_si256((const __m256i*)x);
+
+    for(i = 8U; i + 8U <= count; i += 8U)
+      acc = reduce_avx2<Op>(acc, _mm256_loadu_si256((const __m256i*)(x + i)));
+
+    u32 lanes[8];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+
+    for(u32 j = 0U; j < 8U; ++j)
+      result = reduce_scalar<Op>(result, lanes[j]);
+  }
+#elif defined(CPEAK_SSE2)
+  if(count >= 4U) {
+    __m128i acc = _mm_loadu_si128((const __m128i*)x);
+
+    for(i = 4U; i + 4U <= count; i += 4U)
+      acc = reduce_sse2<Op>(acc, _mm_loadu_si128((const __m128i*)(x + i)));
+
+    u32 lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+
+    for(u32 j = 0U; j < 4U; ++j)
+      result = reduce_scalar<Op>(result, lanes[j]);
+  }
+#endif
+
+  for(; i < count; ++i) {
+    result = reduce_scalar<Op>(result, x[i]);
+  }
+
+  return result;
+}
+
+template <u32 Op>
+inline
+array_u32 reduce_rows(allocator a, array2d_u32 m) {
+  array_u32 result;
+
+  result.count = m.rows;
+  result.ptr   = (u32*)cpeak_alloc(a, m.rows * sizeof(u32));
+
+  for(size_type r = 0; r < m.rows; ++r)
+    result.ptr[r] = reduce_all<Op>(m.ptr + r * m.row_stride, m.cols);
+
+  return result;
+}
+
+template <u32 Op>
+inline
+array_u32 reduce_cols(allocator a, array2d_u32 m) {
+  array_u32 result;
+
+  result.count = m.cols;
+  result.ptr   = (u32*)cpeak_alloc(a, m.cols * sizeof(u32));
+
+  for(size_type c = 0; c < m.cols; ++c)
+    result.ptr[c] = reduce_identity<Op>();
+
+  for(size_type r = 0; r < m.rows; ++r)
+    reduce_accumulate<Op>(result.ptr, m.ptr + r * m.row_stride, m.cols);
+
+  return result;
+}
+
+inline
+array_u32 reduce_rows(allocator a, array2d_u32 m, u32 op) {
+  switch(op) {
+    case reduce_op_sum: return reduce_rows<reduce_op_sum>(a, m);
+    case reduce_op_min: return reduce_rows<reduce_op_min>(a, m);
+    default:            return reduce_rows<reduce_op_max>(a, m);
+  }
+}
+
+inline
+array_u32 reduce_cols(allocator a, array2d_u32 m, u32 op) {
+  switch(op) {
+    case reduce_op_sum: return reduce_cols<reduce_op_sum>(a, m);
+    case reduce_op_min: return reduce_cols<reduce_op_min>(a, m);
+    default:            return reduce_cols<reduce_op_max>(a, m);
+  }
+}
+
+#endif
@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "array_u32.h"
+#include "array_u32_generate.h"
+#include "array2d_u32.h"
+
+// transpose against the naive loop, element by element
+
+bool same_transpose(array2d_u32 t, array2d_u32 m) {
+  bool result = t.rows == m.cols && t.cols == m.rows;
+
+  for(size_type r = 0; result && r < m.rows; ++r) {
+    for(size_type c = 0; result && c < m.cols; ++c)
+      result = *at(t, c, r) == *at(m, r, c);
+  }
+
+  return result;
+}
+
+int main(int argc, char** argv) {
+  allocator ai = std_alloc;
+
+  array2d_u32 m = view_2d(iota_u32(ai, 6 * 10), 6, 10);
+
+  print(m);
+  printf("\n\n");
+
+  print(transpose(ai, m));
+  printf("\n\n");
+
+  // a view of the inner block shares the storage of m
+  array2d_u32 inner = sub_view(m, 1, 2, 4, 5);
+
+  print(transpose(ai, inner));
+  printf("\n\n");
+
+  print(reduce_rows(ai, m, reduce_op_sum));
+  printf("\n");
+  print(reduce_cols(ai, m, reduce_op_sum));
+  printf("\n");
+  print(reduce_cols(ai, inner, reduce_op_min));
+  printf("\n");
+  print(reduce_rows(ai, inner, reduce_op_max));
+  printf("\n");
+
+  for_each_tiled(m, 4, 4, [](u32* x, size_type r, size_type c) {
+    if(r == c)
+      *x = 0U;
+  });
+
+  for_each(column(m, 3), [](u32* x) {
+    printf("%u ", *x);
+  });
+  printf("\n");
+
+  // sizes that aren't multiples of the 8x8 (AVX2) and 4x4 (SSE2) tiles, a
+  // strided view, and one that spans several TRANSPOSE_BLOCK blocks
+
+  array2d_u32 odd = view_2d(random_u32(ai, 19 * 37, 5U), 19, 37);
+  array2d_u32 big = view_2d(random_u32(ai, 150 * 203, 6U), 150, 203);
+
+  printf("transpose 19x37: %d, 37x19: %d, view 13x29: %d, 150x203: %d\n", same_transpose(transpose(ai, odd), odd),
+         same_transpose(transpose(ai, transpose(ai, odd)), transpose(ai, odd)),
+         same_transpose(transpose(ai, sub_view(odd, 3, 5, 13, 29)), sub_view(odd, 3, 5, 13, 29)),
+         same_transpose(transpose(ai, big), big));
+
+  return 0;
+}
@@ -0,0 +1,321 @@
+/**
+ *  array_file.h
+ *
+ *  On-disk format for arrays, with zero-copy loading through memory mappings.
+ *
+ *  Layout: a 64 byte header followed (at 'data_offset', a multiple of the
+ *  alignment) by the raw little-endian elements. The checksum is a
+ *  Fletcher-style pair of 32-bit running sums over the elements, so it
+ *  can be computed while streaming and verified on demand.
+ *
+ *  Counts are stored as u64. With the default 32-bit size_type a mapping
+ *  can view at most CPEAK_SIZE_TYPE_MAX elements at a time, larger files
+ *  are opened in windows with array_map_u32_range.
+ */
+
+#ifndef CPEAK_ARRAY_FILE_H
+#define CPEAK_ARRAY_FILE_H
+
+#include <stdio.h>
+#include <string.h>
+#include "types.h"
+#include "array_u32.h"
+#include "mapped_file.h"
+
+#define ARRAY_FILE_MAGIC             0x4B504341U // "ACPK"
+#define ARRAY_FILE_VERSION           1U
+#define ARRAY_FILE_HEADER_SIZE       64U
+#define ARRAY_FILE_DEFAULT_ALIGNMENT 64U
+
+enum array_file_type_enum {
+  array_file_type_invalid = 0,
+  array_file_type_u32     = 1,
+};
+
+enum array_file_status_enum {
+  array_file_ok = 0,
+  array_file_error_open,
+  array_file_error_io,
+  array_file_error_format,   // bad magic, version or truncated file
+  array_file_error_type,     // element type doesn't match the request
+  array_file_error_checksum,
+  array_file_error_range,    // requested range is outside the array
+  array_file_error_too_large // doesn't fit size_type, map it in ranges
+};
+
+// extra flag on top of mapped_file_flags_enum
+#define ARRAY_MAP_VERIFY 256U
+
+typedef struct array_file_header {
+  u32 magic;
+  u32 version;
+  u32 type;
+  u32 alignment;
+  u64 count;
+  u64 data_offset;
+  u64 checksum;
+  u8  reserved[24];
+} array_file_header;
+
+typedef struct array_mapping_u32 {
+  array_u32   arr;
+  mapped_file file;
+  u64         first;       // index of arr.ptr[0] in the file
+  u64         total_count; // element count of the whole file
+  u32         status;
+} array_mapping_u32;
+
+typedef struct array_writer {
+  FILE* f;
+  u32   type;
+  u32   alignment;
+  u64   count;
+  u32   sum1;
+  u32   sum2;
+  u32   status;
+} array_writer;
+
+//
+// checksum
+//
+
+inline
+void array_file_checksum_update(u32* sum1, u32* sum2, const u32* ptr, u64 count) {
+  u32 s1 = *sum1;
+  u32 s2 = *sum2;
+
+  for(u64 i = 0U; i < count; ++i) {
+    s1 += ptr[i];
+    s2 += s1;
+  }
+
+  *sum1 = s1;
+  *sum2 = s2;
+}
+
+inline
+u64 array_file_checksum(u32 sum1, u32 sum2) {
+  return ((u64)sum2 << 32U) | (u64)sum1;
+}
+
+//
+// reading
+//
+
+inline
+u32 array_file_read_header(cstring path, array_file_header* header) {
+  FILE* f = fopen(path, "rb");
+
+  if(f == 0)
+    return array_file_error_open;
+
+  size_t read_count = fread(header, sizeof(array_file_header), 1, f);
+  fclose(f);
+
+  if(read_count != 1U)
+    return array_file_error_format;
+
+  if(header->magic != ARRAY_FILE_MAGIC || header->version != ARRAY_FILE_VERSION)
+    return array_file_error_format;
+
+  u64 file_size = mapped_file_size(path);
+  u64 elem_size = sizeof(u32);
+
+  // alignment is a power of two the data offset is a multiple of
+
+  if(header->alignment == 0U || (header->alignment & (header->alignment - 1U)) != 0U)
+    return array_file_error_format;
+
+  if(header->data_offset % header->alignment != 0U)
+    return array_file_error_format;
+
+  // the elements fit in the file, checked without overflowing for a corrupt count
+
+  if(file_size == ~(u64)0U || header->data_offset < ARRAY_FILE_HEADER_SIZE || header->data_offset > file_size)
+    return array_file_error_format;
+
+  if(header->count > (file_size - header->data_offset) / elem_size)
+    return array_file_error_format;
+
+  return array_file_ok;
+}
+
+// maps the elements [first, first + count) of a u32 array file
+
+inline
+array_mapping_u32 array_map_u32_range(cstring path, u64 first, u64 count, u32 flags) {
+  array_mapping_u32 result;
+  array_file_header header;
+
+  memset(&result, 0, sizeof(result));
+
+  result.status = array_file_read_header(path, &header);
+
+  if(result.status != array_file_ok)
+    return result;
+
+  result.total_count = header.count;
+  result.first = first;
+
+  if(header.type != array_file_type_u32) {
+    result.status = array_file_error_type;
+  } else if(first > header.count || count > header.count - first) {
+    result.status = array_file_error_range;
+  } else if(count > (u64)CPEAK_SIZE_TYPE_MAX) {
+    result.status = array_file_error_too_large;
+  }
+
+  if(result.status != array_file_ok || count == 0U)
+    return result;
+
+  result.file = map_file(path, header.data_offset + first * sizeof(u32), count * sizeof(u32), flags);
+
+  if(result.file.ptr == 0) {
+    result.status = array_file_error_io;
+    return result;
+  }
+
+  result.arr.ptr   = (u32*)result.file.ptr;
+  result.arr.count = (size_type)count;
+
+  // the checksum covers the whole array, so it can only be verified on a full mapping
+
+  if((flags & ARRAY_MAP_VERIFY) && first == 0U && count == header.count) {
+    u32 sum1 = 0U;
+    u32 sum2 = 0U;
+
+    array_file_checksum_update(&sum1, &sum2, result.arr.ptr, count);
+
+    if(array_file_checksum(sum1, sum2) != header.checksum) {
+      unmap_file(&result.file);
+      result.arr.ptr = 0;
+      result.arr.count = 0U;
+      result.status = array_file_error_checksum;
+    }
+  }
+
+  return result;
+}
+
+inline
+array_mapping_u32 array_map_u32(cstring path, u32 flags) {
+  array_file_header header;
+  u32 status = array_file_read_header(path, &header);
+
+  if(status != array_file_ok) {
+    array_mapping_u32 result;
+
+    memset(&result, 0, sizeof(result));
+    result.status = status;
+
+    return result;
+  }
+
+  return array_map_u32_range(path, 0U, header.count, flags);
+}
+
+inline
+void array_unmap_u32(array_mapping_u32* m) {
+  unmap_file(&m->file);
+
+  m->arr.ptr = 0;
+  m->arr.count = 0U;
+}
+
+//
+// streaming writer
+//
+
+inline
+bool array_writer_put_header(array_writer* w) {
+  array_file_header header;
+
+  memset(&header, 0, sizeof(header));
+
+  header.magic       = ARRAY_FILE_MAGIC;
+  header.version     = ARRAY_FILE_VERSION;
+  header.type        = w->type;
+  header.alignment   = w->alignment;
+  header.count       = w->count;
+  header.data_offset = MAXIMUM((u64)ARRAY_FILE_HEADER_SIZE, (u64)w->alignment);
+  header.checksum    = array_file_checksum(w->sum1, w->sum2);
+
+  return fwrite(&header, sizeof(header), 1, w->f) == 1U;
+}
+
+// alignment: power of two, at most the page size for the mapped data to stay aligned
+
+inline
+array_writer array_writer_open(cstring path, u32 alignment) {
+  array_writer result;
+
+  assert(alignment >= sizeof(u32) && (alignment & (alignment - 1U)) == 0U);
+
+  result.f         = fopen(path, "wb");
+  result.type      = array_file_type_u32;
+  result.alignment = alignment;
+  result.count     = 0U;
+  result.sum1      = 0U;
+  result.sum2      = 0U;
+  result.status    = array_file_ok;
+
+  if(result.f == 0) {
+    result.status = array_file_error_open;
+    return result;
+  }
+
+  // placeholder header, rewritten by array_writer_close
+
+  bool ok = array_writer_put_header(&result);
+
+  for(u64 pad = ARRAY_FILE_HEADER_SIZE; ok && pad < (u64)alignment; ++pad)
+    ok = fputc(0, result.f) != EOF;
+
+  if(!ok)
+    result.status = array_file_error_io;
+
+  return result;
+}
+
+inline
+void array_writer_append(array_writer* w, array_u32 arr) {
+  if(w->status != array_file_ok || arr.count == 0U)
+    return;
+
+  if(fwrite(arr.ptr, sizeof(u32), arr.count, w->f) != arr.count) {
+    w->status = array_file_error_io;
+    return;
+  }
+
+  array_file_checksum_update(&w->sum1, &w->sum2, arr.ptr, arr.count);
+  w->count += arr.count;
+}
+
+inline
+u32 array_writer_close(array_writer* w) {
+  if(w->f == 0)
+    return w->status;
+
+  if(w->status == array_file_ok) {
+    if(fseek(w->f, 0, SEEK_SET) != 0 || !array_writer_put_header(w))
+      w->status = array_file_error_io;
+  }
+
+  if(fclose(w->f) != 0 && w->status == array_file_ok)
+    w->status = array_file_error_io;
+
+  w->f = 0;
+
+  return w->status;
+}
+
+inline
+u32 array_save_u32(cstring path, array_u32 arr) {
+  array_writer w = array_writer_open(path, ARRAY_FILE_DEFAULT_ALIGNMENT);
+
+  array_writer_append(&w, arr);
+
+  return array_writer_close(&w);
+}
+
+#endif
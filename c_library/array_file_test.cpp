@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+
+#include "alloc.h"
+#include "array_u32.h"
+#include "array_file.h"
+
+// rewrites one field of the header of the file at path
+
+void patch_header(cstring path, usize offset, const void* value, usize size) {
+  FILE* f = fopen(path, "r+b");
+
+  fseek(f, (long)offset, SEEK_SET);
+  fwrite(value, size, 1, f);
+  fclose(f);
+}
+
+u32 map_status(cstring path) {
+  array_mapping_u32 m = array_map_u32(path, mapped_file_read | ARRAY_MAP_VERIFY);
+  u32 result = m.status;
+
+  array_unmap_u32(&m);
+
+  return result;
+}
+
+int main(int argc, char** argv) {
+  allocator ai = std_alloc;
+  cstring path = "array_file_test.acpk";
+
+  // round trip
+
+  array_u32 x = mul(ai, iota_u32(ai, 16), 3U);
+
+  printf("save: %u\n", array_save_u32(path, x));
+
+  array_mapping_u32 m = array_map_u32(path, mapped_file_read | ARRAY_MAP_VERIFY);
+  bool same = m.status == array_file_ok && m.arr.count == x.count;
+
+  for(size_type i = 0; same && i < x.count; ++i)
+    same = m.arr.ptr[i] == x.ptr[i];
+
+  printf("map: %u, count: %u, same: %d\n", m.status, (u32)m.arr.count, same);
+  array_unmap_u32(&m);
+
+  m = array_map_u32_range(path, 4U, 8U, mapped_file_read);
+  printf("range: %u, first: %u, last: %u\n", m.status, m.arr.ptr[0], m.arr.ptr[m.arr.count - 1U]);
+  array_unmap_u32(&m);
+
+  m = array_map_u32_range(path, 10U, 8U, mapped_file_read);
+  printf("range past the end: %u\n", m.status);
+
+  // corrupt headers are rejected before anything is mapped
+
+  array_file_header header;
+  u64 count = 0x4000000000000010ULL;
+  u64 data_offset = 0U;
+  u32 alignment = 48U;
+  u32 element = 7U;
+
+  array_save_u32(path, x);
+  patch_header(path, offsetof(array_file_header, count), &count, sizeof(count));
+  printf("huge count: %u\n", map_status(path));
+
+  count = 17U;
+  array_save_u32(path, x);
+  patch_header(path, offsetof(array_file_header, count), &count, sizeof(count));
+  printf("count past the end: %u\n", map_status(path));
+
+  array_save_u32(path, x);
+  patch_header(path, offsetof(array_file_header, data_offset), &data_offset, sizeof(data_offset));
+  printf("data in the header: %u\n", map_status(path));
+
+  array_save_u32(path, x);
+  patch_header(path, offsetof(array_file_header, alignment), &alignment, sizeof(alignment));
+  printf("alignment not a power of two: %u\n", map_status(path));
+
+  array_save_u32(path, x);
+  patch_header(path, ARRAY_FILE_DEFAULT_ALIGNMENT, &element, sizeof(element));
+  printf("changed element: %u\n", map_status(path));
+
+  // truncated: the header alone, then half of it
+
+  array_save_u32(path, take(x, 0));
+  printf("empty: %u, header: %u\n", map_status(path), array_file_read_header(path, &header));
+
+  FILE* f = fopen(path, "wb");
+  fwrite(&header, sizeof(header) / 2U, 1, f);
+  fclose(f);
+  printf("truncated header: %u\n", map_status(path));
+
+  remove(path);
+
+  return 0;
+}
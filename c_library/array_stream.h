@@ -0,0 +1,402 @@
+/**
+ *  array_stream.h
+ *
+ *  Out-of-core execution of array pipelines.
+ *
+ *  A source (array file, generator or in-memory array) is consumed in
+ *  chunks of a fixed element count. Chunks are read into a small ring of
+ *  buffers by a reader thread, so that the next chunk is loaded while the
+ *  current one is processed (double buffering with the default of 2).
+ *
+ *  Every chunk is handed to the pipeline together with a scratch allocator
+ *  backed by an arena that is reset after the chunk, so the existing
+ *  elementwise ops (add, mul, map, ...) can be used as they are. Peak
+ *  memory is buffer_count * chunk_count * 4 bytes plus the scratch arena,
+ *  independent of the size of the input. The scratch arena defaults to
+ *  ARRAY_STREAM_DEFAULT_SCRATCH_CHUNKS chunks.
+ *
+ *  A source that delivers fewer elements than its count (a truncated file,
+ *  an I/O error) ends the stream early with array_file_error_io, which the
+ *  stream functions return, so a partial result is never mistaken for a
+ *  complete one.
+ */
+
+#ifndef CPEAK_ARRAY_STREAM_H
+#define CPEAK_ARRAY_STREAM_H
+
+#include <stdio.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "types.h"
+#include "macro.h"
+#include "alloc.h"
+#include "arena.h"
+#include "array_u32.h"
+#include "array_file.h"
+
+#define ARRAY_STREAM_DEFAULT_CHUNK_COUNT   32768U // 128 KB of u32, sized for L2
+#define ARRAY_STREAM_DEFAULT_BUFFER_COUNT  2U
+#define ARRAY_STREAM_DEFAULT_SCRATCH_CHUNKS 8U
+
+// reads up to 'count' elements starting at element 'offset' into 'dest', returns the number read
+
+typedef FPTR(stream_read_fptr, size_type, void*, u64, u32*, size_type);
+
+typedef struct array_source_u32 {
+  stream_read_fptr read_impl;
+  void*            data;
+  u64              count;
+} array_source_u32;
+
+typedef struct array_stream_config {
+  size_type chunk_count;  // elements per chunk
+  u32       buffer_count; // read buffers in flight, 1 disables the reader thread
+  usize     scratch_size; // bytes of the per-chunk scratch arena, 0 for ARRAY_STREAM_DEFAULT_SCRATCH_CHUNKS chunks
+} array_stream_config;
+
+inline
+array_stream_config default_stream_config() {
+  array_stream_config result;
+
+  result.chunk_count  = ARRAY_STREAM_DEFAULT_CHUNK_COUNT;
+  result.buffer_count = ARRAY_STREAM_DEFAULT_BUFFER_COUNT;
+  result.scratch_size = 0U;
+
+  return result;
+}
+
+//
+// in-memory source
+//
+
+inline
+size_type array_source_memory_read(void* data, u64 offset, u32* dest, size_type count) {
+  array_u32* arr = (array_u32*)data;
+  size_type n = (size_type)MINIMUM((u64)count, (u64)arr->count - offset);
+
+  memcpy(dest, arr->ptr + offset, n * sizeof(u32));
+
+  return n;
+}
+
+// note: the source keeps a pointer to 'arr', which has to outlive it
+
+inline
+array_source_u32 make_array_source(array_u32* arr) {
+  array_source_u32 result;
+
+  result.read_impl = array_source_memory_read;
+  result.data      = (void*)arr;
+  result.count     = arr->count;
+
+  return result;
+}
+
+//
+// generated source, 'gen' is called as gen(u64 index) -> u32
+//
+
+template <typename Gen>
+inline
+size_type array_source_generator_read(void* data, u64 offset, u32* dest, size_type count) {
+  Gen* gen = (Gen*)data;
+
+  for(size_type i = 0; i < count; ++i) {
+    dest[i] = (*gen)(offset + i);
+  }
+
+  return count;
+}
+
+template <typename Gen>
+inline
+array_source_u32 make_generator_source(Gen* gen, u64 count) {
+  array_source_u32 result;
+
+  result.read_impl = array_source_generator_read<Gen>;
+  result.data      = (void*)gen;
+  result.count     = count;
+
+  return result;
+}
+
+//
+// file source, reads an array file (array_file.h) without mapping it
+//
+
+typedef struct array_file_source {
+  FILE* f;
+  u64   data_offset;
+  u64   position; // current element position of 'f'
+} array_file_source;
+
+inline
+bool array_stream_seek(FILE* f, u64 byte_offset) {
+#if defined(_WIN32)
+  return _fseeki64(f, (__int64)byte_offset, SEEK_SET) == 0;
+#else
+  return fseeko(f, (off_t)byte_offset, SEEK_SET) == 0;
+#endif
+}
+
+inline
+size_type array_source_file_read(void* data, u64 offset, u32* dest, size_type count) {
+  array_file_source* fs = (array_file_source*)data;
+
+  if(fs->position != offset) {
+    if(!array_stream_seek(fs->f, fs->data_offset + offset * sizeof(u32)))
+      return 0U;
+
+    fs->position = offset;
+  }
+
+  size_type n = (size_type)fread(dest, sizeof(u32), count, fs->f);
+  fs->position += n;
+
+  return n;
+}
+
+// the source state is allocated from 'a', a null read_impl signals failure
+
+inline
+array_source_u32 open_file_source(allocator a, cstring path) {
+  array_source_u32 result = { 0, 0, 0U };
+  array_file_header header;
+
+  if(array_file_read_header(path, &header) != array_file_ok || header.type != array_file_type_u32)
+    return result;
+
+  FILE* f = fopen(path, "rb");
+
+  if(f == 0)
+    return result;
+
+  array_file_source* fs = (array_file_source*)cpeak_alloc(a, sizeof(array_file_source));
+
+  fs->f           = f;
+  fs->data_offset = header.data_offset;
+  fs->position    = ~(u64)0U;
+
+  result.read_impl = array_source_file_read;
+  result.data      = (void*)fs;
+  result.count     = header.count;
+
+  return result;
+}
+
+inline
+void close_file_source(allocator a, array_source_u32 src) {
+  array_file_source* fs = (array_file_source*)src.data;
+
+  if(fs) {
+    fclose(fs->f);
+    cpeak_free(a, fs);
+  }
+}
+
+//
+// chunk ring shared by the reader thread and the consumer
+//
+
+typedef struct array_stream_ring {
+  std::mutex              lock;
+  std::condition_variable changed;
+  array_u32*              slots;
+  u64*                    offsets;
+  u32                     slot_count;
+  u32                     head;   // next slot to consume
+  u32                     tail;   // next slot to fill
+  u32                     filled;
+  bool                    done;
+  u32                     status; // array_file_error_io after a short read
+} array_stream_ring;
+
+inline
+void array_stream_reader(array_stream_ring* ring, array_source_u32 src, size_type chunk_count) {
+  u64 offset = 0U;
+
+  while(offset < src.count) {
+    u32 slot;
+
+    {
+      std::unique_lock<std::mutex> guard(ring->lock);
+      ring->changed.wait(guard, [ring]() { return ring->filled < ring->slot_count; });
+      slot = ring->tail;
+    }
+
+    size_type wanted = (size_type)MINIMUM((u64)chunk_count, src.count - offset);
+    size_type n = src.read_impl(src.data, offset, ring->slots[slot].ptr, wanted);
+
+    {
+      std::unique_lock<std::mutex> guard(ring->lock);
+
+      ring->slots[slot].count = n;
+      ring->offsets[slot] = offset;
+      ring->tail = (slot + 1U) % ring->slot_count;
+      ++ring->filled;
+
+      // a short read ends the stream: the source is truncated or failed
+      if(n != wanted) {
+        ring->done = true;
+        ring->status = array_file_error_io;
+      }
+    }
+
+    ring->changed.notify_all();
+    offset += n;
+
+    if(n != wanted)
+      return;
+  }
+
+  {
+    std::unique_lock<std::mutex> guard(ring->lock);
+    ring->done = true;
+  }
+
+  ring->changed.notify_all();
+}
+
+//
+// execution
+//
+
+// calls op(array_u32 chunk, u64 offset, allocator scratch) for every chunk in
+// order; returns array_file_error_io when the source ended early, the chunks
+// up to there were processed
+
+template <typename Op>
+inline
+u32 stream_for_each_chunk(array_source_u32 src, array_stream_config cfg, Op op) {
+  assert(cfg.chunk_count > 0U && cfg.buffer_count > 0U);
+
+  u32 buffer_count = (u32)MINIMUM((u64)cfg.buffer_count, src.count / cfg.chunk_count + 1U);
+  usize buffer_bytes = ALIGN_USIZE_16(cfg.chunk_count * sizeof(u32));
+  usize scratch_size = cfg.scratch_size;
+  u32 status = array_file_ok;
+
+  // the scratch has to hold at least one chunk sized temporary
+
+  if(scratch_size == 0U)
+    scratch_size = ARRAY_STREAM_DEFAULT_SCRATCH_CHUNKS * buffer_bytes;
+
+  assert(scratch_size >= buffer_bytes);
+
+  arena ma = make_system_arena(ALIGN_USIZE_16(sizeof(arena_head)) + buffer_count * (buffer_bytes + 2U * sizeof(u64) + sizeof(array_u32)) + scratch_size + 64U);
+
+  array_u32* slots = (array_u32*)arena_alloc(ma, buffer_count * sizeof(array_u32));
+  u64* offsets = (u64*)arena_alloc(ma, buffer_count * sizeof(u64));
+
+  for(u32 i = 0U; i < buffer_count; ++i) {
+    slots[i].ptr = (u32*)arena_alloc(ma, buffer_bytes);
+    slots[i].count = 0U;
+  }
+
+  // everything allocated after this point is per-chunk scratch
+
+  allocator scratch = get_arena_alloc(ma);
+
+  if(buffer_count == 1U) {
+    u64 offset = 0U;
+
+    while(offset < src.count) {
+      size_type wanted = (size_type)MINIMUM((u64)cfg.chunk_count, src.count - offset);
+
+      slots[0].count = src.read_impl(src.data, offset, slots[0].ptr, wanted);
+
+      arena_push(ma);
+      op(slots[0], offset, scratch);
+      arena_pop(ma);
+
+      if(slots[0].count != wanted) {
+        status = array_file_error_io;
+        break;
+      }
+
+      offset += wanted;
+    }
+  } else {
+    array_stream_ring ring;
+
+    ring.slots      = slots;
+    ring.offsets    = offsets;
+    ring.slot_count = buffer_count;
+    ring.head       = 0U;
+    ring.tail       = 0U;
+    ring.filled     = 0U;
+    ring.done       = false;
+    ring.status     = array_file_ok;
+
+    std::thread reader(array_stream_reader, &ring, src, cfg.chunk_count);
+
+    for(;;) {
+      u32 slot;
+
+      {
+        std::unique_lock<std::mutex> guard(ring.lock);
+        ring.changed.wait(guard, [&ring]() { return ring.filled > 0U || ring.done; });
+
+        if(ring.filled == 0U)
+          break;
+
+        slot = ring.head;
+      }
+
+      arena_push(ma);
+      op(slots[slot], offsets[slot], scratch);
+      arena_pop(ma);
+
+      {
+        std::unique_lock<std::mutex> guard(ring.lock);
+
+        ring.head = (slot + 1U) % ring.slot_count;
+        --ring.filled;
+      }
+
+      ring.changed.notify_all();
+    }
+
+    reader.join();
+    status = ring.status;
+  }
+
+  free_system_arena(ma);
+
+  return status;
+}
+
+// folds the chunks into an accumulator: *acc = op(*acc, chunk, scratch);
+// returns the status of stream_for_each_chunk, *acc only covers the chunks
+// read when it isn't array_file_ok
+
+template <typename T, typename Op>
+inline
+u32 stream_reduce(array_source_u32 src, array_stream_config cfg, T* acc, Op op) {
+  return stream_for_each_chunk(src, cfg, [acc, &op](array_u32 chunk, u64, allocator scratch) {
+    *acc = op(*acc, chunk, scratch);
+  });
+}
+
+// runs an elementwise pipeline, result = op(chunk, scratch), and appends the
+// results to 'sink' (which may be null to only run the pipeline for its side effects);
+// returns the read status, or else the sink's
+
+template <typename Op>
+inline
+u32 stream_map(array_source_u32 src, array_stream_config cfg, array_writer* sink, Op op) {
+  u32 result = stream_for_each_chunk(src, cfg, [sink, &op](array_u32 chunk, u64, allocator scratch) {
+    array_u32 mapped = op(chunk, scratch);
+
+    if(sink)
+      array_writer_append(sink, mapped);
+  });
+
+  if(result == array_file_ok && sink)
+    result = sink->status;
+
+  return result;
+}
+
+#endif
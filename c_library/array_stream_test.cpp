@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "array_u32.h"
+#include "array_file.h"
+#include "array_stream.h"
+
+// a source that fails after 'limit' elements, like a file truncated while it's read
+
+typedef struct failing_source {
+  array_u32* arr;
+  u64        limit;
+} failing_source;
+
+size_type failing_source_read(void* data, u64 offset, u32* dest, size_type count) {
+  failing_source* fs = (failing_source*)data;
+  size_type n = (offset >= fs->limit) ? 0U : (size_type)MINIMUM((u64)count, fs->limit - offset);
+
+  memcpy(dest, fs->arr->ptr + offset, n * sizeof(u32));
+
+  return n;
+}
+
+u64 sum_chunk(u64 acc, array_u32 chunk, allocator) {
+  for(size_type i = 0; i < chunk.count; ++i)
+    acc += chunk.ptr[i];
+
+  return acc;
+}
+
+int main(int argc, char** argv) {
+  allocator ai = std_alloc;
+  cstring path = "array_stream_test.acpk";
+
+  array_u32 x = iota_u32(ai, 100000);
+  u64 expected = sum_chunk(0U, x, ai);
+  auto square = [](u64 i) -> u32 { return (u32)(i * i); };
+  u64 expected_squares = 0U;
+
+  for(u64 i = 0U; i < 100000U; ++i)
+    expected_squares += square(i);
+
+  array_save_u32(path, x);
+
+  // in-memory, generator and file sources with 1, 2, 3 and 8 buffers, chunks that don't divide the count
+
+  u32 buffer_counts[] = { 1U, 2U, 3U, 8U };
+
+  for(u32 b = 0U; b < 4U; ++b) {
+    array_stream_config cfg = default_stream_config();
+
+    cfg.chunk_count  = 4099U;
+    cfg.buffer_count = buffer_counts[b];
+
+    u64 memory_sum = 0U;
+    u64 generator_sum = 0U;
+    u64 file_sum = 0U;
+
+    u32 memory_status = stream_reduce(make_array_source(&x), cfg, &memory_sum, sum_chunk);
+    u32 generator_status = stream_reduce(make_generator_source(&square, 100000U), cfg, &generator_sum, sum_chunk);
+
+    array_source_u32 file = open_file_source(ai, path);
+    u32 file_status = stream_reduce(file, cfg, &file_sum, sum_chunk);
+
+    close_file_source(ai, file);
+
+    printf("%u buffers: memory %d (%u), generator %d (%u), file %d (%u)\n", buffer_counts[b],
+           memory_sum == expected, memory_status, generator_sum == expected_squares, generator_status,
+           file_sum == expected, file_status);
+  }
+
+  // a source that ends early reports it, with every buffer count
+
+  failing_source failing = { &x, 50000U };
+  array_source_u32 failing_src = { failing_source_read, (void*)&failing, x.count };
+
+  for(u32 b = 0U; b < 4U; ++b) {
+    array_stream_config cfg = default_stream_config();
+    u64 sum = 0U;
+
+    cfg.chunk_count  = 4099U;
+    cfg.buffer_count = buffer_counts[b];
+
+    u32 status = stream_reduce(failing_src, cfg, &sum, sum_chunk);
+
+    printf("%u buffers, failing source: status %u, partial sum %d\n", buffer_counts[b], status, sum < expected);
+  }
+
+  // a pipeline into a writer, read back
+
+  array_stream_config cfg = default_stream_config();
+  array_writer w = array_writer_open(path, ARRAY_FILE_DEFAULT_ALIGNMENT);
+
+  cfg.chunk_count = 3000U;
+
+  u32 map_status = stream_map(make_array_source(&x), cfg, &w, [](array_u32 chunk, allocator scratch) {
+    return add(scratch, chunk, chunk);
+  });
+
+  printf("map: %u, close: %u\n", map_status, array_writer_close(&w));
+
+  array_mapping_u32 m = array_map_u32(path, mapped_file_read | ARRAY_MAP_VERIFY);
+  bool doubled = m.status == array_file_ok && m.arr.count == x.count;
+
+  for(size_type i = 0; doubled && i < x.count; ++i)
+    doubled = m.arr.ptr[i] == 2U * x.ptr[i];
+
+  printf("doubled: %d\n", doubled);
+  array_unmap_u32(&m);
+
+  // chunks larger than the default with the default scratch, which scales with them
+
+  array_u32 big = iota_u32(ai, 2000000);
+
+  cfg = default_stream_config();
+  cfg.chunk_count = 2000000U;
+
+  u64 big_sum = 0U;
+  u32 big_status = stream_reduce(make_array_source(&big), cfg, &big_sum, [](u64 acc, array_u32 chunk, allocator scratch) {
+    return sum_chunk(acc, add(scratch, chunk, chunk), scratch);
+  });
+
+  printf("big chunks: %u, sum %llu\n", big_status, (unsigned long long)big_sum);
+
+  remove(path);
+
+  return 0;
+}
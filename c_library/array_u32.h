@@ -3,6 +3,8 @@
 #define U32_ARRAY_H
 
 #include <assert.h>
+#include <stdio.h>
+#include <string.h>
 #include "types.h"
 #include "macro.h"
 #include "alloc.h"
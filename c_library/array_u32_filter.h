@@ -0,0 +1,312 @@
+/**
+ *  array_u32_filter.h
+ *
+ *  Elementwise comparisons producing bitsets, and stream compaction.
+ *
+ *  eq/ne/lt/le/gt/ge compare an array against another array (up to the
+ *  shorter length) or a scalar, with unsigned semantics. compress writes
+ *  the elements whose mask bit is set contiguously, using VPCOMPRESSD with
+ *  AVX-512, a permutation table lookup per 8 elements with AVX2 and a
+ *  set-bit scan otherwise.
+ */
+
+#ifndef U32_ARRAY_FILTER_H
+#define U32_ARRAY_FILTER_H
+
+#include "types.h"
+#include "macro.h"
+#include "alloc.h"
+#include "bits.h"
+#include "simd.h"
+#include "array_u32.h"
+#include "bitset.h"
+
+enum compare_op_enum {
+  compare_op_eq,
+  compare_op_ne,
+  compare_op_lt,
+  compare_op_le,
+  compare_op_gt,
+  compare_op_ge,
+};
+
+template <u32 Cmp>
+inline
+bool compare_scalar(u32 x, u32 y) {
+  switch(Cmp) {
+    case compare_op_eq: return x == y;
+    case compare_op_ne: return x != y;
+    case compare_op_lt: return x < y;
+    case compare_op_le: return x <= y;
+    case compare_op_gt: return x > y;
+    default:            return x >= y;
+  }
+}
+
+#if defined(CPEAK_AVX2)
+// 8 comparisons -> 8 mask bits
+// unsigned order is derived from min/max: x <= y <=> min(x, y) == x
+
+template <u32 Cmp>
+inline
+u32 compare_avx2(__m256i x, __m256i y) {
+  __m256i m;
+  u32 negate = 0U;
+
+  switch(Cmp) {
+    case compare_op_eq: m = _mm256_cmpeq_epi32(x, y); break;
+    case compare_op_ne: m = _mm256_cmpeq_epi32(x, y); negate = 0xFFU; break;
+    case compare_op_le: m = _mm256_cmpeq_epi32(_mm256_min_epu32(x, y), x); break;
+    case compare_op_gt: m = _mm256_cmpeq_epi32(_mm256_min_epu32(x, y), x); negate = 0xFFU; break;
+    case compare_op_ge: m = _mm256_cmpeq_epi32(_mm256_max_epu32(x, y), x); break;
+    default:            m = _mm256_cmpeq_epi32(_mm256_max_epu32(x, y), x); negate = 0xFFU; break;
+  }
+
+  return (u32)_mm256_movemask_ps(_mm256_castsi256_ps(m)) ^ negate;
+}
+#elif defined(CPEAK_SSE2)
+// 4 comparisons -> 4 mask bits
+// SSE2 only has signed compares, flipping the sign bit maps unsigned order onto signed order
+
+template <u32 Cmp>
+inline
+u32 compare_sse2(__m128i x, __m128i y) {
+  __m128i bias = _mm_set1_epi32((int)0x80000000U);
+  __m128i xs = _mm_xor_si128(x, bias);
+  __m128i ys = _mm_xor_si128(y, bias);
+  __m128i m;
+  u32 negate = 0U;
+
+  switch(Cmp) {
+    case compare_op_eq: m = _mm_cmpeq_epi32(x, y); break;
+    case compare_op_ne: m = _mm_cmpeq_epi32(x, y); negate = 0xFU; break;
+    case compare_op_lt: m = _mm_cmplt_epi32(xs, ys); break;
+    case compare_op_le: m = _mm_cmpgt_epi32(xs, ys); negate = 0xFU; break;
+    case compare_op_gt: m = _mm_cmpgt_epi32(xs, ys); break;
+    default:            m = _mm_cmplt_epi32(xs, ys); negate = 0xFU; break;
+  }
+
+  return (u32)_mm_movemask_ps(_mm_castsi128_ps(m)) ^ negate;
+}
+#endif
+
+// 64 comparisons -> one bitset word, y_step is 0 for a broadcast scalar
+
+template <u32 Cmp>
+inline
+u64 compare_word(const u32* x, const u32* y, u32 y_step) {
+  u64 result = 0U;
+
+#if defined(CPEAK_AVX2)
+  __m256i yv = _mm256_set1_epi32((int)y[0]);
+
+  for(u32 j = 0U; j < 64U; j += 8U) {
+    __m256i xv = _mm256_loadu_si256((const __m256i*)(x + j));
+
+    if(y_step != 0U)
+      yv = _mm256_loadu_si256((const __m256i*)(y + j));
+
+    result |= (u64)compare_avx2<Cmp>(xv, yv) << j;
+  }
+#elif defined(CPEAK_SSE2)
+  __m128i yv = _mm_set1_epi32((int)y[0]);
+
+  for(u32 j = 0U; j < 64U; j += 4U) {
+    __m128i xv = _mm_loadu_si128((const __m128i*)(x + j));
+
+    if(y_step != 0U)
+      yv = _mm_loadu_si128((const __m128i*)(y + j));
+
+    result |= (u64)compare_sse2<Cmp>(xv, yv) << j;
+  }
+#else
+  for(u32 j = 0U; j < 64U; ++j) {
+    result |= (u64)compare_scalar<Cmp>(x[j], y[j * y_step]) << j;
+  }
+#endif
+
+  return result;
+}
+
+template <u32 Cmp>
+inline
+bitset compare(allocator a, array_u32 x, const u32* y, u32 y_step, size_type count) {
+  bitset result;
+  size_type word_count = bitset_word_count(count);
+  size_type full_words = count / 64U;
+
+  result.count = count;
+  result.words = (u64*)cpeak_alloc(a, word_count * sizeof(u64));
+
+  for(size_type w = 0; w < full_words; ++w) {
+    result.words[w] = compare_word<Cmp>(x.ptr + w * 64U, y + w * 64U * y_step, y_step);
+  }
+
+  if(full_words < word_count) {
+    u64 tail = 0U;
+
+    for(size_type i = full_words * 64U; i < count; ++i) {
+      tail |= (u64)compare_scalar<Cmp>(x.ptr[i], y[i * y_step]) << (i % 64U);
+    }
+
+    result.words[full_words] = tail;
+  }
+
+  return result;
+}
+
+inline bitset eq(allocator a, array_u32 x, array_u32 y) { return compare<compare_op_eq>(a, x, y.ptr, 1U, MINIMUM(x.count, y.count)); }
+inline bitset ne(allocator a, array_u32 x, array_u32 y) { return compare<compare_op_ne>(a, x, y.ptr, 1U, MINIMUM(x.count, y.count)); }
+inline bitset lt(allocator a, array_u32 x, array_u32 y) { return compare<compare_op_lt>(a, x, y.ptr, 1U, MINIMUM(x.count, y.count)); }
+inline bitset le(allocator a, array_u32 x, array_u32 y) { return compare<compare_op_le>(a, x, y.ptr, 1U, MINIMUM(x.count, y.count)); }
+inline bitset gt(allocator a, array_u32 x, array_u32 y) { return compare<compare_op_gt>(a, x, y.ptr, 1U, MINIMUM(x.count, y.count)); }
+inline bitset ge(allocator a, array_u32 x, array_u32 y) { return compare<compare_op_ge>(a, x, y.ptr, 1U, MINIMUM(x.count, y.count)); }
+
+inline bitset eq(allocator a, array_u32 x, u32 y) { return compare<compare_op_eq>(a, x, &y, 0U, x.count); }
+inline bitset ne(allocator a, array_u32 x, u32 y) { return compare<compare_op_ne>(a, x, &y, 0U, x.count); }
+inline bitset lt(allocator a, array_u32 x, u32 y) { return compare<compare_op_lt>(a, x, &y, 0U, x.count); }
+inline bitset le(allocator a, array_u32 x, u32 y) { return compare<compare_op_le>(a, x, &y, 0U, x.count); }
+inline bitset gt(allocator a, array_u32 x, u32 y) { return compare<compare_op_gt>(a, x, &y, 0U, x.count); }
+inline bitset ge(allocator a, array_u32 x, u32 y) { return compare<compare_op_ge>(a, x, &y, 0U, x.count); }
+
+//
+// stream compaction
+//
+
+#if defined(CPEAK_AVX2) && !defined(CPEAK_AVX512)
+// for every 8-bit mask, the source lanes of the selected elements packed as 4-bit indices
+
+typedef struct compress_table {
+  u32 entries[256];
+} compress_table;
+
+inline
+compress_table make_compress_table() {
+  compress_table result;
+
+  for(u32 m = 0U; m < 256U; ++m) {
+    u32 packed = 0U;
+    u32 n = 0U;
+
+    for(u32 lane = 0U; lane < 8U; ++lane) {
+      if(m & (1U << lane)) {
+        packed |= lane << (4U * n);
+        ++n;
+      }
+    }
+
+    result.entries[m] = packed;
+  }
+
+  return result;
+}
+#endif
+
+// writes the elements of x whose bit is set in mask to dest, returns the number written
+// dest needs room for popcount(mask) elements
+
+inline
+size_type compress_into(u32* dest, array_u32 x, bitset mask) {
+  size_type count = MINIMUM(x.count, mask.count);
+  size_type full_words = count / 64U;
+  u32* out = dest;
+
+#if defined(CPEAK_AVX512)
+  for(size_type w = 0; w < full_words; ++w) {
+    u64 bits = mask.words[w];
+    const u32* in = x.ptr + w * 64U;
+
+    for(u32 j = 0U; j < 64U; j += 16U) {
+      __mmask16 k = (__mmask16)(bits >> j);
+      __m512i v = _mm512_loadu_si512((const void*)(in + j));
+
+      _mm512_mask_compressstoreu_epi32((void*)out, k, v);
+      out += bits_popcount_u32((u32)k);
+    }
+  }
+#elif defined(CPEAK_AVX2)
+  static const compress_table table = make_compress_table();
+
+  const __m256i nibble_shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+  const __m256i nibble_mask = _mm256_set1_epi32(15);
+  u32* out_end = dest + popcount(mask);
+
+  for(size_type w = 0; w < full_words; ++w) {
+    u64 bits = mask.words[w];
+    const u32* in = x.ptr + w * 64U;
+
+    for(u32 j = 0U; j < 64U; j += 8U) {
+      u32 m = (u32)(bits >> j) & 0xFFU;
+      u32 n = bits_popcount_u32(m);
+
+      if(out + 8 <= out_end) {
+        __m256i idx = _mm256_srlv_epi32(_mm256_set1_epi32((int)table.entries[m]), nibble_shifts);
+        __m256i v = _mm256_loadu_si256((const __m256i*)(in + j));
+
+        // full 8-lane store, the lanes past n are overwritten by the next store
+        _mm256_storeu_si256((__m256i*)out, _mm256_permutevar8x32_epi32(v, _mm256_and_si256(idx, nibble_mask)));
+      } else {
+        while(m != 0U) {
+          *out = in[j + bits_ctz_u32(m)];
+          out += 1;
+          m &= m - 1U;
+        }
+
+        continue;
+      }
+
+      out += n;
+    }
+  }
+#else
+  for(size_type w = 0; w < full_words; ++w) {
+    u64 bits = mask.words[w];
+    const u32* in = x.ptr + w * 64U;
+
+    while(bits != 0U) {
+      *out = in[bits_ctz_u64(bits)];
+      out += 1;
+      bits &= bits - 1U;
+    }
+  }
+#endif
+
+  for(size_type i = full_words * 64U; i < count; ++i) {
+    if(test(mask, i)) {
+      *out = x.ptr[i];
+      out += 1;
+    }
+  }
+
+  return (size_type)(out - dest);
+}
+
+inline
+array_u32 compress(allocator a, array_u32 x, bitset mask) {
+  array_u32 result;
+  size_type count = MINIMUM(x.count, mask.count);
+
+  // note: popcount over the whole mask is an upper bound if x is shorter
+  result.ptr   = (u32*)cpeak_alloc(a, popcount(mask) * sizeof(u32));
+  result.count = compress_into(result.ptr, take(x, count), mask);
+
+  return result;
+}
+
+// indices of the set bits, i.e. a selection vector
+
+inline
+array_u32 set_indices(allocator a, bitset mask) {
+  array_u32 result;
+
+  result.ptr   = (u32*)cpeak_alloc(a, popcount(mask) * sizeof(u32));
+  result.count = 0U;
+
+  for_each_set(mask, [&result](size_type i) {
+    result.ptr[result.count++] = (u32)i;
+  });
+
+  return result;
+}
+
+#endif
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "array_u32.h"
+#include "array_u32_generate.h"
+#include "bitset.h"
+#include "array_u32_filter.h"
+
+// the bits of a compare against a scalar loop, and the tail bits past count zero
+
+template <typename Ref>
+bool same_bits(bitset b, array_u32 x, array_u32 y, u32 y_step, Ref ref) {
+  bool result = b.count == x.count;
+
+  for(size_type i = 0; result && i < b.count; ++i)
+    result = test(b, i) == ref(x.ptr[i], y.ptr[i * y_step]);
+
+  return result && (b.count % 64U == 0U || (b.words[b.count / 64U] & ~bitset_tail_mask(b.count)) == 0U);
+}
+
+int main(int argc, char** argv) {
+  allocator ai = std_alloc;
+
+  array_u32 x = iota_u32(ai, 20);
+  array_u32 y = mod(ai, mul(ai, x, 7U), 20U);
+
+  print(y);
+  printf("\n");
+
+  bitset m = lt(ai, y, x);
+
+  print(m);
+  printf("\npopcount: %u, any: %u, all: %u\n", (u32)popcount(m), (u32)any(m), (u32)all(m));
+
+  print(compress(ai, y, m));
+  printf("\n");
+
+  print(set_indices(ai, and(ai, ge(ai, x, 5U), ne(ai, y, 0U))));
+  printf("\n");
+
+  // unsigned order: 0xFFFFFFFF is the largest value
+
+  array_u32 z = sub(ai, x, 10U);
+  print(gt(ai, z, 5U));
+  printf("\n");
+
+  // 8 full words and a tail of 5, through the 64-wide compare and compress
+  // paths, with values on both sides of 2^31 and many equal pairs
+
+  array_u32 a = random_u32(ai, 517, 1U);
+  array_u32 b = random_u32(ai, 517, 2U);
+  u32 k = 0x80000000U;
+
+  for(size_type i = 0; i < a.count; i += 3U)
+    b.ptr[i] = a.ptr[i];
+
+  array_u32 k_array = { &k, 1U };
+  bool compares = true;
+
+  compares = compares && same_bits(eq(ai, a, b), a, b, 1U, [](u32 p, u32 q) { return p == q; });
+  compares = compares && same_bits(ne(ai, a, b), a, b, 1U, [](u32 p, u32 q) { return p != q; });
+  compares = compares && same_bits(lt(ai, a, b), a, b, 1U, [](u32 p, u32 q) { return p < q; });
+  compares = compares && same_bits(le(ai, a, b), a, b, 1U, [](u32 p, u32 q) { return p <= q; });
+  compares = compares && same_bits(gt(ai, a, b), a, b, 1U, [](u32 p, u32 q) { return p > q; });
+  compares = compares && same_bits(ge(ai, a, b), a, b, 1U, [](u32 p, u32 q) { return p >= q; });
+  compares = compares && same_bits(lt(ai, a, k), a, k_array, 0U, [](u32 p, u32 q) { return p < q; });
+  compares = compares && same_bits(ge(ai, a, k), a, k_array, 0U, [](u32 p, u32 q) { return p >= q; });
+
+  // compress and set_indices with dense, sparse, empty and full masks
+
+  bitset masks[] = { lt(ai, a, b), lt(ai, a, 0x08000000U), lt(ai, a, 0U), ge(ai, a, 0U) };
+  bool compressed = true;
+  u32* expected = (u32*)malloc(a.count * sizeof(u32));
+
+  for(u32 m = 0U; m < 4U; ++m) {
+    size_type n = 0U;
+
+    for(size_type i = 0; i < a.count; ++i) {
+      if(test(masks[m], i))
+        expected[n++] = a.ptr[i];
+    }
+
+    array_u32 c = compress(ai, a, masks[m]);
+    array_u32 idx = set_indices(ai, masks[m]);
+
+    compressed = compressed && c.count == n && idx.count == n && popcount(masks[m]) == n;
+
+    for(size_type i = 0; compressed && i < n; ++i)
+      compressed = c.ptr[i] == expected[i] && a.ptr[idx.ptr[i]] == expected[i];
+  }
+
+  free(expected);
+
+  printf("517 elements: compares %d, compress and set_indices %d\n", compares, compressed);
+
+  return 0;
+}
@@ -0,0 +1,442 @@
+/**
+ *  array_u32_generate.h
+ *
+ *  Array generators: fill, iota with start and step, and pseudo-random
+ *  values.
+ *
+ *  fill_u32     - every element is value
+ *  iota_u32     - x[i] = start + i * step (mod 2^32)
+ *  random_u32   - uniformly distributed u32 values
+ *  random_below - uniformly distributed values in [0, bound), by the
+ *                 multiply-high reduction (bias below 2^-32 * bound)
+ *
+ *  The random values come from Philox4x32-10, a counter-based generator:
+ *  element i is word i % 4 of the block computed from counter i / 4 and
+ *  the 64-bit seed as key. Any range of the output can be computed on its
+ *  own, so the threaded versions produce exactly the values of the
+ *  single-threaded ones and a stream can be split at any index. AVX2
+ *  computes 8 blocks (32 values) and SSE2 4 blocks per step.
+ *
+ *  Outputs of at least GENERATE_STREAM_BYTES are written with
+ *  non-temporal stores, so that generating them doesn't evict the cache
+ *  or read every destination line before writing it (except random_below,
+ *  which reduces its values in place).
+ */
+
+#ifndef U32_ARRAY_GENERATE_H
+#define U32_ARRAY_GENERATE_H
+
+#include <assert.h>
+#include "types.h"
+#include "macro.h"
+#include "alloc.h"
+#include "simd.h"
+#include "parallel.h"
+#include "array_u32.h"
+#include "array_u32_wide.h"
+
+#define GENERATE_STREAM_BYTES   (32U * 1024U * 1024U)
+#define GENERATE_MIN_PER_THREAD (256U * 1024U)
+#define GENERATE_BELOW_CHUNK    4096U
+
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+#define PHILOX_ROUNDS 10U
+
+//
+// stores
+//
+
+inline
+bool generate_streaming(size_type count) {
+  return (u64)count * sizeof(u32) >= (u64)GENERATE_STREAM_BYTES;
+}
+
+// number of elements before dest + i is aligned for a vector store (0 when not streaming)
+
+inline
+size_type generate_head_count(const u32* dest, size_type count, bool stream) {
+  if(!stream)
+    return 0U;
+
+  size_type misaligned = (size_type)(((usize)dest & 31U) / sizeof(u32));
+  size_type head = (misaligned == 0U) ? 0U : 8U - misaligned;
+
+  return MINIMUM(head, count);
+}
+
+#if defined(CPEAK_AVX2)
+inline
+void generate_store(u32* p, __m256i v, bool stream) {
+  if(stream)
+    _mm256_stream_si256((__m256i*)p, v);
+  else
+    _mm256_storeu_si256((__m256i*)p, v);
+}
+#elif defined(CPEAK_SSE2)
+inline
+void generate_store(u32* p, __m128i v, bool stream) {
+  if(stream)
+    _mm_stream_si128((__m128i*)p, v);
+  else
+    _mm_storeu_si128((__m128i*)p, v);
+}
+#endif
+
+inline
+void generate_finish(bool stream) {
+#if defined(CPEAK_SSE2)
+  // non-temporal stores are weakly ordered
+  if(stream)
+    _mm_sfence();
+#endif
+}
+
+//
+// fill and iota
+//
+
+inline
+void fill_into(u32* dest, size_type count, u32 value, bool stream) {
+  size_type i = generate_head_count(dest, count, stream);
+
+  for(size_type j = 0; j < i; ++j)
+    dest[j] = value;
+
+#if defined(CPEAK_AVX2)
+  __m256i v = _mm256_set1_epi32((int)value);
+
+  for(; i + 8U <= count; i += 8U)
+    generate_store(dest + i, v, stream);
+#elif defined(CPEAK_SSE2)
+  __m128i v = _mm_set1_epi32((int)value);
+
+  for(; i + 4U <= count; i += 4U)
+    generate_store(dest + i, v, stream);
+#endif
+
+  for(; i < count; ++i)
+    dest[i] = value;
+
+  generate_finish(stream);
+}
+
+// dest[i] = start + (first + i) * step
+
+inline
+void iota_into(u32* dest, size_type count, u64 first, u32 start, u32 step, bool stream) {
+  size_type i = generate_head_count(dest, count, stream);
+
+  for(size_type j = 0; j < i; ++j)
+    dest[j] = start + (u32)(first + j) * step;
+
+#if defined(CPEAK_AVX2)
+  u32 base = start + (u32)(first + i) * step;
+  __m256i v = _mm256_add_epi32(_mm256_set1_epi32((int)base),
+                               _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)step)));
+  __m256i advance = _mm256_set1_epi32((int)(8U * step));
+
+  for(; i + 8U <= count; i += 8U) {
+    generate_store(dest + i, v, stream);
+    v = _mm256_add_epi32(v, advance);
+  }
+#elif defined(CPEAK_SSE2)
+  u32 base = start + (u32)(first + i) * step;
+  __m128i v = _mm_setr_epi32((int)base, (int)(base + step), (int)(base + 2U * step), (int)(base + 3U * step));
+  __m128i advance = _mm_set1_epi32((int)(4U * step));
+
+  for(; i + 4U <= count; i += 4U) {
+    generate_store(dest + i, v, stream);
+    v = _mm_add_epi32(v, advance);
+  }
+#endif
+
+  for(; i < count; ++i)
+    dest[i] = start + (u32)(first + i) * step;
+
+  generate_finish(stream);
+}
+
+//
+// Philox4x32-10
+//
+
+inline
+void philox_block(u32 out[4], u64 block, u64 seed) {
+  u32 c0 = (u32)block;
+  u32 c1 = (u32)(block >> 32);
+  u32 c2 = 0U;
+  u32 c3 = 0U;
+  u32 k0 = (u32)seed;
+  u32 k1 = (u32)(seed >> 32);
+
+  for(u32 r = 0U; r < PHILOX_ROUNDS; ++r) {
+    u64 p0 = (u64)PHILOX_M0 * c0;
+    u64 p1 = (u64)PHILOX_M1 * c2;
+
+    c0 = (u32)(p1 >> 32) ^ c1 ^ k0;
+    c1 = (u32)p1;
+    c2 = (u32)(p0 >> 32) ^ c3 ^ k1;
+    c3 = (u32)p0;
+
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+inline
+u32 philox_word(u64 index, u64 seed) {
+  u32 block[4];
+
+  philox_block(block, index / 4U, seed);
+
+  return block[index % 4U];
+}
+
+// 64 bits: words 2 * index and 2 * index + 1 of the stream
+
+inline
+u64 philox_u64(u64 index, u64 seed) {
+  u32 block[4];
+
+  philox_block(block, index / 2U, seed);
+
+  return ((u64)block[2U * (index % 2U)] << 32) | block[2U * (index % 2U) + 1U];
+}
+
+#if defined(CPEAK_AVX2)
+// 8 blocks, counters block..block + 7, stored as 32 consecutive values
+
+inline
+void philox_8_blocks(u32* dest, u64 block, u64 seed, bool stream) {
+  __m256i c0 = _mm256_add_epi32(_mm256_set1_epi32((int)(u32)block), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  // carry into the high counter word where the low word wrapped
+  __m256i wrapped = _mm256_cmpgt_epi32(_mm256_xor_si256(_mm256_set1_epi32((int)(u32)block), _mm256_set1_epi32((int)0x80000000U)),
+                                       _mm256_xor_si256(c0, _mm256_set1_epi32((int)0x80000000U)));
+  __m256i c1 = _mm256_sub_epi32(_mm256_set1_epi32((int)(u32)(block >> 32)), wrapped);
+  __m256i c2 = _mm256_setzero_si256();
+  __m256i c3 = _mm256_setzero_si256();
+  __m256i m0 = _mm256_set1_epi32((int)PHILOX_M0);
+  __m256i m1 = _mm256_set1_epi32((int)PHILOX_M1);
+  u32 k0 = (u32)seed;
+  u32 k1 = (u32)(seed >> 32);
+
+  for(u32 r = 0U; r < PHILOX_ROUNDS; ++r) {
+    __m256i lo0, hi0, lo1, hi1;
+
+    mul_lo_hi_avx2(m0, c0, &lo0, &hi0);
+    mul_lo_hi_avx2(m1, c2, &lo1, &hi1);
+
+    c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32((int)k0));
+    c1 = lo1;
+    c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32((int)k1));
+    c3 = lo0;
+
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+
+  // lane b of c0..c3 is block b, interleave to [b0 | b1], [b2 | b3], ...
+  __m256i t0 = _mm256_unpacklo_epi32(c0, c1);
+  __m256i t1 = _mm256_unpacklo_epi32(c2, c3);
+  __m256i t2 = _mm256_unpackhi_epi32(c0, c1);
+  __m256i t3 = _mm256_unpackhi_epi32(c2, c3);
+
+  __m256i u0 = _mm256_unpacklo_epi64(t0, t1); // [b0 | b4]
+  __m256i u1 = _mm256_unpackhi_epi64(t0, t1); // [b1 | b5]
+  __m256i u2 = _mm256_unpacklo_epi64(t2, t3); // [b2 | b6]
+  __m256i u3 = _mm256_unpackhi_epi64(t2, t3); // [b3 | b7]
+
+  generate_store(dest + 0U,  _mm256_permute2x128_si256(u0, u1, 0x20), stream);
+  generate_store(dest + 8U,  _mm256_permute2x128_si256(u2, u3, 0x20), stream);
+  generate_store(dest + 16U, _mm256_permute2x128_si256(u0, u1, 0x31), stream);
+  generate_store(dest + 24U, _mm256_permute2x128_si256(u2, u3, 0x31), stream);
+}
+
+#define PHILOX_VECTOR_BLOCKS 8U
+
+inline
+void philox_vector_blocks(u32* dest, u64 block, u64 seed, bool stream) {
+  philox_8_blocks(dest, block, seed, stream);
+}
+#elif defined(CPEAK_SSE2)
+inline
+void philox_4_blocks(u32* dest, u64 block, u64 seed, bool stream) {
+  u32 c0_values[4];
+  u32 c1_values[4];
+
+  for(u32 b = 0U; b < 4U; ++b) {
+    c0_values[b] = (u32)(block + b);
+    c1_values[b] = (u32)((block + b) >> 32);
+  }
+
+  __m128i c0 = _mm_loadu_si128((const __m128i*)c0_values);
+  __m128i c1 = _mm_loadu_si128((const __m128i*)c1_values);
+  __m128i c2 = _mm_setzero_si128();
+  __m128i c3 = _mm_setzero_si128();
+  __m128i m0 = _mm_set1_epi32((int)PHILOX_M0);
+  __m128i m1 = _mm_set1_epi32((int)PHILOX_M1);
+  u32 k0 = (u32)seed;
+  u32 k1 = (u32)(seed >> 32);
+
+  for(u32 r = 0U; r < PHILOX_ROUNDS; ++r) {
+    __m128i lo0, hi0, lo1, hi1;
+
+    mul_lo_hi_sse2(m0, c0, &lo0, &hi0);
+    mul_lo_hi_sse2(m1, c2, &lo1, &hi1);
+
+    c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), _mm_set1_epi32((int)k0));
+    c1 = lo1;
+    c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), _mm_set1_epi32((int)k1));
+    c3 = lo0;
+
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+
+  // 4x4 transpose, lane b of c0..c3 is block b
+  __m128i t0 = _mm_unpacklo_epi32(c0, c1);
+  __m128i t1 = _mm_unpacklo_epi32(c2, c3);
+  __m128i t2 = _mm_unpackhi_epi32(c0, c1);
+  __m128i t3 = _mm_unpackhi_epi32(c2, c3);
+
+  generate_store(dest + 0U,  _mm_unpacklo_epi64(t0, t1), stream);
+  generate_store(dest + 4U,  _mm_unpackhi_epi64(t0, t1), stream);
+  generate_store(dest + 8U,  _mm_unpacklo_epi64(t2, t3), stream);
+  generate_store(dest + 12U, _mm_unpackhi_epi64(t2, t3), stream);
+}
+
+#define PHILOX_VECTOR_BLOCKS 4U
+
+inline
+void philox_vector_blocks(u32* dest, u64 block, u64 seed, bool stream) {
+  philox_4_blocks(dest, block, seed, stream);
+}
+#endif
+
+// dest[i] = philox_word(first + i, seed)
+
+inline
+void random_into(u32* dest, size_type count, u64 first, u64 seed, bool stream) {
+  size_type i = 0;
+
+  // scalar up to a block boundary and, when streaming, to an aligned destination
+  while(i < count && (((first + i) % 4U) != 0U || generate_head_count(dest + i, count - i, stream) != 0U)) {
+    dest[i] = philox_word(first + i, seed);
+    ++i;
+  }
+
+#if defined(PHILOX_VECTOR_BLOCKS)
+  for(; i + 4U * PHILOX_VECTOR_BLOCKS <= count; i += 4U * PHILOX_VECTOR_BLOCKS) {
+    philox_vector_blocks(dest + i, (first + i) / 4U, seed, stream);
+  }
+#endif
+
+  for(; i + 4U <= count; i += 4U) {
+    philox_block(dest + i, (first + i) / 4U, seed);
+  }
+
+  for(; i < count; ++i) {
+    dest[i] = philox_word(first + i, seed);
+  }
+
+  generate_finish(stream);
+}
+
+// dest[i] = mulhi(philox_word(first + i, seed), bound)
+// reduced in place in chunks that stay in L1, so this uses regular stores
+
+inline
+void random_below_into(u32* dest, size_type count, u64 first, u64 seed, u32 bound) {
+  for(size_type i = 0; i < count; i += GENERATE_BELOW_CHUNK) {
+    size_type n = MINIMUM(count - i, (size_type)GENERATE_BELOW_CHUNK);
+
+    random_into(dest + i, n, first + i, seed, false);
+    arith_into<arith_op_mulhi>(dest + i, dest + i, &bound, 0U, n);
+  }
+}
+
+//
+// array constructors, the threaded ones split the output into one range per thread
+//
+
+template <typename Op>
+inline
+array_u32 generate(allocator a, size_type count, u32 thread_count, Op op) {
+  array_u32 result;
+
+  result.count = count;
+  result.ptr   = (u32*)cpeak_alloc(a, count * sizeof(u32));
+
+  bool stream = generate_streaming(count);
+
+  thread_count = parallel_thread_count_for(count, thread_count, GENERATE_MIN_PER_THREAD);
+
+  parallel_for_ranges(thread_count, count, [&](u32, size_type begin, size_type end) {
+    op(result.ptr + begin, end - begin, (u64)begin, stream);
+  });
+
+  return result;
+}
+
+inline
+array_u32 fill_u32(allocator a, size_type count, u32 value, u32 thread_count) {
+  return generate(a, count, thread_count, [value](u32* dest, size_type n, u64, bool stream) {
+    fill_into(dest, n, value, stream);
+  });
+}
+
+inline
+array_u32 fill_u32(allocator a, size_type count, u32 value) {
+  return fill_u32(a, count, value, 1U);
+}
+
+inline
+void fill(array_u32 x, u32 value) {
+  fill_into(x.ptr, x.count, value, generate_streaming(x.count));
+}
+
+inline
+array_u32 iota_u32(allocator a, size_type count, u32 start, u32 step, u32 thread_count) {
+  return generate(a, count, thread_count, [start, step](u32* dest, size_type n, u64 first, bool stream) {
+    iota_into(dest, n, first, start, step, stream);
+  });
+}
+
+inline
+array_u32 iota_u32(allocator a, size_type count, u32 start, u32 step) {
+  return iota_u32(a, count, start, step, 1U);
+}
+
+inline
+array_u32 random_u32(allocator a, size_type count, u64 seed, u32 thread_count) {
+  return generate(a, count, thread_count, [seed](u32* dest, size_type n, u64 first, bool stream) {
+    random_into(dest, n, first, seed, stream);
+  });
+}
+
+inline
+array_u32 random_u32(allocator a, size_type count, u64 seed) {
+  return random_u32(a, count, seed, 1U);
+}
+
+inline
+array_u32 random_below(allocator a, size_type count, u32 bound, u64 seed, u32 thread_count) {
+  return generate(a, count, thread_count, [seed, bound](u32* dest, size_type n, u64 first, bool) {
+    random_below_into(dest, n, first, seed, bound);
+  });
+}
+
+inline
+array_u32 random_below(allocator a, size_type count, u32 bound, u64 seed) {
+  return random_below(a, count, bound, seed, 1U);
+}
+
+#endif
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "array_u32.h"
+#include "array_u32_generate.h"
+
+// the generators against philox_word and scalar loops, on lengths with
+// vector tails, on 1 and 4 threads and past GENERATE_STREAM_BYTES, where
+// the stores are non-temporal
+
+bool same(array_u32 x, array_u32 y) {
+  bool result = x.count == y.count;
+
+  for(size_type i = 0; result && i < x.count; ++i)
+    result = x.ptr[i] == y.ptr[i];
+
+  return result;
+}
+
+int main(int argc, char** argv) {
+  allocator ai = std_alloc;
+
+  // Random123 known answer: Philox4x32-10, counter 0, key 0
+
+  u32 block[4];
+
+  philox_block(block, 0U, 0U);
+  printf("philox kat: %08x %08x %08x %08x, ok: %d\n", block[0], block[1], block[2], block[3],
+         block[0] == 0x6627e8d5U && block[1] == 0xe169c58dU && block[2] == 0xbc57ac4cU && block[3] == 0x9b00dbd8U);
+
+  size_type counts[] = { 0, 1, 5, 31, 33, 1000, 1100003, 9000001 };
+
+  for(u32 c = 0U; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+    size_type count = counts[c];
+    u64 seed = 0x0123456789ABCDEFULL + c;
+    u32 bound = 1000U + c;
+
+    array_u32 random = random_u32(ai, count, seed);
+    array_u32 below = random_below(ai, count, bound, seed);
+    array_u32 iota = iota_u32(ai, count, 7U, 0x9E3779B9U);
+    array_u32 filled = fill_u32(ai, count, 0xABCDU);
+
+    bool randoms = true;
+    bool belows = true;
+    bool iotas = true;
+    bool fills = true;
+
+    for(size_type i = 0; i < count; ++i) {
+      u32 word = philox_word(i, seed);
+
+      randoms = randoms && random.ptr[i] == word;
+      belows = belows && below.ptr[i] == (u32)(((u64)word * bound) >> 32);
+      iotas = iotas && iota.ptr[i] == 7U + (u32)i * 0x9E3779B9U;
+      fills = fills && filled.ptr[i] == 0xABCDU;
+    }
+
+    // the threaded versions produce the same values
+
+    bool threaded = same(random_u32(ai, count, seed, 4U), random) && same(random_below(ai, count, bound, seed, 4U), below) &&
+                    same(iota_u32(ai, count, 7U, 0x9E3779B9U, 4U), iota) && same(fill_u32(ai, count, 0xABCDU, 4U), filled);
+
+    fill(random, 3U);
+
+    for(size_type i = 0; i < count; ++i)
+      fills = fills && random.ptr[i] == 3U;
+
+    printf("count %u: random_u32 %d, random_below %d, iota %d, fill %d, threaded %d\n",
+           (u32)count, randoms, belows, iotas, fills, threaded);
+
+    cpeak_free(ai, random.ptr);
+    cpeak_free(ai, below.ptr);
+    cpeak_free(ai, iota.ptr);
+    cpeak_free(ai, filled.ptr);
+  }
+
+  return 0;
+}
@@ -0,0 +1,525 @@
+/**
+ *  array_u32_packed.h
+ *
+ *  Compressed storage for arrays of u32 values.
+ *
+ *  Values are split into blocks of 128 and each block is bit-packed with
+ *  the smallest bit width that fits all of its (coded) values. The payload
+ *  uses the 4-lane vertical layout: value i of a block goes to lane i % 4,
+ *  so that one 128-bit register packs/unpacks 4 values at a time. The
+ *  scalar fallback writes the exact same layout.
+ *
+ *  Codings:
+ *  packed_coding_plain        - the values as they are.
+ *  packed_coding_delta        - x[i] - x[i - 4], for sorted input.
+ *  packed_coding_delta_zigzag - zigzag-coded deltas, for unsorted input
+ *                               where neighbouring values are close.
+ *
+ *  Blocks are independently decodable (delta codings store the 4 values
+ *  preceding each block as a seed), so random access costs one block
+ *  decode at most.
+ */
+
+#ifndef U32_ARRAY_PACKED_H
+#define U32_ARRAY_PACKED_H
+
+#include <assert.h>
+#include <string.h>
+#include "types.h"
+#include "macro.h"
+#include "alloc.h"
+#include "bits.h"
+#include "simd.h"
+#include "array_u32.h"
+
+#define PACKED_BLOCK_COUNT 128U
+#define PACKED_LANE_COUNT  4U
+
+enum packed_coding_enum {
+  packed_coding_plain        = 0,
+  packed_coding_delta        = 1,
+  packed_coding_delta_zigzag = 2,
+};
+
+typedef struct array_packed_u32 {
+  u32*      words;        // payload, 4 * bits words per block
+  usize*    block_offset; // word offset of each block into 'words'
+  u8*       block_bits;   // bit width of each block
+  u32*      block_seed;   // 4 values preceding each block (delta codings only)
+  size_type count;
+  size_type block_count;
+  u32       coding;
+} array_packed_u32;
+
+inline
+size_type length(array_packed_u32 arr) {
+  return arr.count;
+}
+
+// memory footprint of the packed representation in bytes (including block metadata)
+
+inline
+usize packed_size_bytes(array_packed_u32 arr) {
+  usize result = 0U;
+
+  if(arr.block_count > 0U) {
+    size_type last = arr.block_count - 1U;
+    usize word_count = arr.block_offset[last] + PACKED_LANE_COUNT * (usize)arr.block_bits[last];
+
+    result += word_count * sizeof(u32);
+    result += arr.block_count * (sizeof(usize) + sizeof(u8));
+
+    if(arr.coding != packed_coding_plain)
+      result += arr.block_count * PACKED_LANE_COUNT * sizeof(u32);
+  }
+
+  return result;
+}
+
+//
+// coding of a single block (in place, 128 values)
+//
+
+inline
+void packed_encode_block(u32* values, const u32* seed, u32 coding) {
+  if(coding == packed_coding_plain)
+    return;
+
+#if defined(CPEAK_SSE2)
+  __m128i prev = _mm_loadu_si128((const __m128i*)seed);
+
+  for(u32 j = 0U; j < PACKED_BLOCK_COUNT; j += PACKED_LANE_COUNT) {
+    __m128i cur = _mm_loadu_si128((const __m128i*)(values + j));
+    __m128i d   = _mm_sub_epi32(cur, prev);
+
+    if(coding == packed_coding_delta_zigzag)
+      d = _mm_xor_si128(_mm_slli_epi32(d, 1), _mm_srai_epi32(d, 31));
+
+    _mm_storeu_si128((__m128i*)(values + j), d);
+    prev = cur;
+  }
+#else
+  u32 prev[PACKED_LANE_COUNT] = { seed[0], seed[1], seed[2], seed[3] };
+
+  for(u32 j = 0U; j < PACKED_BLOCK_COUNT; ++j) {
+    u32 lane = j & (PACKED_LANE_COUNT - 1U);
+    u32 cur = values[j];
+    u32 d = cur - prev[lane];
+
+    if(coding == packed_coding_delta_zigzag)
+      d = (d << 1U) ^ (u32)((i32)d >> 31);
+
+    values[j] = d;
+    prev[lane] = cur;
+  }
+#endif
+}
+
+inline
+void packed_decode_block(u32* values, const u32* seed, u32 coding) {
+  if(coding == packed_coding_plain)
+    return;
+
+#if defined(CPEAK_SSE2)
+  __m128i prev = _mm_loadu_si128((const __m128i*)seed);
+  __m128i one  = _mm_set1_epi32(1);
+
+  for(u32 j = 0U; j < PACKED_BLOCK_COUNT; j += PACKED_LANE_COUNT) {
+    __m128i d = _mm_loadu_si128((const __m128i*)(values + j));
+
+    if(coding == packed_coding_delta_zigzag) {
+      __m128i sign = _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(d, one));
+      d = _mm_xor_si128(_mm_srli_epi32(d, 1), sign);
+    }
+
+    prev = _mm_add_epi32(prev, d);
+    _mm_storeu_si128((__m128i*)(values + j), prev);
+  }
+#else
+  u32 prev[PACKED_LANE_COUNT] = { seed[0], seed[1], seed[2], seed[3] };
+
+  for(u32 j = 0U; j < PACKED_BLOCK_COUNT; ++j) {
+    u32 lane = j & (PACKED_LANE_COUNT - 1U);
+    u32 d = values[j];
+
+    if(coding == packed_coding_delta_zigzag)
+      d = (d >> 1U) ^ (0U - (d & 1U));
+
+    prev[lane] += d;
+    values[j] = prev[lane];
+  }
+#endif
+}
+
+//
+// bit-packing of a single block (128 values -> 4 * bits words)
+//
+
+inline
+void packed_pack_block(const u32* in, u32* out, u32 bits) {
+  if(bits == 0U)
+    return;
+
+#if defined(CPEAK_SSE2)
+  __m128i acc = _mm_setzero_si128();
+  u32 shift = 0U;
+
+  for(u32 j = 0U; j < PACKED_BLOCK_COUNT; j += PACKED_LANE_COUNT) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(in + j));
+
+    acc = _mm_or_si128(acc, _mm_sll_epi32(v, _mm_cvtsi32_si128((int)shift)));
+    shift += bits;
+
+    if(shift >= 32U) {
+      _mm_storeu_si128((__m128i*)out, acc);
+      out += PACKED_LANE_COUNT;
+      shift -= 32U;
+
+      // carry the bits that didn't fit into the next word (zero if none)
+      acc = (shift != 0U) ? _mm_srl_epi32(v, _mm_cvtsi32_si128((int)(bits - shift))) : _mm_setzero_si128();
+    }
+  }
+#else
+  u32 acc[PACKED_LANE_COUNT] = { 0U, 0U, 0U, 0U };
+  u32 shift = 0U;
+
+  for(u32 j = 0U; j < PACKED_BLOCK_COUNT; j += PACKED_LANE_COUNT) {
+    for(u32 lane = 0U; lane < PACKED_LANE_COUNT; ++lane)
+      acc[lane] |= in[j + lane] << shift;
+
+    shift += bits;
+
+    if(shift >= 32U) {
+      shift -= 32U;
+
+      for(u32 lane = 0U; lane < PACKED_LANE_COUNT; ++lane) {
+        out[lane] = acc[lane];
+        acc[lane] = (shift != 0U) ? (in[j + lane] >> (bits - shift)) : 0U;
+      }
+
+      out += PACKED_LANE_COUNT;
+    }
+  }
+#endif
+}
+
+inline
+void packed_unpack_block(const u32* in, u32* out, u32 bits) {
+  if(bits == 0U) {
+    memset(out, 0, PACKED_BLOCK_COUNT * sizeof(u32));
+    return;
+  }
+
+  u32 mask_value = (bits == 32U) ? 0xFFFFFFFFU : ((1U << bits) - 1U);
+
+#if defined(CPEAK_SSE2)
+  __m128i mask = _mm_set1_epi32((int)mask_value);
+  __m128i w = _mm_loadu_si128((const __m128i*)in);
+  u32 shift = 0U;
+
+  in += PACKED_LANE_COUNT;
+
+  for(u32 j = 0U; j < PACKED_BLOCK_COUNT; j += PACKED_LANE_COUNT) {
+    __m128i v = _mm_srl_epi32(w, _mm_cvtsi32_si128((int)shift));
+    shift += bits;
+
+    if(shift > 32U) {
+      w = _mm_loadu_si128((const __m128i*)in);
+      in += PACKED_LANE_COUNT;
+      shift -= 32U;
+
+      v = _mm_or_si128(v, _mm_sll_epi32(w, _mm_cvtsi32_si128((int)(bits - shift))));
+    } else if(shift == 32U && j + PACKED_LANE_COUNT < PACKED_BLOCK_COUNT) {
+      w = _mm_loadu_si128((const __m128i*)in);
+      in += PACKED_LANE_COUNT;
+      shift = 0U;
+    }
+
+    _mm_storeu_si128((__m128i*)(out + j), _mm_and_si128(v, mask));
+  }
+#else
+  u32 w[PACKED_LANE_COUNT] = { in[0], in[1], in[2], in[3] };
+  u32 v[PACKED_LANE_COUNT];
+  u32 shift = 0U;
+
+  in += PACKED_LANE_COUNT;
+
+  for(u32 j = 0U; j < PACKED_BLOCK_COUNT; j += PACKED_LANE_COUNT) {
+    for(u32 lane = 0U; lane < PACKED_LANE_COUNT; ++lane)
+      v[lane] = w[lane] >> shift;
+
+    shift += bits;
+
+    if(shift > 32U) {
+      shift -= 32U;
+
+      for(u32 lane = 0U; lane < PACKED_LANE_COUNT; ++lane) {
+        w[lane] = in[lane];
+        v[lane] |= w[lane] << (bits - shift);
+      }
+
+      in += PACKED_LANE_COUNT;
+    } else if(shift == 32U && j + PACKED_LANE_COUNT < PACKED_BLOCK_COUNT) {
+      for(u32 lane = 0U; lane < PACKED_LANE_COUNT; ++lane)
+        w[lane] = in[lane];
+
+      in += PACKED_LANE_COUNT;
+      shift = 0U;
+    }
+
+    for(u32 lane = 0U; lane < PACKED_LANE_COUNT; ++lane)
+      out[j + lane] = v[lane] & mask_value;
+  }
+#endif
+}
+
+inline
+u32 packed_block_width(const u32* values) {
+  u32 acc = 0U;
+
+  for(u32 j = 0U; j < PACKED_BLOCK_COUNT; ++j)
+    acc |= values[j];
+
+  return bits_width_u32(acc);
+}
+
+// copies block 'block' of x into a full 128-value buffer, padding the tail
+// so that it codes to zeros (zero for plain, repeat of the lane's value for
+// deltas); a tail shorter than a row is padded with its last value, whose
+// delta to the seed is no wider than the values' own
+
+inline
+size_type packed_load_block(u32* dest, array_u32 x, size_type block, u32 coding) {
+  size_type first = block * PACKED_BLOCK_COUNT;
+  size_type n = MINIMUM(x.count - first, (size_type)PACKED_BLOCK_COUNT);
+
+  memcpy(dest, x.ptr + first, n * sizeof(u32));
+
+  for(size_type i = n; i < PACKED_BLOCK_COUNT; ++i) {
+    if(coding == packed_coding_plain)
+      dest[i] = 0U;
+    else if(i < PACKED_LANE_COUNT)
+      dest[i] = dest[n - 1U];
+    else
+      dest[i] = dest[i - PACKED_LANE_COUNT];
+  }
+
+  return n;
+}
+
+inline
+void packed_block_seed(u32* seed, array_u32 x, size_type block) {
+  if(block == 0U) {
+    seed[0] = seed[1] = seed[2] = seed[3] = 0U;
+  } else {
+    memcpy(seed, x.ptr + block * PACKED_BLOCK_COUNT - PACKED_LANE_COUNT, PACKED_LANE_COUNT * sizeof(u32));
+  }
+}
+
+//
+// construction and decoding
+//
+
+inline
+array_packed_u32 pack_u32(allocator a, array_u32 x, u32 coding) {
+  array_packed_u32 result;
+  u32 buffer[PACKED_BLOCK_COUNT];
+  u32 seed[PACKED_LANE_COUNT];
+
+  size_type block_count = (x.count + PACKED_BLOCK_COUNT - 1U) / PACKED_BLOCK_COUNT;
+
+  result.count        = x.count;
+  result.block_count  = block_count;
+  result.coding       = coding;
+  result.block_offset = (usize*)cpeak_alloc(a, block_count * sizeof(usize));
+  result.block_bits   = (u8*)cpeak_alloc(a, block_count * sizeof(u8));
+  result.block_seed   = 0;
+
+  if(coding != packed_coding_plain)
+    result.block_seed = (u32*)cpeak_alloc(a, block_count * PACKED_LANE_COUNT * sizeof(u32));
+
+  // pass 1: bit widths and payload offsets (usize, under CPEAK_64BIT the
+  // payload can pass 2^32 words)
+
+  usize word_count = 0U;
+
+  for(size_type b = 0U; b < block_count; ++b) {
+    packed_load_block(buffer, x, b, coding);
+    packed_block_seed(seed, x, b);
+    packed_encode_block(buffer, seed, coding);
+
+    u32 bits = packed_block_width(buffer);
+
+    result.block_offset[b] = word_count;
+    result.block_bits[b]   = (u8)bits;
+
+    if(coding != packed_coding_plain)
+      memcpy(result.block_seed + b * PACKED_LANE_COUNT, seed, sizeof(seed));
+
+    word_count += PACKED_LANE_COUNT * bits;
+  }
+
+  // pass 2: the payload
+
+  result.words = (u32*)cpeak_alloc(a, word_count * sizeof(u32));
+
+  for(size_type b = 0U; b < block_count; ++b) {
+    packed_load_block(buffer, x, b, coding);
+    packed_block_seed(seed, x, b);
+    packed_encode_block(buffer, seed, coding);
+    packed_pack_block(buffer, result.words + result.block_offset[b], result.block_bits[b]);
+  }
+
+  return result;
+}
+
+// decodes block 'block' into dest (room for 128 values), returns the number of valid values
+
+inline
+size_type unpack_block(array_packed_u32 arr, size_type block, u32* dest) {
+  assert(block < arr.block_count);
+
+  packed_unpack_block(arr.words + arr.block_offset[block], dest, arr.block_bits[block]);
+
+  if(arr.coding != packed_coding_plain)
+    packed_decode_block(dest, arr.block_seed + block * PACKED_LANE_COUNT, arr.coding);
+
+  size_type first = block * PACKED_BLOCK_COUNT;
+
+  return MINIMUM(arr.count - first, (size_type)PACKED_BLOCK_COUNT);
+}
+
+inline
+array_u32 unpack_u32(allocator a, array_packed_u32 arr) {
+  array_u32 result;
+  u32 buffer[PACKED_BLOCK_COUNT];
+
+  result.count = arr.count;
+  result.ptr   = (u32*)cpeak_alloc(a, result.count * sizeof(u32));
+
+  size_type full_blocks = arr.count / PACKED_BLOCK_COUNT;
+
+  // full blocks decode straight into the destination
+
+  for(size_type b = 0U; b < full_blocks; ++b)
+    unpack_block(arr, b, result.ptr + b * PACKED_BLOCK_COUNT);
+
+  if(full_blocks < arr.block_count) {
+    size_type n = unpack_block(arr, full_blocks, buffer);
+    memcpy(result.ptr + full_blocks * PACKED_BLOCK_COUNT, buffer, n * sizeof(u32));
+  }
+
+  return result;
+}
+
+// random access to a single value
+
+inline
+u32 get(array_packed_u32 arr, size_type index) {
+  assert(index < arr.count);
+
+  size_type block = index / PACKED_BLOCK_COUNT;
+  u32 i    = (u32)(index % PACKED_BLOCK_COUNT);
+  u32 lane = i % PACKED_LANE_COUNT;
+  u32 row  = i / PACKED_LANE_COUNT;
+  u32 bits = arr.block_bits[block];
+
+  const u32* lane_words = arr.words + arr.block_offset[block] + lane;
+  u32 mask = (bits == 32U) ? 0xFFFFFFFFU : ((1U << bits) - 1U);
+
+  // the deltas need the whole lane prefix, plain values are extracted directly
+
+  u32 first_row = (arr.coding == packed_coding_plain) ? row : 0U;
+  u32 result = (arr.coding == packed_coding_plain) ? 0U : arr.block_seed[block * PACKED_LANE_COUNT + lane];
+
+  for(u32 r = first_row; r <= row; ++r) {
+    u32 bit   = r * bits;
+    u32 word  = bit / 32U;
+    u32 shift = bit % 32U;
+    u32 v = 0U;
+
+    if(bits != 0U) {
+      v = lane_words[word * PACKED_LANE_COUNT] >> shift;
+
+      if(shift + bits > 32U)
+        v |= lane_words[(word + 1U) * PACKED_LANE_COUNT] << (32U - shift);
+
+      v &= mask;
+    }
+
+    if(arr.coding == packed_coding_plain) {
+      result = v;
+    } else {
+      if(arr.coding == packed_coding_delta_zigzag)
+        v = (v >> 1U) ^ (0U - (v & 1U));
+
+      result += v;
+    }
+  }
+
+  return result;
+}
+
+//
+// streaming decode: blocks are decoded into a stack buffer and handed out
+// as array_u32 views, so that they can feed the elementwise kernels directly
+//
+
+template <typename Op>
+inline
+void for_each_block(array_packed_u32 arr, Op op) {
+  u32 buffer[PACKED_BLOCK_COUNT];
+
+  for(size_type b = 0U; b < arr.block_count; ++b) {
+    array_u32 view;
+
+    view.ptr   = buffer;
+    view.count = unpack_block(arr, b, buffer);
+
+    op(view);
+  }
+}
+
+template <typename Op>
+inline
+array_u32 map(allocator a, Op op, array_packed_u32 x, array_u32 y) {
+  array_u32 result;
+  u32 buffer[PACKED_BLOCK_COUNT];
+
+  result.count = MINIMUM(x.count, y.count);
+  result.ptr   = (u32*)cpeak_alloc(a, result.count * sizeof(u32));
+
+  for(size_type b = 0U; b * PACKED_BLOCK_COUNT < result.count; ++b) {
+    size_type first = b * PACKED_BLOCK_COUNT;
+    size_type n = MINIMUM(unpack_block(x, b, buffer), result.count - first);
+
+    for(size_type i = 0; i < n; ++i) {
+      result.ptr[first + i] = op(buffer[i], y.ptr[first + i]);
+    }
+  }
+
+  return result;
+}
+
+template <typename Op>
+inline
+array_u32 map(allocator a, Op op, array_packed_u32 x, u32 y) {
+  array_u32 result;
+  u32 buffer[PACKED_BLOCK_COUNT];
+
+  result.count = x.count;
+  result.ptr   = (u32*)cpeak_alloc(a, result.count * sizeof(u32));
+
+  for(size_type b = 0U; b < x.block_count; ++b) {
+    size_type first = b * PACKED_BLOCK_COUNT;
+    size_type n = unpack_block(x, b, buffer);
+
+    for(size_type i = 0; i < n; ++i) {
+      result.ptr[first + i] = op(buffer[i], y);
+    }
+  }
+
+  return result;
+}
+
+#endif
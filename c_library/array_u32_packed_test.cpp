@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "array_u32.h"
+#include "array_u32_packed.h"
+
+void print_packed(cstring name, array_u32 x, u32 coding) {
+  allocator ai = std_alloc;
+
+  array_packed_u32 p = pack_u32(ai, x, coding);
+  array_u32 y = unpack_u32(ai, p);
+
+  u32 mismatches = 0U;
+  for(size_type i = 0; i < x.count; ++i) {
+    if(y.ptr[i] != x.ptr[i] || get(p, i) != x.ptr[i])
+      ++mismatches;
+  }
+
+  printf("%s: %u values, %u bytes -> %u bytes, %u mismatches\n",
+    name, (u32)x.count, (u32)(x.count * sizeof(u32)), (u32)packed_size_bytes(p), mismatches);
+}
+
+int main(int argc, char** argv) {
+  allocator ai = std_alloc;
+
+  const size_type count = 100000U;
+
+  // sorted ids with small gaps
+
+  array_u32 ids = iota_u32(ai, count);
+  for(size_type i = 1; i < count; ++i) {
+    ids.ptr[i] = ids.ptr[i - 1] + 1U + (u32)(rand() % 7);
+  }
+
+  print_packed("sorted ids, plain", ids, packed_coding_plain);
+  print_packed("sorted ids, delta", ids, packed_coding_delta);
+
+  // small values
+
+  array_u32 small = zero_u32(ai, count);
+  for(size_type i = 0; i < count; ++i) {
+    small.ptr[i] = (u32)(rand() % 1000);
+  }
+
+  print_packed("small values, plain", small, packed_coding_plain);
+  print_packed("small values, delta zigzag", small, packed_coding_delta_zigzag);
+
+  // a delta-coded tail shorter than a row is as narrow as the blocks before it
+
+  array_u32 tail = iota_u32(ai, 2U * PACKED_BLOCK_COUNT + 2U);
+  for(size_type i = 0; i < tail.count; ++i) {
+    tail.ptr[i] = 1000000000U + 3U * (u32)i;
+  }
+
+  array_packed_u32 tp = pack_u32(ai, tail, packed_coding_delta);
+  print_packed("short delta tail", tail, packed_coding_delta);
+  printf("  block bits: %u %u %u\n", (u32)tp.block_bits[0], (u32)tp.block_bits[1], (u32)tp.block_bits[2]);
+
+  // elementwise op on the streamed blocks
+
+  array_packed_u32 p = pack_u32(ai, iota_u32(ai, 300), packed_coding_delta);
+  print(take(map(ai, [](u32 x, u32 y) { return x * y; }, p, 2U), 16));
+  printf("\n");
+
+  return 0;
+}
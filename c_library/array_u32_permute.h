@@ -0,0 +1,342 @@
+/**
+ *  array_u32_permute.h
+ *
+ *  Index-driven kernels: gather, scatter and permutation inversion.
+ *
+ *  gather(values, indices)        - result[i] = values[indices[i]]
+ *  scatter(dst, indices, values)  - dst[indices[i]] = values[i] (in order, last write wins)
+ *  invert_permutation(p)          - result[p[i]] = i
+ *
+ *  Random accesses into a large array are dominated by cache and TLB
+ *  misses, so there are three execution modes:
+ *  permute_mode_direct      - plain loop (AVX2 gathers for gather).
+ *  permute_mode_prefetch    - direct, plus software prefetching a fixed
+ *                             distance ahead. Helps when the random side
+ *                             is larger than L2 but a few misses can overlap.
+ *  permute_mode_partitioned - the (index, payload) pairs are first radix
+ *                             partitioned on the high index bits, so that
+ *                             each partition only touches a cache-sized
+ *                             range of the random side. Costs extra
+ *                             sequential passes and 2 * count words of scratch,
+ *                             wins for huge random permutations.
+ *  permute_mode_auto picks one from the size of the randomly accessed array,
+ *  the thresholds are the PERMUTE_*_BYTES defines.
+ *
+ *  Scratch memory comes from the allocator that receives the result and is
+ *  released with cpeak_free before returning.
+ */
+
+#ifndef U32_ARRAY_PERMUTE_H
+#define U32_ARRAY_PERMUTE_H
+
+#include <assert.h>
+#include <string.h>
+#include "types.h"
+#include "macro.h"
+#include "alloc.h"
+#include "bits.h"
+#include "simd.h"
+#include "array_u32.h"
+
+#define PERMUTE_PREFETCH_DISTANCE      32U
+#define PERMUTE_CACHE_BYTES            (256U * 1024U)          // random range covered by one partition
+#define PERMUTE_PREFETCH_BYTES         (256U * 1024U)          // random side that still fits L2
+#define PERMUTE_PARTITION_BYTES        (256U * 1024U * 1024U)  // scatter: random side where partitioning pays off
+#define PERMUTE_GATHER_PARTITION_BYTES (1024U * 1024U * 1024U) // gather: needs an extra pass, so a larger threshold
+#define PERMUTE_MAX_PARTITIONS         1024U                   // fan-out limit, keeps the write streams TLB friendly
+
+enum permute_mode_enum {
+  permute_mode_auto,
+  permute_mode_direct,
+  permute_mode_prefetch,
+  permute_mode_partitioned,
+};
+
+inline
+u32 permute_pick_mode(u32 mode, size_type random_count, u64 partition_bytes) {
+  if(mode != permute_mode_auto)
+    return mode;
+
+  u64 random_bytes = (u64)random_count * sizeof(u32);
+
+  if(random_bytes <= PERMUTE_PREFETCH_BYTES)
+    return permute_mode_direct;
+  else if(random_bytes <= partition_bytes)
+    return permute_mode_prefetch;
+  else
+    return permute_mode_partitioned;
+}
+
+inline
+void permute_prefetch(const u32* ptr) {
+#if defined(CPEAK_SSE2)
+  _mm_prefetch((const char*)ptr, _MM_HINT_T0);
+#elif defined(__GNUC__)
+  __builtin_prefetch(ptr);
+#endif
+}
+
+//
+// radix partitioning of (key, payload) pairs on key >> shift
+//
+
+typedef struct permute_partitioning {
+  u32  shift;
+  u32  partition_count;
+  u32* offsets; // partition_count + 1 entries
+} permute_partitioning;
+
+// picks the shift so that one partition covers about PERMUTE_CACHE_BYTES of a domain of 'domain_count' elements
+
+inline
+permute_partitioning make_permute_partitioning(allocator a, size_type domain_count) {
+  permute_partitioning result;
+
+  u32 domain_bits = bits_width_u32(domain_count > 0U ? (u32)(domain_count - 1U) : 0U);
+  u32 cache_bits  = bits_width_u32(PERMUTE_CACHE_BYTES / sizeof(u32)) - 1U;
+  u32 max_bits    = bits_width_u32(PERMUTE_MAX_PARTITIONS) - 1U;
+
+  u32 partition_bits = (domain_bits > cache_bits) ? (domain_bits - cache_bits) : 0U;
+  partition_bits = MINIMUM(partition_bits, max_bits);
+
+  result.shift           = domain_bits - partition_bits;
+  result.partition_count = 1U << partition_bits;
+  result.offsets         = (u32*)cpeak_alloc(a, (result.partition_count + 1U) * sizeof(u32));
+
+  return result;
+}
+
+#define PERMUTE_WC_COUNT 16U // pairs per write-combining buffer, one cache line of keys
+
+// a null payload stands for the identity payload[i] = i
+
+inline
+void permute_partition(allocator a, permute_partitioning* p, const u32* keys, const u32* payload, size_type count,
+                       u32* out_keys, u32* out_payload) {
+  u32* offsets = p->offsets;
+  u32 shift = p->shift;
+  u32 partition_count = p->partition_count;
+
+  memset(offsets, 0, (partition_count + 1U) * sizeof(u32));
+
+  for(size_type i = 0; i < count; ++i) {
+    ++offsets[(keys[i] >> shift) + 1U];
+  }
+
+  for(u32 k = 0U; k < partition_count; ++k) {
+    offsets[k + 1U] += offsets[k];
+  }
+
+  // the pairs are staged in a cache-line sized buffer per partition and
+  // flushed a full line at a time (software write-combining), which keeps
+  // the many output streams from thrashing the cache and the TLB
+  //
+  // offsets[k] is the flush cursor of partition k, which leaves
+  // offsets[k] == start of partition k + 1 afterwards
+
+  u32* wc_keys    = (u32*)cpeak_alloc(a, partition_count * PERMUTE_WC_COUNT * sizeof(u32));
+  u32* wc_payload = (u32*)cpeak_alloc(a, partition_count * PERMUTE_WC_COUNT * sizeof(u32));
+  u32* wc_fill    = (u32*)cpeak_alloc(a, partition_count * sizeof(u32));
+
+  memset(wc_fill, 0, partition_count * sizeof(u32));
+
+  for(size_type i = 0; i < count; ++i) {
+    u32 key = keys[i];
+    u32 k = key >> shift;
+    u32 fill = wc_fill[k];
+    u32 slot = k * PERMUTE_WC_COUNT + fill;
+
+    wc_keys[slot]    = key;
+    wc_payload[slot] = payload ? payload[i] : (u32)i;
+
+    if(fill + 1U == PERMUTE_WC_COUNT) {
+      u32 dest = offsets[k];
+
+      memcpy(out_keys + dest, wc_keys + k * PERMUTE_WC_COUNT, PERMUTE_WC_COUNT * sizeof(u32));
+      memcpy(out_payload + dest, wc_payload + k * PERMUTE_WC_COUNT, PERMUTE_WC_COUNT * sizeof(u32));
+
+      offsets[k] = dest + PERMUTE_WC_COUNT;
+      wc_fill[k] = 0U;
+    } else {
+      wc_fill[k] = fill + 1U;
+    }
+  }
+
+  for(u32 k = 0U; k < partition_count; ++k) {
+    u32 dest = offsets[k];
+    u32 fill = wc_fill[k];
+
+    memcpy(out_keys + dest, wc_keys + k * PERMUTE_WC_COUNT, fill * sizeof(u32));
+    memcpy(out_payload + dest, wc_payload + k * PERMUTE_WC_COUNT, fill * sizeof(u32));
+
+    offsets[k] = dest + fill;
+  }
+
+  cpeak_free(a, wc_fill);
+  cpeak_free(a, wc_payload);
+  cpeak_free(a, wc_keys);
+
+  // restore the partition starts
+
+  for(u32 k = partition_count; k > 0U; --k) {
+    offsets[k] = offsets[k - 1U];
+  }
+
+  offsets[0] = 0U;
+}
+
+// dst[keys[i]] = payload[i], partitioned on the keys so the writes stay in cache
+
+inline
+void permute_scatter_partitioned(allocator a, u32* dst, size_type dst_count, const u32* keys, const u32* payload, size_type count) {
+  permute_partitioning p = make_permute_partitioning(a, dst_count);
+  u32* part_keys    = (u32*)cpeak_alloc(a, count * sizeof(u32));
+  u32* part_payload = (u32*)cpeak_alloc(a, count * sizeof(u32));
+
+  permute_partition(a, &p, keys, payload, count, part_keys, part_payload);
+
+  for(size_type i = 0; i < count; ++i) {
+    dst[part_keys[i]] = part_payload[i];
+  }
+
+  cpeak_free(a, part_payload);
+  cpeak_free(a, part_keys);
+  cpeak_free(a, p.offsets);
+}
+
+//
+// gather
+//
+
+inline
+void gather_direct(u32* dest, const u32* values, size_type values_count, const u32* indices, size_type count, bool prefetch) {
+  size_type i = 0;
+
+#if defined(CPEAK_AVX2)
+  // the AVX2 gather takes signed 32-bit indices, larger arrays use the scalar loop
+  size_type vector_count = ((u64)values_count <= 0x7FFFFFFFULL) ? count : 0U;
+
+  for(; i + 8U <= vector_count; i += 8U) {
+    if(prefetch && i + PERMUTE_PREFETCH_DISTANCE + 8U <= count) {
+      const u32* ahead = indices + i + PERMUTE_PREFETCH_DISTANCE;
+
+      for(u32 j = 0U; j < 8U; ++j)
+        permute_prefetch(values + ahead[j]);
+    }
+
+    __m256i idx = _mm256_loadu_si256((const __m256i*)(indices + i));
+    _mm256_storeu_si256((__m256i*)(dest + i), _mm256_i32gather_epi32((const int*)values, idx, 4));
+  }
+#endif
+
+  for(; i < count; ++i) {
+    if(prefetch && i + PERMUTE_PREFETCH_DISTANCE < count)
+      permute_prefetch(values + indices[i + PERMUTE_PREFETCH_DISTANCE]);
+
+    dest[i] = values[indices[i]];
+  }
+}
+
+inline
+array_u32 gather(allocator a, array_u32 values, array_u32 indices, u32 mode) {
+  array_u32 result;
+
+  result.count = indices.count;
+  result.ptr   = (u32*)cpeak_alloc(a, result.count * sizeof(u32));
+
+  mode = permute_pick_mode(mode, values.count, PERMUTE_GATHER_PARTITION_BYTES);
+
+  if(mode == permute_mode_partitioned) {
+    // 1: partition (index, position) on the index, the value reads of a partition stay in cache
+    // 2: read the values, giving (position, value) pairs in partition order
+    // 3: scatter them back, partitioned on the position
+
+    permute_partitioning p = make_permute_partitioning(a, values.count);
+    u32* part_indices   = (u32*)cpeak_alloc(a, result.count * sizeof(u32));
+    u32* part_positions = (u32*)cpeak_alloc(a, result.count * sizeof(u32));
+
+    permute_partition(a, &p, indices.ptr, 0, indices.count, part_indices, part_positions);
+
+    for(size_type i = 0; i < result.count; ++i) {
+      part_indices[i] = values.ptr[part_indices[i]];
+    }
+
+    permute_scatter_partitioned(a, result.ptr, result.count, part_positions, part_indices, result.count);
+
+    cpeak_free(a, part_positions);
+    cpeak_free(a, part_indices);
+    cpeak_free(a, p.offsets);
+  } else {
+    gather_direct(result.ptr, values.ptr, values.count, indices.ptr, indices.count, mode == permute_mode_prefetch);
+  }
+
+  return result;
+}
+
+inline
+array_u32 gather(allocator a, array_u32 values, array_u32 indices) {
+  return gather(a, values, indices, permute_mode_auto);
+}
+
+//
+// scatter
+//
+
+inline
+void scatter_direct(u32* dst, const u32* indices, const u32* values, size_type count, bool prefetch) {
+  for(size_type i = 0; i < count; ++i) {
+    if(prefetch && i + PERMUTE_PREFETCH_DISTANCE < count)
+      permute_prefetch(dst + indices[i + PERMUTE_PREFETCH_DISTANCE]);
+
+    dst[indices[i]] = values ? values[i] : (u32)i;
+  }
+}
+
+// 'a' is only used for scratch memory in the partitioned mode
+
+inline
+void scatter(allocator a, array_u32 dst, array_u32 indices, array_u32 values, u32 mode) {
+  size_type count = MINIMUM(indices.count, values.count);
+
+  mode = permute_pick_mode(mode, dst.count, PERMUTE_PARTITION_BYTES);
+
+  if(mode == permute_mode_partitioned)
+    permute_scatter_partitioned(a, dst.ptr, dst.count, indices.ptr, values.ptr, count);
+  else
+    scatter_direct(dst.ptr, indices.ptr, values.ptr, count, mode == permute_mode_prefetch);
+}
+
+inline
+void scatter(allocator a, array_u32 dst, array_u32 indices, array_u32 values) {
+  scatter(a, dst, indices, values, permute_mode_auto);
+}
+
+//
+// permutations
+//
+
+// precondition: p is a permutation of [0, p.count)
+
+inline
+array_u32 invert_permutation(allocator a, array_u32 p, u32 mode) {
+  array_u32 result;
+
+  result.count = p.count;
+  result.ptr   = (u32*)cpeak_alloc(a, result.count * sizeof(u32));
+
+  mode = permute_pick_mode(mode, p.count, PERMUTE_PARTITION_BYTES);
+
+  if(mode == permute_mode_partitioned)
+    permute_scatter_partitioned(a, result.ptr, result.count, p.ptr, 0, p.count);
+  else
+    scatter_direct(result.ptr, p.ptr, 0, p.count, mode == permute_mode_prefetch);
+
+  return result;
+}
+
+inline
+array_u32 invert_permutation(allocator a, array_u32 p) {
+  return invert_permutation(a, p, permute_mode_auto);
+}
+
+#endif
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "array_u32.h"
+#include "array_u32_generate.h"
+#include "array_u32_permute.h"
+
+// every mode against a scalar loop, on sizes that leave vector tails and
+// span several partitions
+
+bool same(array_u32 x, const u32* expected, size_type count) {
+  bool result = x.count == count;
+
+  for(size_type i = 0; result && i < count; ++i)
+    result = x.ptr[i] == expected[i];
+
+  return result;
+}
+
+int main(int argc, char** argv) {
+  allocator ai = std_alloc;
+
+  array_u32 v = mul(ai, iota_u32(ai, 10), 10U);
+  array_u32 idx = mod(ai, mul(ai, iota_u32(ai, 10), 7U), 10U);
+
+  print(gather(ai, v, idx));
+  printf("\n");
+  print(invert_permutation(ai, idx));
+  printf("\n");
+
+  cstring mode_names[] = { "auto", "direct", "prefetch", "partitioned" };
+  size_type counts[] = { 1, 7, 33, 1000, 300007 };
+
+  for(u32 mode = permute_mode_auto; mode <= permute_mode_partitioned; ++mode) {
+    bool gathers = true;
+    bool scatters = true;
+    bool inversions = true;
+
+    for(u32 c = 0U; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+      size_type count = counts[c];
+      array_u32 values = random_u32(ai, count, 1U + c);
+      u32* expected = (u32*)malloc(2U * count * sizeof(u32));
+
+      // gather, with more indices than values
+
+      array_u32 indices = random_below(ai, 2U * count, (u32)count, 2U + c);
+
+      for(size_type i = 0; i < indices.count; ++i)
+        expected[i] = values.ptr[indices.ptr[i]];
+
+      gathers = gathers && same(gather(ai, values, indices, mode), expected, indices.count);
+
+      // scatter, with repeated indices where the last write wins
+
+      array_u32 dst = fill_u32(ai, count, 0xFFFFFFFFU);
+      array_u32 payload = random_u32(ai, indices.count, 3U + c);
+
+      for(size_type i = 0; i < count; ++i)
+        expected[i] = 0xFFFFFFFFU;
+
+      for(size_type i = 0; i < indices.count; ++i)
+        expected[indices.ptr[i]] = payload.ptr[i];
+
+      scatter(ai, dst, indices, payload, mode);
+      scatters = scatters && same(dst, expected, count);
+
+      // a random permutation, Fisher-Yates
+
+      array_u32 p = iota_u32(ai, count);
+      array_u32 r = random_u32(ai, count, 4U + c);
+
+      for(size_type i = count; i > 1U; --i) {
+        size_type j = r.ptr[i - 1U] % i;
+        u32 t = p.ptr[i - 1U];
+
+        p.ptr[i - 1U] = p.ptr[j];
+        p.ptr[j] = t;
+      }
+
+      for(size_type i = 0; i < count; ++i)
+        expected[p.ptr[i]] = (u32)i;
+
+      inversions = inversions && same(invert_permutation(ai, p, mode), expected, count);
+
+      free(expected);
+    }
+
+    printf("%s: gather %d, scatter %d, invert_permutation %d\n", mode_names[mode], gathers, scatters, inversions);
+  }
+
+  return 0;
+}
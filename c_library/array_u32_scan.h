@@ -0,0 +1,325 @@
+/**
+ *  array_u32_scan.h
+ *
+ *  Prefix sums and histograms (all arithmetic mod 2^32).
+ *
+ *  inclusive_scan   - result[i] = x[0] + ... + x[i]
+ *  exclusive_scan   - result[i] = init + x[0] + ... + x[i - 1]
+ *  histogram        - counts of the values in [0, bin_count), larger values are skipped
+ *  histogram_radix  - counts of the digits (x >> shift) & (2^bits - 1)
+ *
+ *  The scans use an in-register log-step scan (SSE2/AVX2). With more than
+ *  one thread they run as a two-pass block scan: every thread sums its
+ *  block, the block sums are scanned serially, then every thread scans its
+ *  block starting from its offset.
+ *
+ *  The histograms give every thread private bins (4 interleaved copies for
+ *  small bin counts, so that runs of equal values don't serialize on one
+ *  counter) which are merged at the end. Scratch bins come from the
+ *  allocator of the result.
+ */
+
+#ifndef U32_ARRAY_SCAN_H
+#define U32_ARRAY_SCAN_H
+
+#include <assert.h>
+#include <string.h>
+#include "types.h"
+#include "macro.h"
+#include "alloc.h"
+#include "simd.h"
+#include "parallel.h"
+#include "array_u32.h"
+
+#define SCAN_MIN_PER_THREAD      (64U * 1024U)
+#define HISTOGRAM_MIN_PER_THREAD (64U * 1024U)
+#define HISTOGRAM_SPLIT_BINS     4096U // up to this many bins use 4 sub-histograms per thread
+
+//
+// sequential kernels
+//
+
+// sum of count values
+
+inline
+u32 scan_sum(const u32* x, size_type count) {
+  size_type i = 0;
+  u32 result = 0U;
+
+#if defined(CPEAK_AVX2)
+  __m256i acc = _mm256_setzero_si256();
+
+  for(; i + 8U <= count; i += 8U) {
+    acc = _mm256_add_epi32(acc, _mm256_loadu_si256((const __m256i*)(x + i)));
+  }
+
+  __m128i acc4 = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+  acc4 = _mm_add_epi32(acc4, _mm_shuffle_epi32(acc4, 0x4E));
+  acc4 = _mm_add_epi32(acc4, _mm_shuffle_epi32(acc4, 0xB1));
+  result = (u32)_mm_cvtsi128_si32(acc4);
+#elif defined(CPEAK_SSE2)
+  __m128i acc = _mm_setzero_si128();
+
+  for(; i + 4U <= count; i += 4U) {
+    acc = _mm_add_epi32(acc, _mm_loadu_si128((const __m128i*)(x + i)));
+  }
+
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4E));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xB1));
+  result = (u32)_mm_cvtsi128_si32(acc);
+#endif
+
+  for(; i < count; ++i) {
+    result += x[i];
+  }
+
+  return result;
+}
+
+// dest[i] = carry + x[0] + ... + x[i] (inclusive) or carry + x[0] + ... + x[i - 1] (exclusive)
+// returns carry + the sum of all values; dest may alias x
+
+inline
+u32 scan_block(u32* dest, const u32* x, size_type count, u32 carry, bool inclusive) {
+  size_type i = 0;
+
+#if defined(CPEAK_AVX2)
+  __m256i c = _mm256_set1_epi32((int)carry);
+  __m256i last = _mm256_set1_epi32(7);
+
+  for(; i + 8U <= count; i += 8U) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(x + i));
+
+    // scan within each 128-bit lane
+    __m256i s = _mm256_add_epi32(v, _mm256_slli_si256(v, 4));
+    s = _mm256_add_epi32(s, _mm256_slli_si256(s, 8));
+
+    // add the total of the low lane to the high lane
+    __m256i low_total = _mm256_shuffle_epi32(s, 0xFF);
+    s = _mm256_add_epi32(s, _mm256_permute2x128_si256(low_total, low_total, 0x08));
+    s = _mm256_add_epi32(s, c);
+
+    c = _mm256_permutevar8x32_epi32(s, last);
+
+    if(!inclusive)
+      s = _mm256_sub_epi32(s, v);
+
+    _mm256_storeu_si256((__m256i*)(dest + i), s);
+  }
+
+  carry = (u32)_mm256_cvtsi256_si32(c);
+#elif defined(CPEAK_SSE2)
+  __m128i c = _mm_set1_epi32((int)carry);
+
+  for(; i + 4U <= count; i += 4U) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(x + i));
+
+    __m128i s = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+    s = _mm_add_epi32(s, _mm_slli_si128(s, 8));
+    s = _mm_add_epi32(s, c);
+
+    c = _mm_shuffle_epi32(s, 0xFF);
+
+    if(!inclusive)
+      s = _mm_sub_epi32(s, v);
+
+    _mm_storeu_si128((__m128i*)(dest + i), s);
+  }
+
+  carry = (u32)_mm_cvtsi128_si32(c);
+#endif
+
+  for(; i < count; ++i) {
+    u32 v = x[i];
+
+    if(inclusive) {
+      carry += v;
+      dest[i] = carry;
+    } else {
+      dest[i] = carry;
+      carry += v;
+    }
+  }
+
+  return carry;
+}
+
+//
+// scans
+//
+
+inline
+void scan_into(u32* dest, array_u32 x, u32 init, bool inclusive, u32 thread_count) {
+  thread_count = parallel_thread_count_for(x.count, thread_count, SCAN_MIN_PER_THREAD);
+
+  if(thread_count == 1U) {
+    scan_block(dest, x.ptr, x.count, init, inclusive);
+    return;
+  }
+
+  u32 block_sums[PARALLEL_MAX_THREADS];
+
+  // pass 1: block sums
+
+  parallel_for_ranges(thread_count, x.count, [&](u32 t, size_type begin, size_type end) {
+    block_sums[t] = scan_sum(x.ptr + begin, end - begin);
+  });
+
+  // block offsets
+
+  u32 carry = init;
+
+  for(u32 t = 0U; t < thread_count; ++t) {
+    u32 sum = block_sums[t];
+
+    block_sums[t] = carry;
+    carry += sum;
+  }
+
+  // pass 2: scan every block from its offset
+
+  parallel_for_ranges(thread_count, x.count, [&](u32 t, size_type begin, size_type end) {
+    scan_block(dest + begin, x.ptr + begin, end - begin, block_sums[t], inclusive);
+  });
+}
+
+inline
+array_u32 inclusive_scan(allocator a, array_u32 x, u32 thread_count) {
+  array_u32 result;
+
+  result.count = x.count;
+  result.ptr   = (u32*)cpeak_alloc(a, result.count * sizeof(u32));
+
+  scan_into(result.ptr, x, 0U, true, thread_count);
+
+  return result;
+}
+
+inline
+array_u32 inclusive_scan(allocator a, array_u32 x) {
+  return inclusive_scan(a, x, 1U);
+}
+
+inline
+array_u32 exclusive_scan(allocator a, array_u32 x, u32 init, u32 thread_count) {
+  array_u32 result;
+
+  result.count = x.count;
+  result.ptr   = (u32*)cpeak_alloc(a, result.count * sizeof(u32));
+
+  scan_into(result.ptr, x, init, false, thread_count);
+
+  return result;
+}
+
+inline
+array_u32 exclusive_scan(allocator a, array_u32 x, u32 init) {
+  return exclusive_scan(a, x, init, 1U);
+}
+
+inline
+array_u32 exclusive_scan(allocator a, array_u32 x) {
+  return exclusive_scan(a, x, 0U, 1U);
+}
+
+//
+// histograms
+//
+
+// bins of one thread, 'copies' interleaved sub-histograms: bins[bin * copies + copy]
+
+template <typename Bin>
+inline
+void histogram_block(u32* bins, u32 copies, const u32* x, size_type count, Bin bin) {
+  size_type i = 0;
+
+  if(copies == 4U) {
+    for(; i + 4U <= count; i += 4U) {
+      ++bins[bin(x[i + 0U]) * 4U + 0U];
+      ++bins[bin(x[i + 1U]) * 4U + 1U];
+      ++bins[bin(x[i + 2U]) * 4U + 2U];
+      ++bins[bin(x[i + 3U]) * 4U + 3U];
+    }
+  }
+
+  for(; i < count; ++i) {
+    ++bins[bin(x[i]) * copies];
+  }
+}
+
+// bin(v) is in [0, bin_count]: the private bins have one more bin for the
+// values that are skipped, it isn't merged into the result
+
+template <typename Bin>
+inline
+array_u32 histogram_impl(allocator a, array_u32 x, u32 bin_count, u32 thread_count, Bin bin) {
+  array_u32 result;
+
+  thread_count = parallel_thread_count_for(x.count, thread_count, HISTOGRAM_MIN_PER_THREAD);
+
+  u32 copies = (bin_count <= HISTOGRAM_SPLIT_BINS) ? 4U : 1U;
+  usize private_count = ((usize)bin_count + 1U) * copies;
+
+  result.count = bin_count;
+  result.ptr   = (u32*)cpeak_alloc(a, bin_count * sizeof(u32));
+
+  u32* private_bins = (u32*)cpeak_alloc(a, (size_type)(thread_count * private_count * sizeof(u32)));
+
+  parallel_for_ranges(thread_count, x.count, [&](u32 t, size_type begin, size_type end) {
+    u32* bins = private_bins + t * private_count;
+
+    memset(bins, 0, private_count * sizeof(u32));
+    histogram_block(bins, copies, x.ptr + begin, end - begin, bin);
+  });
+
+  // merge the private bins
+
+  for(u32 b = 0U; b < bin_count; ++b) {
+    u32 total = 0U;
+
+    for(u32 t = 0U; t < thread_count; ++t) {
+      const u32* bins = private_bins + t * private_count + (usize)b * copies;
+
+      for(u32 c = 0U; c < copies; ++c)
+        total += bins[c];
+    }
+
+    result.ptr[b] = total;
+  }
+
+  cpeak_free(a, private_bins);
+
+  return result;
+}
+
+// values >= bin_count aren't counted
+
+inline
+array_u32 histogram(allocator a, array_u32 x, u32 bin_count, u32 thread_count) {
+  return histogram_impl(a, x, bin_count, thread_count, [bin_count](u32 v) {
+    return MINIMUM(v, bin_count);
+  });
+}
+
+inline
+array_u32 histogram(allocator a, array_u32 x, u32 bin_count) {
+  return histogram(a, x, bin_count, 1U);
+}
+
+inline
+array_u32 histogram_radix(allocator a, array_u32 x, u32 shift, u32 bits, u32 thread_count) {
+  assert(bits >= 1U && bits <= 24U && shift < 32U);
+
+  u32 mask = (1U << bits) - 1U;
+
+  return histogram_impl(a, x, 1U << bits, thread_count, [shift, mask](u32 v) {
+    return (v >> shift) & mask;
+  });
+}
+
+inline
+array_u32 histogram_radix(allocator a, array_u32 x, u32 shift, u32 bits) {
+  return histogram_radix(a, x, shift, bits, 1U);
+}
+
+#endif
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "array_u32.h"
+#include "array_u32_generate.h"
+#include "array_u32_scan.h"
+
+// the kernels against scalar loops, on lengths that leave vector and block
+// tails, with 1 and 4 threads
+
+bool same(array_u32 x, const u32* expected, size_type count) {
+  bool result = x.count == count;
+
+  for(size_type i = 0; result && i < count; ++i)
+    result = x.ptr[i] == expected[i];
+
+  return result;
+}
+
+int main(int argc, char** argv) {
+  allocator ai = std_alloc;
+
+  print(inclusive_scan(ai, iota_u32(ai, 10)));
+  printf("\n");
+  print(exclusive_scan(ai, iota_u32(ai, 10), 100U));
+  printf("\n");
+
+  size_type counts[] = { 0, 1, 3, 7, 8, 9, 31, 33, 1000, 300007 };
+  u32 threads[] = { 1U, 4U };
+  u32* expected = (u32*)malloc(300007 * sizeof(u32));
+  u32* bins = (u32*)malloc(65536 * sizeof(u32));
+
+  for(u32 c = 0U; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+    for(u32 t = 0U; t < 2U; ++t) {
+      size_type count = counts[c];
+      array_u32 x = random_u32(ai, count, 42U + c);
+      bool scans = true;
+      bool histograms = true;
+
+      // scans, with sums that wrap
+
+      u32 sum = 0U;
+
+      for(size_type i = 0; i < count; ++i)
+        expected[i] = (sum += x.ptr[i]);
+
+      scans = scans && same(inclusive_scan(ai, x, threads[t]), expected, count);
+
+      sum = 7U;
+
+      for(size_type i = 0; i < count; ++i) {
+        expected[i] = sum;
+        sum += x.ptr[i];
+      }
+
+      scans = scans && same(exclusive_scan(ai, x, 7U, threads[t]), expected, count);
+
+      // histograms with 4 interleaved copies (few bins) and without (many bins), some values out of range
+
+      u32 bin_counts[] = { 1U, 16U, 5000U };
+
+      for(u32 b = 0U; b < 3U; ++b) {
+        array_u32 y = mod(ai, x, 6000U);
+
+        memset(bins, 0, bin_counts[b] * sizeof(u32));
+
+        for(size_type i = 0; i < count; ++i) {
+          if(y.ptr[i] < bin_counts[b])
+            ++bins[y.ptr[i]];
+        }
+
+        histograms = histograms && same(histogram(ai, y, bin_counts[b], threads[t]), bins, bin_counts[b]);
+      }
+
+      // radix digits
+
+      memset(bins, 0, 2048U * sizeof(u32));
+
+      for(size_type i = 0; i < count; ++i)
+        ++bins[(x.ptr[i] >> 13) & 2047U];
+
+      histograms = histograms && same(histogram_radix(ai, x, 13U, 11U, threads[t]), bins, 2048U);
+
+      printf("count %u, %u threads: scans %d, histograms %d\n", (u32)count, threads[t], scans, histograms);
+    }
+  }
+
+  free(bins);
+  free(expected);
+
+  return 0;
+}
@@ -0,0 +1,431 @@
+/**
+ *  array_u32_select.h
+ *
+ *  Top-k and selection without a full sort.
+ *
+ *  top_k_largest  - the k largest values, in descending order
+ *  top_k_smallest - the k smallest values, in ascending order
+ *  nth_element    - reorders x so that x[n] is the value a sort would put
+ *                   there, with nothing larger before it and nothing
+ *                   smaller after it (in place quickselect)
+ *  nth_value      - the value at index n of the sorted order, x unchanged
+ *  median         - nth_value at (count - 1) / 2
+ *
+ *  For small k, top-k is a single pass that keeps a k-entry heap: values
+ *  are compared against the heap's threshold 8 (AVX2) or 4 (SSE2) at a
+ *  time and only the ones that beat it touch the heap. For large k (more
+ *  than 1/TOP_K_HEAP_RATIO of the input) a copy of the input is
+ *  quickselected and only the selected part is (radix) sorted.
+ *
+ *  The smallest values are selected as the largest of the complemented
+ *  values, so one kernel serves both directions.
+ *
+ *  The threaded top-k runs one top-k per range and a final top-k over
+ *  the per-thread candidates.
+ */
+
+#ifndef U32_ARRAY_SELECT_H
+#define U32_ARRAY_SELECT_H
+
+#include <assert.h>
+#include <string.h>
+#include "types.h"
+#include "macro.h"
+#include "alloc.h"
+#include "bits.h"
+#include "simd.h"
+#include "parallel.h"
+#include "array_u32.h"
+
+#define TOP_K_HEAP_RATIO     64U // heap while k * TOP_K_HEAP_RATIO <= count, quickselect otherwise
+#define TOP_K_MIN_PER_THREAD (256U * 1024U)
+
+//
+// min-heap of keys
+//
+
+inline
+void select_heap_sift_down(u32* heap, size_type count, size_type i) {
+  u32 v = heap[i];
+
+  for(;;) {
+    size_type child = 2U * i + 1U;
+
+    if(child >= count)
+      break;
+
+    if(child + 1U < count && heap[child + 1U] < heap[child])
+      ++child;
+
+    if(heap[child] >= v)
+      break;
+
+    heap[i] = heap[child];
+    i = child;
+  }
+
+  heap[i] = v;
+}
+
+inline
+void select_heapify(u32* heap, size_type count) {
+  for(size_type i = count / 2U; i > 0U; --i)
+    select_heap_sift_down(heap, count, i - 1U);
+}
+
+// sorts the heap descending in place
+
+inline
+void select_heap_sort_descending(u32* heap, size_type count) {
+  for(size_type n = count; n > 1U; --n) {
+    u32 top = heap[0];
+
+    heap[0] = heap[n - 1U];
+    heap[n - 1U] = top;
+    select_heap_sift_down(heap, n - 1U, 0U);
+  }
+}
+
+//
+// heap top-k: dest[0, k) = the k largest keys (x ^ flip), descending; precondition: k <= count
+//
+
+inline
+void top_k_heap(u32* dest, const u32* x, size_type count, size_type k, u32 flip) {
+  size_type i = k;
+
+  for(size_type j = 0; j < k; ++j)
+    dest[j] = x[j] ^ flip;
+
+  select_heapify(dest, k);
+
+#if defined(CPEAK_SSE2)
+  // signed compare of the keys with the sign bit flipped is the unsigned compare
+  u32 bias = flip ^ 0x80000000U;
+#endif
+
+#if defined(CPEAK_AVX2)
+  __m256i bias_v = _mm256_set1_epi32((int)bias);
+  __m256i threshold = _mm256_set1_epi32((int)(dest[0] ^ 0x80000000U));
+
+  for(; i + 8U <= count; i += 8U) {
+    __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(x + i)), bias_v);
+    u32 hit = (u32)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, threshold)));
+
+    if(hit == 0U)
+      continue;
+
+    do {
+      u32 key = x[i + bits_ctz_u32(hit)] ^ flip;
+
+      if(key > dest[0]) {
+        dest[0] = key;
+        select_heap_sift_down(dest, k, 0U);
+      }
+
+      hit &= hit - 1U;
+    } while(hit != 0U);
+
+    threshold = _mm256_set1_epi32((int)(dest[0] ^ 0x80000000U));
+  }
+#elif defined(CPEAK_SSE2)
+  __m128i bias_v = _mm_set1_epi32((int)bias);
+  __m128i threshold = _mm_set1_epi32((int)(dest[0] ^ 0x80000000U));
+
+  for(; i + 4U <= count; i += 4U) {
+    __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(x + i)), bias_v);
+    u32 hit = (u32)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, threshold)));
+
+    if(hit == 0U)
+      continue;
+
+    do {
+      u32 key = x[i + bits_ctz_u32(hit)] ^ flip;
+
+      if(key > dest[0]) {
+        dest[0] = key;
+        select_heap_sift_down(dest, k, 0U);
+      }
+
+      hit &= hit - 1U;
+    } while(hit != 0U);
+
+    threshold = _mm_set1_epi32((int)(dest[0] ^ 0x80000000U));
+  }
+#endif
+
+  for(; i < count; ++i) {
+    u32 key = x[i] ^ flip;
+
+    if(key > dest[0]) {
+      dest[0] = key;
+      select_heap_sift_down(dest, k, 0U);
+    }
+  }
+
+  select_heap_sort_descending(dest, k);
+}
+
+//
+// quickselect
+//
+
+// after the call x[n] is in its sorted position, x[0, n) <= x[n] <= x(n, count)
+
+inline
+void select_nth_keys(u32* x, size_type count, size_type n) {
+  size_type lo = 0;
+  size_type hi = count; // exclusive
+  u64 state = 0x9E3779B97F4A7C15ULL;
+
+  assert(n < count);
+
+  while(hi - lo > 16U) {
+    // median of three pseudo-random positions, avoids the quadratic cases of a fixed pivot
+    size_type range = hi - lo;
+
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    size_type ia = lo + (size_type)(state % range);
+    size_type ib = lo + (size_type)((state >> 21) % range);
+    size_type ic = lo + (size_type)((state >> 42) % range);
+
+    if(x[ia] > x[ib]) { size_type t = ia; ia = ib; ib = t; }
+    if(x[ib] > x[ic]) ib = (x[ia] > x[ic]) ? ia : ic;
+
+    // the pivot goes first, which keeps both sides of the partition non-empty
+    u32 pivot = x[ib];
+    x[ib] = x[lo];
+    x[lo] = pivot;
+
+    // Hoare partition: [lo, j] <= pivot <= [j + 1, hi)
+    size_type i = lo;
+    size_type j = hi - 1U;
+
+    for(;;) {
+      while(x[i] < pivot)
+        ++i;
+      while(x[j] > pivot)
+        --j;
+
+      if(i >= j)
+        break;
+
+      u32 t = x[i];
+      x[i] = x[j];
+      x[j] = t;
+
+      ++i;
+      --j;
+    }
+
+    if(n <= j)
+      hi = j + 1U;
+    else
+      lo = j + 1U;
+  }
+
+  // insertion sort of the last few
+  for(size_type i = lo + 1U; i < hi; ++i) {
+    u32 v = x[i];
+    size_type j = i;
+
+    for(; j > lo && x[j - 1U] > v; --j)
+      x[j] = x[j - 1U];
+
+    x[j] = v;
+  }
+}
+
+// LSD radix sort on the complemented values, 3 passes of 11 bits
+
+inline
+void select_sort_descending(allocator a, u32* x, size_type count) {
+  u32 offsets[3][2048];
+
+  if(count < 2U)
+    return;
+
+  u32* tmp = (u32*)cpeak_alloc(a, count * sizeof(u32));
+
+  memset(offsets, 0, sizeof(offsets));
+
+  for(size_type i = 0; i < count; ++i) {
+    u32 key = ~x[i];
+
+    ++offsets[0][key & 0x7FFU];
+    ++offsets[1][(key >> 11) & 0x7FFU];
+    ++offsets[2][key >> 22];
+  }
+
+  for(u32 pass = 0U; pass < 3U; ++pass) {
+    u32 running = 0U;
+
+    for(u32 d = 0U; d < 2048U; ++d) {
+      u32 n = offsets[pass][d];
+
+      offsets[pass][d] = running;
+      running += n;
+    }
+  }
+
+  u32* src = x;
+  u32* dst = tmp;
+
+  for(u32 pass = 0U; pass < 3U; ++pass) {
+    u32 shift = pass * 11U;
+
+    for(size_type i = 0; i < count; ++i) {
+      u32 v = src[i];
+
+      dst[offsets[pass][(~v >> shift) & 0x7FFU]++] = v;
+    }
+
+    u32* t = src;
+    src = dst;
+    dst = t;
+  }
+
+  // after an odd number of passes the sorted values are in tmp
+  memcpy(x, src, count * sizeof(u32));
+
+  cpeak_free(a, tmp);
+}
+
+// quickselect top-k: dest[0, k) = the k largest keys (x ^ flip), descending; precondition: k <= count
+
+inline
+void top_k_quickselect(allocator a, u32* dest, const u32* x, size_type count, size_type k, u32 flip) {
+  u32* keys = (u32*)cpeak_alloc(a, count * sizeof(u32));
+
+  for(size_type i = 0; i < count; ++i)
+    keys[i] = x[i] ^ flip;
+
+  if(k < count)
+    select_nth_keys(keys, count, count - k);
+
+  memcpy(dest, keys + (count - k), k * sizeof(u32));
+  select_sort_descending(a, dest, k);
+
+  cpeak_free(a, keys);
+}
+
+// the k largest keys of x ^ flip, descending, unflipped
+
+inline
+void top_k_into(allocator a, u32* dest, const u32* x, size_type count, size_type k, u32 flip) {
+  if(k == 0U)
+    return;
+
+  if((u64)k * TOP_K_HEAP_RATIO <= (u64)count)
+    top_k_heap(dest, x, count, k, flip);
+  else
+    top_k_quickselect(a, dest, x, count, k, flip);
+
+  if(flip != 0U) {
+    for(size_type i = 0; i < k; ++i)
+      dest[i] ^= flip;
+  }
+}
+
+inline
+array_u32 top_k_impl(allocator a, array_u32 x, size_type k, u32 flip, u32 thread_count) {
+  array_u32 result;
+
+  k = MINIMUM(k, x.count);
+
+  result.count = k;
+  result.ptr   = (u32*)cpeak_alloc(a, k * sizeof(u32));
+
+  thread_count = parallel_thread_count_for(x.count, thread_count, MAXIMUM((size_type)TOP_K_MIN_PER_THREAD, k * 4U));
+
+  if(thread_count == 1U) {
+    top_k_into(a, result.ptr, x.ptr, x.count, k, flip);
+    return result;
+  }
+
+  // every range keeps its own top k (ranges are at least 4k long), the candidates are selected once more
+
+  u32* candidates = (u32*)cpeak_alloc(a, thread_count * k * sizeof(u32));
+
+  parallel_for_ranges(thread_count, x.count, [&](u32 t, size_type begin, size_type end) {
+    top_k_into(std_alloc, candidates + t * k, x.ptr + begin, end - begin, k, flip);
+  });
+
+  top_k_into(a, result.ptr, candidates, thread_count * k, k, flip);
+
+  cpeak_free(a, candidates);
+
+  return result;
+}
+
+inline
+array_u32 top_k_largest(allocator a, array_u32 x, size_type k, u32 thread_count) {
+  return top_k_impl(a, x, k, 0U, thread_count);
+}
+
+inline
+array_u32 top_k_largest(allocator a, array_u32 x, size_type k) {
+  return top_k_impl(a, x, k, 0U, 1U);
+}
+
+inline
+array_u32 top_k_smallest(allocator a, array_u32 x, size_type k, u32 thread_count) {
+  return top_k_impl(a, x, k, 0xFFFFFFFFU, thread_count);
+}
+
+inline
+array_u32 top_k_smallest(allocator a, array_u32 x, size_type k) {
+  return top_k_impl(a, x, k, 0xFFFFFFFFU, 1U);
+}
+
+//
+// selection
+//
+
+inline
+void nth_element(array_u32 x, size_type n) {
+  select_nth_keys(x.ptr, x.count, n);
+}
+
+// near either end only a heap of the n + 1 smallest (or count - n largest) values is kept,
+// otherwise a copy is quickselected
+
+inline
+u32 nth_value(allocator a, array_u32 x, size_type n) {
+  u32 result;
+
+  assert(n < x.count);
+
+  size_type from_top = x.count - n;
+  size_type k = MINIMUM(n + 1U, from_top);
+  u32 flip = (n + 1U <= from_top) ? 0xFFFFFFFFU : 0U;
+
+  if((u64)k * TOP_K_HEAP_RATIO <= (u64)x.count) {
+    u32* heap = (u32*)cpeak_alloc(a, k * sizeof(u32));
+
+    top_k_heap(heap, x.ptr, x.count, k, flip);
+    result = heap[k - 1U] ^ flip;
+
+    cpeak_free(a, heap);
+  } else {
+    u32* keys = (u32*)cpeak_alloc(a, x.count * sizeof(u32));
+
+    memcpy(keys, x.ptr, x.count * sizeof(u32));
+    select_nth_keys(keys, x.count, n);
+    result = keys[n];
+
+    cpeak_free(a, keys);
+  }
+
+  return result;
+}
+
+inline
+u32 median(allocator a, array_u32 x) {
+  return nth_value(a, x, (x.count - 1U) / 2U);
+}
+
+#endif
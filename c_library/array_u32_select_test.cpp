@@ -0,0 +1,31 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "array_u32.h"
+#include "array_u32_select.h"
+
+int main(int argc, char** argv) {
+  allocator ai = std_alloc;
+
+  array_u32 x = mod(ai, mul(ai, iota_u32(ai, 1000000), 2654435761U), 1000003U);
+
+  print(top_k_largest(ai, x, 8));
+  printf("\n");
+  print(top_k_smallest(ai, x, 8));
+  printf("\n");
+
+  // large k takes the quickselect path
+  array_u32 top = top_k_largest(ai, x, 500000, parallel_default_thread_count());
+  printf("top 500000: first %u, last %u\n", top.ptr[0], top.ptr[top.count - 1]);
+
+  printf("median: %u, 10th value: %u\n", median(ai, x), nth_value(ai, x, 10));
+
+  array_u32 y = iota_u32(ai, 20);
+  y = mod(ai, mul(ai, y, 7U), 20U);
+  nth_element(y, 5);
+  print(y);
+  printf("\n");
+
+  return 0;
+}
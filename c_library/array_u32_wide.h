@@ -0,0 +1,387 @@
+/**
+ *  array_u32_wide.h
+ *
+ *  Arithmetic on array_u32 that doesn't wrap mod 2^32.
+ *
+ *  mul_wide     - x * y as array_u64
+ *  add_wide     - acc += x, in place on an array_u64 accumulator
+ *  mul_add_wide - acc += x * y, in place on an array_u64 accumulator
+ *  sum_wide     - the u64 sum of all values
+ *  add_sat      - x + y, clamped to 0xFFFFFFFF
+ *  sub_sat      - x - y, clamped to 0
+ *  mul_sat      - x * y, clamped to 0xFFFFFFFF
+ *  mulhi        - the high 32 bits of the 64-bit product x * y
+ *
+ *  The binary operations take an array or a scalar as y and work up to the
+ *  shorter length. The widening kernels convert 4 (AVX2) or 2 (SSE2) lanes
+ *  at a time in registers, so no widened copy of the input is made.
+ *
+ *  Products use PMULUDQ (_mm256_mul_epu32), which multiplies the even
+ *  lanes, once on the values and once on the values shifted down by 32
+ *  bits; the halves are then shuffled back into lane order. The saturating
+ *  add and sub use unsigned min/max with AVX2 and a biased signed compare
+ *  with SSE2.
+ */
+
+#ifndef U32_ARRAY_WIDE_H
+#define U32_ARRAY_WIDE_H
+
+#include <assert.h>
+#include "types.h"
+#include "macro.h"
+#include "alloc.h"
+#include "simd.h"
+#include "array_u32.h"
+#include "array_u64.h"
+
+enum arith_op_enum {
+  arith_op_add_sat,
+  arith_op_sub_sat,
+  arith_op_mul_sat,
+  arith_op_mulhi,
+};
+
+template <u32 Op>
+inline
+u32 arith_scalar(u32 x, u32 y) {
+  u64 p = (u64)x * y;
+
+  switch(Op) {
+    case arith_op_add_sat: return (x + y < x) ? 0xFFFFFFFFU : x + y;
+    case arith_op_sub_sat: return (x > y) ? x - y : 0U;
+    case arith_op_mul_sat: return (p >> 32) ? 0xFFFFFFFFU : (u32)p;
+    default:               return (u32)(p >> 32);
+  }
+}
+
+#if defined(CPEAK_AVX2)
+// 64-bit products of the even lanes (even) and odd lanes (odd)
+
+inline
+void mul_even_odd_avx2(__m256i x, __m256i y, __m256i* even, __m256i* odd) {
+  *even = _mm256_mul_epu32(x, y);
+  *odd  = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), _mm256_srli_epi64(y, 32));
+}
+
+// low and high 32 bits of the 8 products, in lane order
+
+inline
+void mul_lo_hi_avx2(__m256i x, __m256i y, __m256i* lo, __m256i* hi) {
+  __m256i even, odd;
+
+  mul_even_odd_avx2(x, y, &even, &odd);
+
+  // [e0lo, e0hi, e2lo, e2hi] -> [e0lo, e2lo, e0hi, e2hi] per 128-bit lane
+  even = _mm256_shuffle_epi32(even, 0xD8);
+  odd  = _mm256_shuffle_epi32(odd, 0xD8);
+
+  *lo = _mm256_unpacklo_epi32(even, odd);
+  *hi = _mm256_unpackhi_epi32(even, odd);
+}
+
+template <u32 Op>
+inline
+__m256i arith_avx2(__m256i x, __m256i y) {
+  __m256i lo, hi;
+
+  switch(Op) {
+    case arith_op_add_sat:
+      // min(x, ~y) + y can't wrap, and is ~y + y = 0xFFFFFFFF when x + y would
+      return _mm256_add_epi32(_mm256_min_epu32(x, _mm256_xor_si256(y, _mm256_set1_epi32(-1))), y);
+    case arith_op_sub_sat:
+      return _mm256_sub_epi32(_mm256_max_epu32(x, y), y);
+    case arith_op_mul_sat:
+      mul_lo_hi_avx2(x, y, &lo, &hi);
+      return _mm256_or_si256(lo, _mm256_xor_si256(_mm256_cmpeq_epi32(hi, _mm256_setzero_si256()), _mm256_set1_epi32(-1)));
+    default:
+      mul_lo_hi_avx2(x, y, &lo, &hi);
+      return hi;
+  }
+}
+#endif
+
+#if defined(CPEAK_SSE2)
+inline
+void mul_even_odd_sse2(__m128i x, __m128i y, __m128i* even, __m128i* odd) {
+  *even = _mm_mul_epu32(x, y);
+  *odd  = _mm_mul_epu32(_mm_srli_epi64(x, 32), _mm_srli_epi64(y, 32));
+}
+
+inline
+void mul_lo_hi_sse2(__m128i x, __m128i y, __m128i* lo, __m128i* hi) {
+  __m128i even, odd;
+
+  mul_even_odd_sse2(x, y, &even, &odd);
+
+  even = _mm_shuffle_epi32(even, 0xD8);
+  odd  = _mm_shuffle_epi32(odd, 0xD8);
+
+  *lo = _mm_unpacklo_epi32(even, odd);
+  *hi = _mm_unpackhi_epi32(even, odd);
+}
+
+template <u32 Op>
+inline
+__m128i arith_sse2(__m128i x, __m128i y) {
+  __m128i bias = _mm_set1_epi32((int)0x80000000U);
+  __m128i lo, hi, s;
+
+  switch(Op) {
+    case arith_op_add_sat:
+      // the sum wrapped if it is below x
+      s = _mm_add_epi32(x, y);
+      return _mm_or_si128(s, _mm_cmpgt_epi32(_mm_xor_si128(x, bias), _mm_xor_si128(s, bias)));
+    case arith_op_sub_sat:
+      s = _mm_sub_epi32(x, y);
+      return _mm_andnot_si128(_mm_cmpgt_epi32(_mm_xor_si128(y, bias), _mm_xor_si128(x, bias)), s);
+    case arith_op_mul_sat:
+      mul_lo_hi_sse2(x, y, &lo, &hi);
+      return _mm_or_si128(lo, _mm_xor_si128(_mm_cmpeq_epi32(hi, _mm_setzero_si128()), _mm_set1_epi32(-1)));
+    default:
+      mul_lo_hi_sse2(x, y, &lo, &hi);
+      return hi;
+  }
+}
+#endif
+
+//
+// u32 -> u32 kernels, y_step is 0 for a broadcast scalar
+//
+
+template <u32 Op>
+inline
+void arith_into(u32* dest, const u32* x, const u32* y, u32 y_step, size_type count) {
+  size_type i = 0;
+
+#if defined(CPEAK_AVX2)
+  // y[0] is only read for a scalar y, an array y can be empty
+  __m256i yv = (y_step == 0U) ? _mm256_set1_epi32((int)y[0]) : _mm256_setzero_si256();
+
+  for(; i + 8U <= count; i += 8U) {
+    if(y_step != 0U)
+      yv = _mm256_loadu_si256((const __m256i*)(y + i));
+
+    _mm256_storeu_si256((__m256i*)(dest + i), arith_avx2<Op>(_mm256_loadu_si256((const __m256i*)(x + i)), yv));
+  }
+#elif defined(CPEAK_SSE2)
+  __m128i yv = (y_step == 0U) ? _mm_set1_epi32((int)y[0]) : _mm_setzero_si128();
+
+  for(; i + 4U <= count; i += 4U) {
+    if(y_step != 0U)
+      yv = _mm_loadu_si128((const __m128i*)(y + i));
+
+    _mm_storeu_si128((__m128i*)(dest + i), arith_sse2<Op>(_mm_loadu_si128((const __m128i*)(x + i)), yv));
+  }
+#endif
+
+  for(; i < count; ++i) {
+    dest[i] = arith_scalar<Op>(x[i], y[i * y_step]);
+  }
+}
+
+template <u32 Op>
+inline
+array_u32 arith(allocator a, array_u32 x, const u32* y, u32 y_step, size_type count) {
+  array_u32 result;
+
+  result.count = count;
+  result.ptr   = (u32*)cpeak_alloc(a, count * sizeof(u32));
+
+  arith_into<Op>(result.ptr, x.ptr, y, y_step, count);
+
+  return result;
+}
+
+inline array_u32 add_sat(allocator a, array_u32 x, array_u32 y) { return arith<arith_op_add_sat>(a, x, y.ptr, 1U, MINIMUM(x.count, y.count)); }
+inline array_u32 sub_sat(allocator a, array_u32 x, array_u32 y) { return arith<arith_op_sub_sat>(a, x, y.ptr, 1U, MINIMUM(x.count, y.count)); }
+inline array_u32 mul_sat(allocator a, array_u32 x, array_u32 y) { return arith<arith_op_mul_sat>(a, x, y.ptr, 1U, MINIMUM(x.count, y.count)); }
+inline array_u32 mulhi(allocator a, array_u32 x, array_u32 y)   { return arith<arith_op_mulhi>(a, x, y.ptr, 1U, MINIMUM(x.count, y.count)); }
+
+inline array_u32 add_sat(allocator a, array_u32 x, u32 y) { return arith<arith_op_add_sat>(a, x, &y, 0U, x.count); }
+inline array_u32 sub_sat(allocator a, array_u32 x, u32 y) { return arith<arith_op_sub_sat>(a, x, &y, 0U, x.count); }
+inline array_u32 mul_sat(allocator a, array_u32 x, u32 y) { return arith<arith_op_mul_sat>(a, x, &y, 0U, x.count); }
+inline array_u32 mulhi(allocator a, array_u32 x, u32 y)   { return arith<arith_op_mulhi>(a, x, &y, 0U, x.count); }
+
+//
+// widening kernels
+//
+
+// dest[i] = x[i] * y[i * y_step] (accumulate false) or dest[i] += x[i] * y[i * y_step] (accumulate true)
+
+inline
+void mul_wide_into(u64* dest, const u32* x, const u32* y, u32 y_step, size_type count, bool accumulate) {
+  size_type i = 0;
+
+#if defined(CPEAK_AVX2)
+  __m256i yv = (y_step == 0U) ? _mm256_set1_epi32((int)y[0]) : _mm256_setzero_si256();
+
+  for(; i + 8U <= count; i += 8U) {
+    __m256i even, odd;
+
+    if(y_step != 0U)
+      yv = _mm256_loadu_si256((const __m256i*)(y + i));
+
+    mul_even_odd_avx2(_mm256_loadu_si256((const __m256i*)(x + i)), yv, &even, &odd);
+
+    // [p0, p1 | p4, p5] and [p2, p3 | p6, p7]
+    __m256i p01 = _mm256_unpacklo_epi64(even, odd);
+    __m256i p23 = _mm256_unpackhi_epi64(even, odd);
+    __m256i lo  = _mm256_permute2x128_si256(p01, p23, 0x20);
+    __m256i hi  = _mm256_permute2x128_si256(p01, p23, 0x31);
+
+    if(accumulate) {
+      lo = _mm256_add_epi64(lo, _mm256_loadu_si256((const __m256i*)(dest + i)));
+      hi = _mm256_add_epi64(hi, _mm256_loadu_si256((const __m256i*)(dest + i + 4U)));
+    }
+
+    _mm256_storeu_si256((__m256i*)(dest + i), lo);
+    _mm256_storeu_si256((__m256i*)(dest + i + 4U), hi);
+  }
+#elif defined(CPEAK_SSE2)
+  __m128i yv = (y_step == 0U) ? _mm_set1_epi32((int)y[0]) : _mm_setzero_si128();
+
+  for(; i + 4U <= count; i += 4U) {
+    __m128i even, odd;
+
+    if(y_step != 0U)
+      yv = _mm_loadu_si128((const __m128i*)(y + i));
+
+    mul_even_odd_sse2(_mm_loadu_si128((const __m128i*)(x + i)), yv, &even, &odd);
+
+    __m128i lo = _mm_unpacklo_epi64(even, odd);
+    __m128i hi = _mm_unpackhi_epi64(even, odd);
+
+    if(accumulate) {
+      lo = _mm_add_epi64(lo, _mm_loadu_si128((const __m128i*)(dest + i)));
+      hi = _mm_add_epi64(hi, _mm_loadu_si128((const __m128i*)(dest + i + 2U)));
+    }
+
+    _mm_storeu_si128((__m128i*)(dest + i), lo);
+    _mm_storeu_si128((__m128i*)(dest + i + 2U), hi);
+  }
+#endif
+
+  for(; i < count; ++i) {
+    u64 p = (u64)x[i] * y[i * y_step];
+
+    dest[i] = accumulate ? dest[i] + p : p;
+  }
+}
+
+inline
+array_u64 mul_wide(allocator a, array_u32 x, array_u32 y) {
+  array_u64 result;
+
+  result.count = MINIMUM(x.count, y.count);
+  result.ptr   = (u64*)cpeak_alloc(a, result.count * sizeof(u64));
+
+  mul_wide_into(result.ptr, x.ptr, y.ptr, 1U, result.count, false);
+
+  return result;
+}
+
+inline
+array_u64 mul_wide(allocator a, array_u32 x, u32 y) {
+  array_u64 result;
+
+  result.count = x.count;
+  result.ptr   = (u64*)cpeak_alloc(a, result.count * sizeof(u64));
+
+  mul_wide_into(result.ptr, x.ptr, &y, 0U, result.count, false);
+
+  return result;
+}
+
+inline
+void mul_add_wide(array_u64 acc, array_u32 x, array_u32 y) {
+  mul_wide_into(acc.ptr, x.ptr, y.ptr, 1U, MINIMUM(acc.count, MINIMUM(x.count, y.count)), true);
+}
+
+inline
+void mul_add_wide(array_u64 acc, array_u32 x, u32 y) {
+  mul_wide_into(acc.ptr, x.ptr, &y, 0U, MINIMUM(acc.count, x.count), true);
+}
+
+// acc[i] += x[i]
+
+inline
+void add_wide(array_u64 acc, array_u32 x) {
+  size_type count = MINIMUM(acc.count, x.count);
+  size_type i = 0;
+
+#if defined(CPEAK_AVX2)
+  for(; i + 4U <= count; i += 4U) {
+    __m256i v = _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i*)(x.ptr + i)));
+    __m256i s = _mm256_add_epi64(_mm256_loadu_si256((const __m256i*)(acc.ptr + i)), v);
+
+    _mm256_storeu_si256((__m256i*)(acc.ptr + i), s);
+  }
+#elif defined(CPEAK_SSE2)
+  __m128i zero = _mm_setzero_si128();
+
+  for(; i + 4U <= count; i += 4U) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(x.ptr + i));
+    __m128i lo = _mm_add_epi64(_mm_loadu_si128((const __m128i*)(acc.ptr + i)), _mm_unpacklo_epi32(v, zero));
+    __m128i hi = _mm_add_epi64(_mm_loadu_si128((const __m128i*)(acc.ptr + i + 2U)), _mm_unpackhi_epi32(v, zero));
+
+    _mm_storeu_si128((__m128i*)(acc.ptr + i), lo);
+    _mm_storeu_si128((__m128i*)(acc.ptr + i + 2U), hi);
+  }
+#endif
+
+  for(; i < count; ++i) {
+    acc.ptr[i] += x.ptr[i];
+  }
+}
+
+// the even and odd lanes are summed separately in 64-bit lanes, no shuffles in the loop
+
+inline
+u64 sum_wide(array_u32 x) {
+  size_type i = 0;
+  u64 result = 0U;
+
+#if defined(CPEAK_AVX2)
+  __m256i low_mask = _mm256_set1_epi64x(0xFFFFFFFFLL);
+  __m256i even = _mm256_setzero_si256();
+  __m256i odd = _mm256_setzero_si256();
+
+  for(; i + 8U <= x.count; i += 8U) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(x.ptr + i));
+
+    even = _mm256_add_epi64(even, _mm256_and_si256(v, low_mask));
+    odd  = _mm256_add_epi64(odd, _mm256_srli_epi64(v, 32));
+  }
+
+  __m256i s = _mm256_add_epi64(even, odd);
+  __m128i s2 = _mm_add_epi64(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+  u64 lanes[2];
+
+  _mm_storeu_si128((__m128i*)lanes, s2);
+  result = lanes[0] + lanes[1];
+#elif defined(CPEAK_SSE2)
+  __m128i low_mask = _mm_set_epi32(0, -1, 0, -1);
+  __m128i even = _mm_setzero_si128();
+  __m128i odd = _mm_setzero_si128();
+
+  for(; i + 4U <= x.count; i += 4U) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(x.ptr + i));
+
+    even = _mm_add_epi64(even, _mm_and_si128(v, low_mask));
+    odd  = _mm_add_epi64(odd, _mm_srli_epi64(v, 32));
+  }
+
+  u64 lanes[2];
+
+  _mm_storeu_si128((__m128i*)lanes, _mm_add_epi64(even, odd));
+  result = lanes[0] + lanes[1];
+#endif
+
+  for(; i < x.count; ++i) {
+    result += x.ptr[i];
+  }
+
+  return result;
+}
+
+#endif
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "array_u32.h"
+#include "array_u64.h"
+#include "array_u32_generate.h"
+#include "array_u32_wide.h"
+
+// every kernel against a scalar loop, on odd lengths that leave vector
+// tails, with an array and a scalar y, on values around 0, 2^31 and 2^32
+// where the saturation and the biased compares change
+
+u32 ref_add_sat(u32 x, u32 y) { u64 s = (u64)x + y; return (s > 0xFFFFFFFFULL) ? 0xFFFFFFFFU : (u32)s; }
+u32 ref_sub_sat(u32 x, u32 y) { return (x < y) ? 0U : x - y; }
+u32 ref_mul_sat(u32 x, u32 y) { u64 p = (u64)x * y; return (p > 0xFFFFFFFFULL) ? 0xFFFFFFFFU : (u32)p; }
+u32 ref_mulhi(u32 x, u32 y)   { return (u32)(((u64)x * y) >> 32); }
+
+template <typename Ref>
+bool same(array_u32 result, array_u32 x, array_u32 y, Ref ref) {
+  bool ok = result.count == MINIMUM(x.count, y.count);
+
+  for(size_type i = 0; ok && i < result.count; ++i)
+    ok = result.ptr[i] == ref(x.ptr[i], y.ptr[i]);
+
+  return ok;
+}
+
+template <typename Ref>
+bool same(array_u32 result, array_u32 x, u32 y, Ref ref) {
+  bool ok = result.count == x.count;
+
+  for(size_type i = 0; ok && i < result.count; ++i)
+    ok = result.ptr[i] == ref(x.ptr[i], y);
+
+  return ok;
+}
+
+// values near the edges, picked by the low bits of a random word
+
+array_u32 edge_values(allocator a, size_type count, u64 seed) {
+  array_u32 result = random_u32(a, count, seed);
+  u32 edges[] = { 0U, 1U, 2U, 0x7FFFFFFFU, 0x80000000U, 0x80000001U, 0xFFFFFFFEU, 0xFFFFFFFFU, 0x10000U, 0xFFFFU };
+
+  for(size_type i = 0; i < count; ++i) {
+    u32 r = result.ptr[i];
+
+    if((r & 3U) == 0U)
+      result.ptr[i] = edges[(r >> 2) % 10U];
+    else if((r & 3U) == 1U)
+      result.ptr[i] = r >> 16;
+  }
+
+  return result;
+}
+
+int main(int argc, char** argv) {
+  allocator ai = std_alloc;
+
+  size_type counts[] = { 0, 1, 2, 3, 5, 7, 8, 9, 15, 17, 1001 };
+  u32 scalars[] = { 0U, 1U, 3U, 0x10000U, 0x80000000U, 0xFFFFFFFFU };
+  bool sat = true;
+  bool sat_scalar = true;
+  bool wide = true;
+  bool wide_scalar = true;
+  bool accumulate = true;
+  bool sums = true;
+
+  for(u32 c = 0U; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+    size_type count = counts[c];
+    array_u32 x = edge_values(ai, count, 10U + c);
+    array_u32 y = edge_values(ai, count + (c % 3U), 20U + c); // sometimes longer than x
+
+    sat = sat && same(add_sat(ai, x, y), x, y, ref_add_sat) && same(sub_sat(ai, x, y), x, y, ref_sub_sat) &&
+                 same(mul_sat(ai, x, y), x, y, ref_mul_sat) && same(mulhi(ai, x, y), x, y, ref_mulhi);
+
+    for(u32 s = 0U; s < sizeof(scalars) / sizeof(scalars[0]); ++s) {
+      u32 k = scalars[s];
+
+      sat_scalar = sat_scalar && same(add_sat(ai, x, k), x, k, ref_add_sat) && same(sub_sat(ai, x, k), x, k, ref_sub_sat) &&
+                                 same(mul_sat(ai, x, k), x, k, ref_mul_sat) && same(mulhi(ai, x, k), x, k, ref_mulhi);
+
+      array_u64 p = mul_wide(ai, x, k);
+
+      wide_scalar = wide_scalar && p.count == x.count;
+
+      for(size_type i = 0; wide_scalar && i < p.count; ++i)
+        wide_scalar = p.ptr[i] == (u64)x.ptr[i] * k;
+    }
+
+    array_u64 p = mul_wide(ai, x, y);
+
+    wide = wide && p.count == MINIMUM(x.count, y.count);
+
+    for(size_type i = 0; wide && i < p.count; ++i)
+      wide = p.ptr[i] == (u64)x.ptr[i] * y.ptr[i];
+
+    // accumulators that start near 2^64 wrap like u64 arithmetic
+
+    array_u64 acc = zero_u64(ai, count);
+    u64* expected = (u64*)malloc((count + 1U) * sizeof(u64));
+
+    for(size_type i = 0; i < count; ++i)
+      acc.ptr[i] = expected[i] = (i & 1U) ? 0xFFFFFFFFFFFFFFF0ULL : (u64)i << 33;
+
+    add_wide(acc, x);
+    mul_add_wide(acc, x, y);
+    mul_add_wide(acc, y, 0xFFFFFFFFU);
+
+    for(size_type i = 0; i < count; ++i)
+      expected[i] += (u64)x.ptr[i] + (u64)x.ptr[i] * y.ptr[i] + (u64)y.ptr[i] * 0xFFFFFFFFU;
+
+    for(size_type i = 0; accumulate && i < count; ++i)
+      accumulate = acc.ptr[i] == expected[i];
+
+    u64 sum = 0U;
+
+    for(size_type i = 0; i < y.count; ++i)
+      sum += y.ptr[i];
+
+    sums = sums && sum_wide(y) == sum;
+
+    free(expected);
+  }
+
+  printf("add_sat/sub_sat/mul_sat/mulhi: %d, with a scalar: %d\n", sat, sat_scalar);
+  printf("mul_wide: %d, with a scalar: %d\n", wide, wide_scalar);
+  printf("add_wide/mul_add_wide: %d, sum_wide: %d\n", accumulate, sums);
+
+  array_u32 big = fill_u32(ai, 1000003, 0xFFFFFFFFU);
+  printf("sum_wide of 1000003 * 0xFFFFFFFF: %llu\n", (unsigned long long)sum_wide(big));
+
+  return 0;
+}
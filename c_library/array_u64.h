@@ -0,0 +1,86 @@
+#ifndef U64_ARRAY_H
+#define U64_ARRAY_H
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "types.h"
+#include "macro.h"
+#include "alloc.h"
+
+typedef struct array_u64 {
+  u64*      ptr;
+  size_type count;
+} array_u64;
+
+inline
+size_type length(array_u64 arr) {
+  return arr.count;
+}
+
+inline
+array_u64 take(array_u64 arr, size_type count) {
+  array_u64 result;
+
+  assert(arr.count >= count);
+
+  result.ptr   = arr.ptr;
+  result.count = count;
+
+  return result;
+}
+
+inline
+array_u64 take_at_most(array_u64 arr, size_type count) {
+  array_u64 result;
+
+  result.ptr = arr.ptr;
+
+  if(arr.count <= count) {
+    result.count = arr.count;
+  } else {
+    result.count = count;
+  }
+
+  return result;
+}
+
+inline
+array_u64 drop(array_u64 arr, size_type count) {
+  array_u64 result;
+
+  assert(arr.count >= count);
+
+  result.ptr   = arr.ptr + count;
+  result.count = arr.count - count;
+
+  return result;
+}
+
+inline
+array_u64 zero_u64(allocator a, size_type count) {
+  array_u64 result;
+
+  result.ptr   = (u64*)cpeak_alloc(a, count * sizeof(u64));
+  result.count = count;
+
+  memset(result.ptr, 0, count * sizeof(u64));
+
+  return result;
+}
+
+inline
+void print(array_u64 arr) {
+  if(arr.count == 0U) {
+    printf("[]");
+  } else {
+    printf("[%llu", arr.ptr[0]);
+    for(size_type i = 1; i < arr.count; ++i) {
+      printf(", %llu", arr.ptr[i]);
+    }
+
+    printf("]");
+  }
+}
+
+#endif
@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "arena.h"
+#include "array_u32.h"
+#include "array_u32_filter.h"
+#include "array_u32_generate.h"
+#include "array_u32_permute.h"
+#include "array_u32_scan.h"
+#include "array_u32_select.h"
+#include "array_u32_wide.h"
+#include "bench.h"
+
+// runs the array_u32 kernels, arena allocation patterns and the allocators
+// at several sizes through bench.h
+//
+// usage: bench [--filter substring] [--reps n] [--cpu n] [--json path]
+
+#define BENCH_ARENA_SIZE (1ULL << 30)
+
+static bench_state state;
+
+inline
+void bench_name(char* name, cstring op, size_type count) {
+  // the op is bounded so that the count always fits
+  snprintf(name, BENCH_NAME_SIZE, "%.40s/%llu", op, (unsigned long long)count);
+}
+
+// every kernel allocates its result from the arena between a push/pop pair
+
+void bench_array_u32(arena ma, size_type count) {
+  allocator a = get_arena_alloc(ma);
+  char name[BENCH_NAME_SIZE];
+  u64 n = count;
+
+  array_u32 x = random_u32(a, count, 1U);
+  array_u32 y = random_u32(a, count, 2U);
+  array_u32 small = random_below(a, count, 1024U, 3U);
+  array_u32 indices = random_below(a, count, (u32)count, 4U);
+  array_u32 out = zero_u32(a, count);
+  array_u64 acc = zero_u64(a, count);
+
+#define BENCH_KERNEL(OP, BYTES, EXPR)        \
+  bench_name(name, OP, count);               \
+  bench_run(&state, name, n, (BYTES), [&]() { \
+    arena_push(ma);                          \
+    auto r = (EXPR);                         \
+    bench_do_not_optimize(&r);               \
+    arena_pop(ma);                           \
+  });
+
+  BENCH_KERNEL("add",              12U * n, add(a, x, y));
+  BENCH_KERNEL("add_scalar",        8U * n, add(a, x, 7U));
+  BENCH_KERNEL("mul",              12U * n, mul(a, x, y));
+  BENCH_KERNEL("div_scalar",        8U * n, div(a, x, 7U));
+  BENCH_KERNEL("xor",              12U * n, xor(a, x, y));
+  BENCH_KERNEL("add_sat",          12U * n, add_sat(a, x, y));
+  BENCH_KERNEL("mulhi",            12U * n, mulhi(a, x, y));
+  BENCH_KERNEL("mul_wide",         16U * n, mul_wide(a, x, y));
+  BENCH_KERNEL("sum_wide",          4U * n, sum_wide(x));
+  BENCH_KERNEL("inclusive_scan",    8U * n, inclusive_scan(a, x));
+  BENCH_KERNEL("histogram_1024",    4U * n, histogram(a, small, 1024U));
+  BENCH_KERNEL("histogram_radix",   4U * n, histogram_radix(a, x, 0U, 8U));
+  BENCH_KERNEL("compare_lt",        4U * n, compare<compare_op_lt>(a, x, &y.ptr[0], 0U, count));
+  BENCH_KERNEL("top_k_100",         4U * n, top_k_largest(a, x, MINIMUM(count, (size_type)100U)));
+  BENCH_KERNEL("median",            8U * n, median(a, x));
+  BENCH_KERNEL("gather",           12U * n, gather(a, x, indices));
+  BENCH_KERNEL("iota",              4U * n, iota_u32(a, count, 0U, 1U));
+  BENCH_KERNEL("random_u32",        4U * n, random_u32(a, count, 5U));
+  BENCH_KERNEL("random_below",      4U * n, random_below(a, count, 1000U, 5U));
+
+  bitset mask = compare<compare_op_lt>(a, x, &y.ptr[0], 0U, count);
+
+  BENCH_KERNEL("compress",          8U * n, compress(a, x, mask));
+
+#undef BENCH_KERNEL
+
+  // in place kernels, no allocation
+
+  bench_name(name, "fill", count);
+  bench_run(&state, name, n, 4U * n, [&]() {
+    fill(out, 1U);
+    bench_do_not_optimize(out.ptr);
+  });
+
+  bench_name(name, "add_wide", count);
+  bench_run(&state, name, n, 20U * n, [&]() {
+    add_wide(acc, x);
+    bench_do_not_optimize(acc.ptr);
+  });
+
+  bench_name(name, "scatter", count);
+  bench_run(&state, name, n, 12U * n, [&]() {
+    arena_push(ma);
+    scatter(a, out, indices, x);
+    bench_do_not_optimize(out.ptr);
+    arena_pop(ma);
+  });
+}
+
+// allocation patterns, 'count' allocations per call
+
+void bench_arena_patterns(arena ma, size_type count) {
+  char name[BENCH_NAME_SIZE];
+  u64 n = count;
+
+  bench_name(name, "arena_alloc_16", count);
+  bench_run(&state, name, n, 16U * n, [&]() {
+    arena_push(ma);
+
+    for(size_type i = 0; i < count; ++i)
+      bench_do_not_optimize(arena_alloc(ma, 16U));
+
+    arena_pop(ma);
+  });
+
+  bench_name(name, "arena_alloc_mixed", count);
+  bench_run(&state, name, n, 0U, [&]() {
+    arena_push(ma);
+
+    for(size_type i = 0; i < count; ++i)
+      bench_do_not_optimize(arena_alloc(ma, 8U + ((i * 0x9E3779B1U) >> 25)));
+
+    arena_pop(ma);
+  });
+
+  // a push/pop scope around every allocation, like a function using scratch memory
+
+  bench_name(name, "arena_push_pop", count);
+  bench_run(&state, name, n, 0U, [&]() {
+    for(size_type i = 0; i < count; ++i) {
+      arena_push(ma);
+      bench_do_not_optimize(arena_alloc(ma, 64U));
+      arena_pop(ma);
+    }
+  });
+
+  // growing the last allocation, an array appended to
+
+  bench_name(name, "arena_realloc_grow", count);
+  bench_run(&state, name, n, 4U * n, [&]() {
+    arena_push(ma);
+
+    u32* p = 0;
+
+    for(size_type i = 0; i < count; ++i) {
+      p = (u32*)arena_realloc(ma, p, (i + 1U) * sizeof(u32));
+      p[i] = (u32)i;
+    }
+
+    bench_do_not_optimize(p);
+    arena_pop(ma);
+  });
+}
+
+// the same pattern through allocator_interface for each allocator
+
+void bench_allocator(allocator a, cstring allocator_name, size_type count, void** ptrs) {
+  char op[BENCH_NAME_SIZE];
+  char name[BENCH_NAME_SIZE];
+  u64 n = count;
+
+  snprintf(op, BENCH_NAME_SIZE, "%s_alloc_free_64", allocator_name);
+  bench_name(name, op, count);
+  bench_run(&state, name, n, 64U * n, [&]() {
+    cpeak_push(a);
+
+    for(size_type i = 0; i < count; ++i)
+      ptrs[i] = cpeak_alloc(a, 64U);
+
+    bench_do_not_optimize(ptrs);
+
+    for(size_type i = 0; i < count; ++i)
+      cpeak_free(a, ptrs[i]);
+
+    cpeak_pop(a);
+  });
+
+  snprintf(op, BENCH_NAME_SIZE, "%s_alloc_free_mixed", allocator_name);
+  bench_name(name, op, count);
+  bench_run(&state, name, n, 0U, [&]() {
+    cpeak_push(a);
+
+    for(size_type i = 0; i < count; ++i)
+      ptrs[i] = cpeak_alloc(a, 8U + ((i * 0x9E3779B1U) >> 22));
+
+    bench_do_not_optimize(ptrs);
+
+    for(size_type i = 0; i < count; ++i)
+      cpeak_free(a, ptrs[count - 1U - i]);
+
+    cpeak_pop(a);
+  });
+}
+
+void bench_allocators(arena ma, size_type count) {
+  void** ptrs = (void**)arena_alloc(ma, count * sizeof(void*));
+  arena scratch = make_arena(ma, 1ULL << 28);
+
+  bench_allocator(std_alloc, "std", count, ptrs);
+  bench_allocator(get_arena_alloc(scratch), "arena", count, ptrs);
+}
+
+int main(int argc, char** argv) {
+  bench_config config = default_bench_config();
+  cstring json_path = 0;
+
+  if(!bench_parse_args(argc, argv, &config, &json_path))
+    return 1;
+
+  bench_init(&state, config);
+
+  printf("simd: %s, counters: %s, pinned: %s\n", bench_simd_level(),
+         bench_counters_available(&state) ? "yes" : "no", state.pinned ? "yes" : "no");
+
+  arena ma = make_system_arena(BENCH_ARENA_SIZE);
+
+  size_type array_sizes[] = { 4096U, 256U * 1024U, 16U * 1024U * 1024U };
+  size_type alloc_sizes[] = { 1024U, 64U * 1024U };
+
+  for(size_type count : array_sizes) {
+    arena_push(ma);
+    bench_array_u32(ma, count);
+    arena_pop(ma);
+  }
+
+  for(size_type count : alloc_sizes) {
+    arena_push(ma);
+    bench_arena_patterns(ma, count);
+    bench_allocators(ma, count);
+    arena_pop(ma);
+  }
+
+  if(json_path) {
+    FILE* f = fopen(json_path, "w");
+
+    if(f) {
+      bench_write_json(&state, f);
+      fclose(f);
+    } else {
+      printf("can't write %s\n", json_path);
+    }
+  }
+
+  bench_finish(&state);
+  free_system_arena(ma);
+
+  return 0;
+}
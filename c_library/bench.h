@@ -0,0 +1,599 @@
+/**
+ *  bench.h
+ *
+ *  Microbenchmark harness.
+ *
+ *  bench_run times an operation: a warmup phase also picks how many calls
+ *  make up one repetition (at least BENCH_MIN_REP_NS), then every
+ *  repetition is timed separately. The results are min/median/mean/stddev
+ *  of the time per call, ns per element and GB/s for the median.
+ *
+ *  On Linux the repetitions are also measured with perf_event_open
+ *  counters (cycles, instructions, cache misses, branch misses, user space
+ *  only). Counters that can't be opened (no PMU in a VM, a restrictive
+ *  perf_event_paranoid, other platforms) are reported as unavailable
+ *  (-1, null in JSON) and everything else still works.
+ *
+ *  bench_parse_args reads the options every bench program takes.
+ *  bench_init optionally pins the calling thread to one CPU.
+ *  bench_record_memory attaches memory use (live bytes requested and RSS
+ *  growth, see bench_current_rss) to the last result.
+ *  bench_write_json writes all results of a run as one JSON document,
+ *  with one result per line so that two runs diff cleanly.
+ */
+
+#ifndef CPEAK_BENCH_H
+#define CPEAK_BENCH_H
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "macro.h"
+#include "simd.h"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <psapi.h>
+#include <intrin.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#define BENCH_MAX_RESULTS   1024U
+#define BENCH_MAX_REPS      256U
+#define BENCH_NAME_SIZE     64U
+#define BENCH_MIN_REP_NS    200000.0 // 0.2 ms
+#define BENCH_COUNTER_COUNT 4U
+
+enum bench_counter_enum {
+  bench_counter_cycles,
+  bench_counter_instructions,
+  bench_counter_cache_misses,
+  bench_counter_branch_misses,
+};
+
+typedef struct bench_config {
+  u32     warmup;  // untimed repetitions
+  u32     reps;    // timed repetitions, at most BENCH_MAX_REPS
+  i32     cpu;     // cpu to pin to, -1 for no pinning
+  cstring filter;  // only run benchmarks whose name contains this, null for all
+} bench_config;
+
+typedef struct bench_result {
+  char name[BENCH_NAME_SIZE];
+  u64  elements;   // elements processed per call
+  u64  bytes;      // bytes read + written per call, 0 if not meaningful
+  u64  calls;      // calls per repetition
+  u32  reps;
+  f64  min_ns;     // per call
+  f64  median_ns;
+  f64  mean_ns;
+  f64  stddev_ns;
+  f64  ns_per_element;
+  f64  gb_per_s;   // -1 if bytes is 0
+  f64  counters[BENCH_COUNTER_COUNT]; // per element, -1 if unavailable
+  f64  live_bytes; // peak bytes requested and not yet freed, -1 if not recorded
+  f64  rss_bytes;  // peak resident set growth, -1 if not recorded
+} bench_result;
+
+typedef struct bench_state {
+  bench_config config;
+  bool         pinned;
+  int          counter_fds[BENCH_COUNTER_COUNT]; // -1 if unavailable
+  u32          result_count;
+  bench_result results[BENCH_MAX_RESULTS];
+} bench_state;
+
+inline
+bench_config default_bench_config() {
+  bench_config result;
+
+  result.warmup = 2U;
+  result.reps   = 15U;
+  result.cpu    = -1;
+  result.filter = 0;
+
+  return result;
+}
+
+// reads --filter substring, --reps n, --cpu n and --json path into config
+// and json_path, which keep their values for the options that aren't
+// given; prints the usage and returns false on anything else
+
+inline
+bool bench_parse_args(int argc, char** argv, bench_config* config, cstring* json_path) {
+  for(int i = 1; i < argc; ++i) {
+    if(strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+      config->filter = argv[++i];
+    } else if(strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+      config->reps = (u32)atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+      config->cpu = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+      *json_path = argv[++i];
+    } else {
+      printf("usage: %s [--filter substring] [--reps n] [--cpu n] [--json path]\n", argv[0]);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//
+// timer
+//
+
+inline
+f64 bench_now_ns() {
+#if defined(_WIN32)
+  LARGE_INTEGER counter, frequency;
+
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+
+  return (f64)counter.QuadPart * (1e9 / (f64)frequency.QuadPart);
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (f64)ts.tv_sec * 1e9 + (f64)ts.tv_nsec;
+#endif
+}
+
+// keeps the compiler from optimizing away the computation of *p
+
+inline
+void bench_do_not_optimize(const void* p) {
+#if defined(_MSC_VER)
+  (void)p;
+  _ReadWriteBarrier();
+#else
+  __asm__ __volatile__("" : : "r"(p) : "memory");
+#endif
+}
+
+//
+// memory
+//
+
+// resident set size of the process in bytes, 0 if unknown
+
+inline
+usize bench_current_rss() {
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters;
+
+  if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return (usize)counters.WorkingSetSize;
+
+  return 0U;
+#elif defined(__linux__)
+  unsigned long long size = 0U, resident = 0U;
+  FILE* f = fopen("/proc/self/statm", "r");
+
+  if(f == 0)
+    return 0U;
+
+  if(fscanf(f, "%llu %llu", &size, &resident) != 2)
+    resident = 0U;
+
+  fclose(f);
+
+  return (usize)resident * (usize)sysconf(_SC_PAGESIZE);
+#else
+  return 0U;
+#endif
+}
+
+// highest resident set size of the process so far in bytes, 0 if unknown
+
+inline
+usize bench_peak_rss() {
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters;
+
+  if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return (usize)counters.PeakWorkingSetSize;
+
+  return 0U;
+#else
+  struct rusage usage;
+
+  if(getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0U;
+
+#if defined(__APPLE__)
+  return (usize)usage.ru_maxrss;
+#else
+  return (usize)usage.ru_maxrss * 1024U;
+#endif
+#endif
+}
+
+//
+// pinning
+//
+
+inline
+bool bench_pin_thread(i32 cpu) {
+#if defined(_WIN32)
+  return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1U << cpu) != 0;
+#elif defined(__linux__)
+  cpu_set_t set;
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+//
+// hardware counters
+//
+
+inline
+cstring bench_counter_name(u32 counter) {
+  switch(counter) {
+    case bench_counter_cycles:       return "cycles";
+    case bench_counter_instructions: return "instructions";
+    case bench_counter_cache_misses: return "cache_misses";
+    default:                         return "branch_misses";
+  }
+}
+
+#if defined(__linux__)
+inline
+int bench_open_counter(u32 counter) {
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+
+  attr.size           = sizeof(attr);
+  attr.type           = PERF_TYPE_HARDWARE;
+  attr.disabled       = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv     = 1;
+  attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  switch(counter) {
+    case bench_counter_cycles:       attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+    case bench_counter_instructions: attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+    case bench_counter_cache_misses: attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+    default:                         attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+  }
+
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+inline
+bool bench_counters_available(const bench_state* b) {
+  for(u32 c = 0U; c < BENCH_COUNTER_COUNT; ++c) {
+    if(b->counter_fds[c] >= 0)
+      return true;
+  }
+
+  return false;
+}
+
+inline
+void bench_counters_start(bench_state* b) {
+#if defined(__linux__)
+  for(u32 c = 0U; c < BENCH_COUNTER_COUNT; ++c) {
+    if(b->counter_fds[c] >= 0) {
+      ioctl(b->counter_fds[c], PERF_EVENT_IOC_RESET, 0);
+      ioctl(b->counter_fds[c], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+#else
+  (void)b;
+#endif
+}
+
+// values[c] = count since bench_counters_start, scaled up if the counter was multiplexed, or -1
+
+inline
+void bench_counters_stop(bench_state* b, f64 values[BENCH_COUNTER_COUNT]) {
+  for(u32 c = 0U; c < BENCH_COUNTER_COUNT; ++c) {
+    values[c] = -1.0;
+
+#if defined(__linux__)
+    u64 data[3]; // value, time enabled, time running
+
+    if(b->counter_fds[c] < 0)
+      continue;
+
+    ioctl(b->counter_fds[c], PERF_EVENT_IOC_DISABLE, 0);
+
+    if(read(b->counter_fds[c], data, sizeof(data)) == (ssize_t)sizeof(data) && data[2] != 0U)
+      values[c] = (f64)data[0] * ((f64)data[1] / (f64)data[2]);
+#endif
+  }
+}
+
+//
+// setup
+//
+
+inline
+void bench_init(bench_state* b, bench_config config) {
+  b->config = config;
+  b->config.reps = MAXIMUM(MINIMUM(config.reps, BENCH_MAX_REPS), 1U);
+  b->result_count = 0U;
+  b->pinned = (config.cpu >= 0) ? bench_pin_thread(config.cpu) : false;
+
+  for(u32 c = 0U; c < BENCH_COUNTER_COUNT; ++c) {
+#if defined(__linux__)
+    b->counter_fds[c] = bench_open_counter(c);
+#else
+    b->counter_fds[c] = -1;
+#endif
+  }
+}
+
+inline
+void bench_finish(bench_state* b) {
+#if defined(__linux__)
+  for(u32 c = 0U; c < BENCH_COUNTER_COUNT; ++c) {
+    if(b->counter_fds[c] >= 0)
+      close(b->counter_fds[c]);
+
+    b->counter_fds[c] = -1;
+  }
+#else
+  (void)b;
+#endif
+}
+
+inline
+bool bench_selected(const bench_state* b, cstring name) {
+  return b->config.filter == 0 || strstr(name, b->config.filter) != 0;
+}
+
+//
+// running
+//
+
+inline
+void bench_sort(f64* x, u32 count) {
+  for(u32 i = 1U; i < count; ++i) {
+    f64 v = x[i];
+    u32 j = i;
+
+    for(; j > 0U && x[j - 1U] > v; --j)
+      x[j] = x[j - 1U];
+
+    x[j] = v;
+  }
+}
+
+inline
+void bench_print_result(const bench_result* r) {
+  printf("%-40s %10llu %10.3f ns/elem", r->name, r->elements, r->ns_per_element);
+
+  if(r->gb_per_s >= 0.0)
+    printf(" %8.2f GB/s", r->gb_per_s);
+  else
+    printf("        - GB/s");
+
+  printf("  +-%4.1f%%", (r->mean_ns > 0.0) ? 100.0 * r->stddev_ns / r->mean_ns : 0.0);
+
+  if(r->counters[bench_counter_cycles] >= 0.0)
+    printf("  %7.3f cyc/elem", r->counters[bench_counter_cycles]);
+
+  if(r->counters[bench_counter_cycles] > 0.0 && r->counters[bench_counter_instructions] >= 0.0)
+    printf("  %5.2f IPC", r->counters[bench_counter_instructions] / r->counters[bench_counter_cycles]);
+
+  if(r->counters[bench_counter_cache_misses] >= 0.0)
+    printf("  %7.4f llc-miss/elem", r->counters[bench_counter_cache_misses]);
+
+  if(r->counters[bench_counter_branch_misses] >= 0.0)
+    printf("  %7.4f br-miss/elem", r->counters[bench_counter_branch_misses]);
+
+  printf("\n");
+  fflush(stdout);
+}
+
+inline
+void bench_print_memory(const bench_result* r) {
+  printf("%-40s %10s %10.2f MB live %8.2f MB rss", "", "", r->live_bytes / 1048576.0, r->rss_bytes / 1048576.0);
+
+  if(r->live_bytes > 0.0)
+    printf("  %5.2fx overhead", r->rss_bytes / r->live_bytes);
+
+  printf("\n");
+  fflush(stdout);
+}
+
+// attaches memory use to the last result of bench_run
+
+inline
+void bench_record_memory(bench_state* b, cstring name, usize live_bytes, usize rss_bytes) {
+  if(!bench_selected(b, name) || b->result_count == 0U)
+    return;
+
+  bench_result* r = b->results + b->result_count - 1U;
+
+  r->live_bytes = (f64)live_bytes;
+  r->rss_bytes  = (f64)rss_bytes;
+
+  bench_print_memory(r);
+}
+
+// times op() which processes 'elements' elements and reads + writes 'bytes' bytes per call
+
+template <typename Op>
+inline
+void bench_run(bench_state* b, cstring name, u64 elements, u64 bytes, Op op) {
+  f64 times[BENCH_MAX_REPS];
+  f64 counter_sums[BENCH_COUNTER_COUNT];
+
+  if(!bench_selected(b, name) || b->result_count == BENCH_MAX_RESULTS)
+    return;
+
+  // warmup, doubling the calls per repetition until one takes BENCH_MIN_REP_NS
+
+  u64 calls = 1U;
+
+  for(;;) {
+    f64 start = bench_now_ns();
+
+    for(u64 i = 0; i < calls; ++i)
+      op();
+
+    if(bench_now_ns() - start >= BENCH_MIN_REP_NS)
+      break;
+
+    calls *= 2U;
+  }
+
+  for(u32 w = 0U; w < b->config.warmup; ++w) {
+    for(u64 i = 0; i < calls; ++i)
+      op();
+  }
+
+  for(u32 c = 0U; c < BENCH_COUNTER_COUNT; ++c)
+    counter_sums[c] = 0.0;
+
+  for(u32 r = 0U; r < b->config.reps; ++r) {
+    f64 values[BENCH_COUNTER_COUNT];
+
+    bench_counters_start(b);
+    f64 start = bench_now_ns();
+
+    for(u64 i = 0; i < calls; ++i)
+      op();
+
+    times[r] = (bench_now_ns() - start) / (f64)calls;
+    bench_counters_stop(b, values);
+
+    for(u32 c = 0U; c < BENCH_COUNTER_COUNT; ++c)
+      counter_sums[c] = (values[c] < 0.0 || counter_sums[c] < 0.0) ? -1.0 : counter_sums[c] + values[c];
+  }
+
+  bench_result* result = b->results + b->result_count++;
+  u32 reps = b->config.reps;
+
+  snprintf(result->name, BENCH_NAME_SIZE, "%s", name);
+  result->elements   = elements;
+  result->bytes      = bytes;
+  result->calls      = calls;
+  result->reps       = reps;
+  result->live_bytes = -1.0;
+  result->rss_bytes  = -1.0;
+
+  f64 sum = 0.0;
+
+  for(u32 r = 0U; r < reps; ++r)
+    sum += times[r];
+
+  result->mean_ns = sum / reps;
+
+  f64 variance = 0.0;
+
+  for(u32 r = 0U; r < reps; ++r)
+    variance += (times[r] - result->mean_ns) * (times[r] - result->mean_ns);
+
+  result->stddev_ns = (reps > 1U) ? sqrt(variance / (reps - 1U)) : 0.0;
+
+  bench_sort(times, reps);
+
+  result->min_ns         = times[0];
+  result->median_ns      = (reps % 2U) ? times[reps / 2U] : 0.5 * (times[reps / 2U - 1U] + times[reps / 2U]);
+  result->ns_per_element = result->median_ns / (f64)MAXIMUM(elements, (u64)1U);
+  result->gb_per_s       = (bytes != 0U && result->median_ns > 0.0) ? (f64)bytes / result->median_ns : -1.0;
+
+  for(u32 c = 0U; c < BENCH_COUNTER_COUNT; ++c) {
+    f64 per_call = counter_sums[c] / ((f64)reps * (f64)calls);
+
+    result->counters[c] = (counter_sums[c] < 0.0) ? -1.0 : per_call / (f64)MAXIMUM(elements, (u64)1U);
+  }
+
+  bench_print_result(result);
+}
+
+//
+// output
+//
+
+inline
+cstring bench_simd_level() {
+#if defined(CPEAK_AVX512)
+  return "avx512";
+#elif defined(CPEAK_AVX2)
+  return "avx2";
+#elif defined(CPEAK_SSSE3)
+  return "ssse3";
+#elif defined(CPEAK_SSE2)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
+
+inline
+void bench_write_json_number(FILE* f, f64 x) {
+  if(x < 0.0 || x != x)
+    fprintf(f, "null");
+  else
+    fprintf(f, "%.6g", x);
+}
+
+inline
+void bench_write_json(const bench_state* b, FILE* f) {
+  fprintf(f, "{\n");
+  fprintf(f, "  \"simd\": \"%s\",\n", bench_simd_level());
+  fprintf(f, "  \"pinned_cpu\": %d,\n", b->pinned ? b->config.cpu : -1);
+  fprintf(f, "  \"counters\": %s,\n", bench_counters_available(b) ? "true" : "false");
+  fprintf(f, "  \"reps\": %u,\n", b->config.reps);
+  fprintf(f, "  \"results\": [\n");
+
+  for(u32 i = 0U; i < b->result_count; ++i) {
+    const bench_result* r = b->results + i;
+
+    fprintf(f, "    {\"name\": \"%s\", \"elements\": %llu, \"bytes\": %llu, \"calls\": %llu, ",
+            r->name, r->elements, r->bytes, r->calls);
+    fprintf(f, "\"min_ns\": %.6g, \"median_ns\": %.6g, \"mean_ns\": %.6g, \"stddev_ns\": %.6g, ",
+            r->min_ns, r->median_ns, r->mean_ns, r->stddev_ns);
+    fprintf(f, "\"ns_per_element\": %.6g, \"gb_per_s\": ", r->ns_per_element);
+    bench_write_json_number(f, r->gb_per_s);
+
+    for(u32 c = 0U; c < BENCH_COUNTER_COUNT; ++c) {
+      fprintf(f, ", \"%s_per_element\": ", bench_counter_name(c));
+      bench_write_json_number(f, r->counters[c]);
+    }
+
+    fprintf(f, ", \"live_bytes\": ");
+    bench_write_json_number(f, r->live_bytes);
+    fprintf(f, ", \"rss_bytes\": ");
+    bench_write_json_number(f, r->rss_bytes);
+
+    fprintf(f, "}%s\n", (i + 1U < b->result_count) ? "," : "");
+  }
+
+  fprintf(f, "  ]\n");
+  fprintf(f, "}\n");
+}
+
+#endif
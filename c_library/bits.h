@@ -0,0 +1,93 @@
+#ifndef CPEAK_BITS_H
+#define CPEAK_BITS_H
+
+#include "types.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// bit counting and scanning helpers
+// note: the ctz/clz functions are undefined for a zero argument
+
+inline
+u32 bits_popcount_u32(u32 x) {
+#if defined(_MSC_VER)
+  x = x - ((x >> 1U) & 0x55555555U);
+  x = (x & 0x33333333U) + ((x >> 2U) & 0x33333333U);
+  x = (x + (x >> 4U)) & 0x0F0F0F0FU;
+
+  return (x * 0x01010101U) >> 24U;
+#else
+  return (u32)__builtin_popcount(x);
+#endif
+}
+
+inline
+u32 bits_popcount_u64(u64 x) {
+#if defined(_MSC_VER)
+  return bits_popcount_u32((u32)x) + bits_popcount_u32((u32)(x >> 32U));
+#else
+  return (u32)__builtin_popcountll(x);
+#endif
+}
+
+inline
+u32 bits_ctz_u32(u32 x) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, x);
+
+  return (u32)index;
+#else
+  return (u32)__builtin_ctz(x);
+#endif
+}
+
+inline
+u32 bits_ctz_u64(u64 x) {
+#if defined(_MSC_VER)
+  u32 lo = (u32)x;
+
+  if(lo != 0U)
+    return bits_ctz_u32(lo);
+  else
+    return 32U + bits_ctz_u32((u32)(x >> 32U));
+#else
+  return (u32)__builtin_ctzll(x);
+#endif
+}
+
+inline
+u32 bits_clz_u32(u32 x) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse(&index, x);
+
+  return 31U - (u32)index;
+#else
+  return (u32)__builtin_clz(x);
+#endif
+}
+
+inline
+u32 bits_clz_u64(u64 x) {
+  u32 hi = (u32)(x >> 32U);
+
+  if(hi != 0U)
+    return bits_clz_u32(hi);
+  else
+    return 32U + bits_clz_u32((u32)x);
+}
+
+// number of bits required to represent x, 0 for x == 0
+
+inline
+u32 bits_width_u32(u32 x) {
+  if(x == 0U)
+    return 0U;
+  else
+    return 32U - bits_clz_u32(x);
+}
+
+#endif
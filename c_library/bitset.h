@@ -0,0 +1,224 @@
+/**
+ *  bitset.h
+ *
+ *  Packed bitsets, one bit per element in u64 words.
+ *
+ *  Invariant: the bits past 'count' in the last word are always zero, so
+ *  popcount/any don't need to mask the tail.
+ */
+
+#ifndef CPEAK_BITSET_H
+#define CPEAK_BITSET_H
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "types.h"
+#include "macro.h"
+#include "alloc.h"
+#include "bits.h"
+
+typedef struct bitset {
+  u64*      words;
+  size_type count; // number of bits
+} bitset;
+
+inline
+size_type bitset_word_count(size_type count) {
+  return (count + 63U) / 64U;
+}
+
+// mask of the valid bits in the last word
+
+inline
+u64 bitset_tail_mask(size_type count) {
+  u32 tail = (u32)(count % 64U);
+
+  return (tail == 0U) ? ~(u64)0U : (((u64)1U << tail) - 1U);
+}
+
+inline
+bitset make_bitset(allocator a, size_type count) {
+  bitset result;
+  size_type word_count = bitset_word_count(count);
+
+  result.words = (u64*)cpeak_alloc(a, word_count * sizeof(u64));
+  result.count = count;
+
+  memset(result.words, 0, word_count * sizeof(u64));
+
+  return result;
+}
+
+inline
+size_type length(bitset b) {
+  return b.count;
+}
+
+inline
+bool test(bitset b, size_type i) {
+  assert(i < b.count);
+
+  return (b.words[i / 64U] >> (i % 64U)) & 1U;
+}
+
+inline
+void set(bitset b, size_type i) {
+  assert(i < b.count);
+
+  b.words[i / 64U] |= (u64)1U << (i % 64U);
+}
+
+inline
+void clear(bitset b, size_type i) {
+  assert(i < b.count);
+
+  b.words[i / 64U] &= ~((u64)1U << (i % 64U));
+}
+
+inline
+size_type popcount(bitset b) {
+  size_type result = 0U;
+  size_type word_count = bitset_word_count(b.count);
+
+  for(size_type i = 0; i < word_count; ++i) {
+    result += bits_popcount_u64(b.words[i]);
+  }
+
+  return result;
+}
+
+inline
+bool any(bitset b) {
+  size_type word_count = bitset_word_count(b.count);
+
+  for(size_type i = 0; i < word_count; ++i) {
+    if(b.words[i] != 0U)
+      return true;
+  }
+
+  return false;
+}
+
+inline
+bool all(bitset b) {
+  size_type word_count = bitset_word_count(b.count);
+
+  if(word_count == 0U)
+    return true;
+
+  for(size_type i = 0; i + 1U < word_count; ++i) {
+    if(b.words[i] != ~(u64)0U)
+      return false;
+  }
+
+  return b.words[word_count - 1U] == bitset_tail_mask(b.count);
+}
+
+// calls op(size_type index) for every set bit in increasing order
+
+template <typename Op>
+inline
+void for_each_set(bitset b, Op op) {
+  size_type word_count = bitset_word_count(b.count);
+
+  for(size_type i = 0; i < word_count; ++i) {
+    u64 w = b.words[i];
+
+    while(w != 0U) {
+      op(i * 64U + bits_ctz_u64(w));
+      w &= w - 1U;
+    }
+  }
+}
+
+// bitwise combinations, the result has the length of the shorter operand
+
+inline
+bitset and(allocator a, bitset x, bitset y) {
+  bitset result;
+
+  result.count = MINIMUM(x.count, y.count);
+
+  size_type word_count = bitset_word_count(result.count);
+  result.words = (u64*)cpeak_alloc(a, word_count * sizeof(u64));
+
+  for(size_type i = 0; i < word_count; ++i) {
+    result.words[i] = x.words[i] & y.words[i];
+  }
+
+  if(word_count > 0U)
+    result.words[word_count - 1U] &= bitset_tail_mask(result.count);
+
+  return result;
+}
+
+inline
+bitset or(allocator a, bitset x, bitset y) {
+  bitset result;
+
+  result.count = MINIMUM(x.count, y.count);
+
+  size_type word_count = bitset_word_count(result.count);
+  result.words = (u64*)cpeak_alloc(a, word_count * sizeof(u64));
+
+  for(size_type i = 0; i < word_count; ++i) {
+    result.words[i] = x.words[i] | y.words[i];
+  }
+
+  if(word_count > 0U)
+    result.words[word_count - 1U] &= bitset_tail_mask(result.count);
+
+  return result;
+}
+
+inline
+bitset xor(allocator a, bitset x, bitset y) {
+  bitset result;
+
+  result.count = MINIMUM(x.count, y.count);
+
+  size_type word_count = bitset_word_count(result.count);
+  result.words = (u64*)cpeak_alloc(a, word_count * sizeof(u64));
+
+  for(size_type i = 0; i < word_count; ++i) {
+    result.words[i] = x.words[i] ^ y.words[i];
+  }
+
+  if(word_count > 0U)
+    result.words[word_count - 1U] &= bitset_tail_mask(result.count);
+
+  return result;
+}
+
+inline
+bitset invert(allocator a, bitset x) {
+  bitset result;
+
+  result.count = x.count;
+
+  size_type word_count = bitset_word_count(result.count);
+  result.words = (u64*)cpeak_alloc(a, word_count * sizeof(u64));
+
+  for(size_type i = 0; i < word_count; ++i) {
+    result.words[i] = ~x.words[i];
+  }
+
+  if(word_count > 0U)
+    result.words[word_count - 1U] &= bitset_tail_mask(result.count);
+
+  return result;
+}
+
+inline
+void print(bitset b) {
+  printf("[");
+
+  for(size_type i = 0; i < b.count; ++i) {
+    printf("%c", test(b, i) ? '1' : '0');
+  }
+
+  printf("]");
+}
+
+#endif
@@ -0,0 +1,710 @@
+/**
+ *  hash_map.h
+ *
+ *  Open-addressing hash map and set in the SwissTable layout.
+ *
+ *  Every slot has a control byte: empty (0x80), deleted (0xFE) or the low
+ *  7 bits of the key hash when full. Lookups scan the control bytes of 16
+ *  slots at a time (one SSE2 compare + movemask) and only compare the keys
+ *  whose 7 hash bits match. Groups are probed quadratically, the first 16
+ *  control bytes are mirrored past the end so that a group can start at
+ *  any slot. The table is kept at most 7/8 full.
+ *
+ *  Keys are u32, u64 or string_slice (hash_key/hash_key_equal overloads),
+ *  keys and values are copied as plain data. A string_slice key is not
+ *  copied, the chars it points to must outlive the map.
+ *
+ *  The control bytes, keys and values share one block from the allocator,
+ *  so with an arena allocator (make_hash_map(arena, ...)) the map is
+ *  released with the arena. Growing leaves the old block to the allocator,
+ *  reserve the expected size up front when using an arena.
+ *
+ *  hash_set<K> is a hash_map<K, hash_unit> without value storage.
+ */
+
+#ifndef CPEAK_HASH_MAP_H
+#define CPEAK_HASH_MAP_H
+
+#include <assert.h>
+#include <string.h>
+#include "types.h"
+#include "macro.h"
+#include "alloc.h"
+#include "arena.h"
+#include "bits.h"
+#include "simd.h"
+#include "array_u32.h"
+
+#define HASH_MAP_GROUP_WIDTH  16U
+#define HASH_MAP_MIN_CAPACITY 16U
+#define HASH_MAP_BATCH        16U // keys hashed and prefetched ahead in the bulk lookups
+
+#define HASH_CTRL_EMPTY   ((i8)-128) // 0x80
+#define HASH_CTRL_DELETED ((i8)-2)   // 0xFE
+
+//
+// key hashing
+//
+
+inline
+u64 hash_mix(u64 x) {
+  x ^= x >> 32;
+  x *= 0xD6E8FEB86659FD93ULL;
+  x ^= x >> 32;
+  x *= 0xD6E8FEB86659FD93ULL;
+  x ^= x >> 32;
+
+  return x;
+}
+
+inline
+u64 hash_key(u32 key) {
+  return hash_mix((u64)key);
+}
+
+inline
+u64 hash_key(u64 key) {
+  return hash_mix(key);
+}
+
+inline
+u64 hash_key(string_slice key) {
+  const u8* p = (const u8*)key.ptr;
+  u64 h = 0x9E3779B97F4A7C15ULL ^ ((u64)key.length * 0xC2B2AE3D27D4EB4FULL);
+  size_type i = 0;
+
+  for(; i + 8U <= key.length; i += 8U) {
+    u64 w;
+
+    memcpy(&w, p + i, 8U);
+    h = (h ^ w) * 0x9FB21C651E98DF25ULL;
+    h ^= h >> 29;
+  }
+
+  if(i < key.length) {
+    u64 w = 0U;
+
+    memcpy(&w, p + i, key.length - i);
+    h = (h ^ w) * 0x9FB21C651E98DF25ULL;
+  }
+
+  return hash_mix(h);
+}
+
+inline
+bool hash_key_equal(u32 x, u32 y) {
+  return x == y;
+}
+
+inline
+bool hash_key_equal(u64 x, u64 y) {
+  return x == y;
+}
+
+inline
+bool hash_key_equal(string_slice x, string_slice y) {
+  return x.length == y.length && memcmp(x.ptr, y.ptr, x.length) == 0;
+}
+
+inline
+string_slice make_string_slice(cstring s) {
+  string_slice result;
+
+  result.ptr    = s;
+  result.length = (size_type)strlen(s);
+
+  return result;
+}
+
+//
+// control byte groups, bit i of a mask is slot i of the group
+//
+
+inline
+u32 hash_group_match(const i8* ctrl, i8 h2) {
+#if defined(CPEAK_SSE2)
+  __m128i g = _mm_loadu_si128((const __m128i*)ctrl);
+
+  return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(h2)));
+#else
+  u32 result = 0U;
+
+  for(u32 i = 0U; i < HASH_MAP_GROUP_WIDTH; ++i)
+    result |= (u32)(ctrl[i] == h2) << i;
+
+  return result;
+#endif
+}
+
+inline
+u32 hash_group_match_empty(const i8* ctrl) {
+  return hash_group_match(ctrl, HASH_CTRL_EMPTY);
+}
+
+// empty and deleted are the control bytes with the sign bit set
+
+inline
+u32 hash_group_match_free(const i8* ctrl) {
+#if defined(CPEAK_SSE2)
+  return (u32)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+#else
+  u32 result = 0U;
+
+  for(u32 i = 0U; i < HASH_MAP_GROUP_WIDTH; ++i)
+    result |= (u32)(ctrl[i] < 0) << i;
+
+  return result;
+#endif
+}
+
+//
+// the map
+//
+
+typedef struct hash_unit {
+} hash_unit;
+
+template <typename K, typename V>
+struct hash_map {
+  allocator a;
+  i8*       ctrl;        // capacity + HASH_MAP_GROUP_WIDTH control bytes
+  K*        keys;
+  V*        values;      // null for hash_unit
+  size_type capacity;    // power of 2, 0 before the first insert
+  size_type count;
+  size_type growth_left; // inserts into empty slots before the next rehash
+};
+
+template <typename K>
+struct hash_set {
+  hash_map<K, hash_unit> map;
+};
+
+template <typename V>
+inline
+size_type hash_value_size() {
+  return sizeof(V);
+}
+
+template <>
+inline
+size_type hash_value_size<hash_unit>() {
+  return 0U;
+}
+
+inline
+size_type hash_map_max_load(size_type capacity) {
+  return capacity - capacity / 8U;
+}
+
+// smallest capacity that holds count entries
+
+inline
+size_type hash_map_capacity_for(size_type count) {
+  size_type result = HASH_MAP_MIN_CAPACITY;
+
+  while(hash_map_max_load(result) < count)
+    result *= 2U;
+
+  return result;
+}
+
+template <typename K, typename V>
+inline
+void hash_map_set_ctrl(hash_map<K, V>* m, size_type slot, i8 c) {
+  m->ctrl[slot] = c;
+
+  // mirror of the first group past the end
+  if(slot < HASH_MAP_GROUP_WIDTH)
+    m->ctrl[m->capacity + slot] = c;
+}
+
+// allocates empty storage for capacity slots
+
+template <typename K, typename V>
+inline
+void hash_map_alloc_slots(hash_map<K, V>* m, size_type capacity) {
+  size_type ctrl_bytes  = (capacity + HASH_MAP_GROUP_WIDTH + 15U) & ~(size_type)15U;
+  size_type key_bytes   = (capacity * (size_type)sizeof(K) + 15U) & ~(size_type)15U;
+  size_type value_bytes = capacity * hash_value_size<V>();
+
+  u8* block = (u8*)cpeak_alloc(m->a, ctrl_bytes + key_bytes + value_bytes);
+
+  m->ctrl        = (i8*)block;
+  m->keys        = (K*)(block + ctrl_bytes);
+  m->values      = (value_bytes != 0U) ? (V*)(block + ctrl_bytes + key_bytes) : 0;
+  m->capacity    = capacity;
+  m->count       = 0U;
+  m->growth_left = hash_map_max_load(capacity);
+
+  memset(m->ctrl, HASH_CTRL_EMPTY, capacity + HASH_MAP_GROUP_WIDTH);
+}
+
+template <typename K, typename V>
+inline
+hash_map<K, V> make_hash_map(allocator a, size_type expected_count) {
+  hash_map<K, V> result;
+
+  result.a           = a;
+  result.ctrl        = 0;
+  result.keys        = 0;
+  result.values      = 0;
+  result.capacity    = 0U;
+  result.count       = 0U;
+  result.growth_left = 0U;
+
+  if(expected_count != 0U)
+    hash_map_alloc_slots(&result, hash_map_capacity_for(expected_count));
+
+  return result;
+}
+
+template <typename K, typename V>
+inline
+hash_map<K, V> make_hash_map(arena ma, size_type expected_count) {
+  return make_hash_map<K, V>(get_arena_alloc(ma), expected_count);
+}
+
+template <typename K, typename V>
+inline
+void free_hash_map(hash_map<K, V>* m) {
+  if(m->ctrl != 0)
+    cpeak_free(m->a, m->ctrl);
+
+  m->ctrl        = 0;
+  m->keys        = 0;
+  m->values      = 0;
+  m->capacity    = 0U;
+  m->count       = 0U;
+  m->growth_left = 0U;
+}
+
+template <typename K, typename V>
+inline
+void clear(hash_map<K, V>* m) {
+  if(m->capacity == 0U)
+    return;
+
+  memset(m->ctrl, HASH_CTRL_EMPTY, m->capacity + HASH_MAP_GROUP_WIDTH);
+  m->count = 0U;
+  m->growth_left = hash_map_max_load(m->capacity);
+}
+
+// slot of key, or capacity if the key isn't in the map
+
+template <typename K, typename V>
+inline
+size_type hash_map_find_slot(const hash_map<K, V>* m, K key, u64 h) {
+  if(m->capacity == 0U)
+    return 0U;
+
+  size_type mask = m->capacity - 1U;
+  size_type pos = (size_type)(h >> 7) & mask;
+  size_type step = 0U;
+  i8 h2 = (i8)(h & 0x7FU);
+
+  for(;;) {
+    const i8* group = m->ctrl + pos;
+    u32 hit = hash_group_match(group, h2);
+
+    while(hit != 0U) {
+      size_type slot = (pos + bits_ctz_u32(hit)) & mask;
+
+      if(hash_key_equal(m->keys[slot], key))
+        return slot;
+
+      hit &= hit - 1U;
+    }
+
+    if(hash_group_match_empty(group) != 0U)
+      return m->capacity;
+
+    step += HASH_MAP_GROUP_WIDTH;
+    pos = (pos + step) & mask;
+  }
+}
+
+// first empty or deleted slot on the probe sequence of h
+
+template <typename K, typename V>
+inline
+size_type hash_map_free_slot(const hash_map<K, V>* m, u64 h) {
+  size_type mask = m->capacity - 1U;
+  size_type pos = (size_type)(h >> 7) & mask;
+  size_type step = 0U;
+
+  for(;;) {
+    u32 free_mask = hash_group_match_free(m->ctrl + pos);
+
+    if(free_mask != 0U)
+      return (pos + bits_ctz_u32(free_mask)) & mask;
+
+    step += HASH_MAP_GROUP_WIDTH;
+    pos = (pos + step) & mask;
+  }
+}
+
+// moves all entries to new storage for capacity slots
+
+template <typename K, typename V>
+inline
+void hash_map_resize(hash_map<K, V>* m, size_type capacity) {
+  hash_map<K, V> old = *m;
+
+  hash_map_alloc_slots(m, capacity);
+
+  for(size_type i = 0; i < old.capacity; ++i) {
+    if(old.ctrl[i] >= 0) {
+      u64 h = hash_key(old.keys[i]);
+      size_type slot = hash_map_free_slot(m, h);
+
+      hash_map_set_ctrl(m, slot, (i8)(h & 0x7FU));
+      m->keys[slot] = old.keys[i];
+
+      if(m->values != 0)
+        memcpy(m->values + slot, old.values + i, hash_value_size<V>());
+    }
+  }
+
+  m->count = old.count;
+  m->growth_left -= old.count;
+
+  if(old.ctrl != 0)
+    cpeak_free(m->a, old.ctrl);
+}
+
+template <typename K, typename V>
+inline
+void reserve(hash_map<K, V>* m, size_type count) {
+  size_type capacity = hash_map_capacity_for(count);
+
+  if(capacity > m->capacity)
+    hash_map_resize(m, capacity);
+}
+
+// slot for a new key with hash h, growing or dropping the tombstones when needed
+
+template <typename K, typename V>
+inline
+size_type hash_map_prepare_insert(hash_map<K, V>* m, u64 h) {
+  if(m->capacity == 0U)
+    hash_map_alloc_slots(m, HASH_MAP_MIN_CAPACITY);
+
+  size_type slot = hash_map_free_slot(m, h);
+
+  if(m->growth_left == 0U && m->ctrl[slot] == HASH_CTRL_EMPTY) {
+    // mostly tombstones: rehash in place, otherwise double
+    if(m->count * 2U <= hash_map_max_load(m->capacity))
+      hash_map_resize(m, m->capacity);
+    else
+      hash_map_resize(m, m->capacity * 2U);
+
+    slot = hash_map_free_slot(m, h);
+  }
+
+  if(m->ctrl[slot] == HASH_CTRL_EMPTY)
+    --m->growth_left;
+
+  hash_map_set_ctrl(m, slot, (i8)(h & 0x7FU));
+  ++m->count;
+
+  return slot;
+}
+
+template <typename K, typename V>
+inline
+V* find(const hash_map<K, V>* m, K key) {
+  size_type slot = hash_map_find_slot(m, key, hash_key(key));
+
+  return (slot < m->capacity) ? m->values + slot : 0;
+}
+
+template <typename K, typename V>
+inline
+bool contains(const hash_map<K, V>* m, K key) {
+  return hash_map_find_slot(m, key, hash_key(key)) < m->capacity;
+}
+
+// value of key, inserting 'initial' first if the key isn't in the map
+
+template <typename K, typename V>
+inline
+V* find_or_insert(hash_map<K, V>* m, K key, V initial) {
+  u64 h = hash_key(key);
+  size_type slot = hash_map_find_slot(m, key, h);
+
+  if(slot < m->capacity)
+    return m->values + slot;
+
+  slot = hash_map_prepare_insert(m, h);
+  m->keys[slot] = key;
+  m->values[slot] = initial;
+
+  return m->values + slot;
+}
+
+// inserts or overwrites, returns true if the key is new
+
+template <typename K, typename V>
+inline
+bool insert(hash_map<K, V>* m, K key, V value) {
+  u64 h = hash_key(key);
+  size_type slot = hash_map_find_slot(m, key, h);
+  bool result = slot >= m->capacity;
+
+  if(result) {
+    slot = hash_map_prepare_insert(m, h);
+    m->keys[slot] = key;
+  }
+
+  m->values[slot] = value;
+
+  return result;
+}
+
+template <typename K, typename V>
+inline
+bool erase(hash_map<K, V>* m, K key) {
+  size_type slot = hash_map_find_slot(m, key, hash_key(key));
+
+  if(slot >= m->capacity)
+    return false;
+
+  hash_map_set_ctrl(m, slot, HASH_CTRL_DELETED);
+  --m->count;
+
+  return true;
+}
+
+// calls op(K key, V* value) for every entry, in slot order
+
+template <typename K, typename V, typename Op>
+inline
+void for_each(const hash_map<K, V>* m, Op op) {
+  for(size_type pos = 0; pos < m->capacity; pos += HASH_MAP_GROUP_WIDTH) {
+    u32 full = ~hash_group_match_free(m->ctrl + pos) & 0xFFFFU;
+
+    while(full != 0U) {
+      size_type slot = pos + bits_ctz_u32(full);
+
+      op(m->keys[slot], (m->values != 0) ? m->values + slot : 0);
+      full &= full - 1U;
+    }
+  }
+}
+
+//
+// bulk operations
+//
+
+template <typename K, typename V>
+inline
+void hash_map_prefetch(const hash_map<K, V>* m, u64 h) {
+#if defined(CPEAK_SSE2)
+  size_type slot = (size_type)(h >> 7) & (m->capacity - 1U);
+
+  _mm_prefetch((const char*)(m->ctrl + slot), _MM_HINT_T0);
+  _mm_prefetch((const char*)(m->keys + slot), _MM_HINT_T0);
+#endif
+}
+
+// inserts or overwrites count entries, returns the number of new keys
+
+template <typename K, typename V>
+inline
+size_type insert(hash_map<K, V>* m, const K* keys, const V* values, size_type count) {
+  size_type result = 0U;
+
+  reserve(m, m->count + count);
+
+  for(size_type i = 0; i < count; ++i) {
+    result += insert(m, keys[i], values[i]) ? 1U : 0U;
+  }
+
+  return result;
+}
+
+// out[i] = value of keys[i], or 'missing' if it isn't in the map; returns the number of keys found
+// hashes are computed and their groups prefetched HASH_MAP_BATCH keys ahead of the probes
+
+template <typename K, typename V>
+inline
+size_type find(const hash_map<K, V>* m, const K* keys, size_type count, V* out, V missing) {
+  u64 hashes[HASH_MAP_BATCH];
+  size_type result = 0U;
+
+  if(m->capacity == 0U) {
+    for(size_type i = 0; i < count; ++i)
+      out[i] = missing;
+
+    return 0U;
+  }
+
+  size_type ahead = MINIMUM(count, (size_type)HASH_MAP_BATCH);
+
+  for(size_type i = 0; i < ahead; ++i) {
+    hashes[i] = hash_key(keys[i]);
+    hash_map_prefetch(m, hashes[i]);
+  }
+
+  for(size_type i = 0; i < count; ++i) {
+    u64 h = hashes[i % HASH_MAP_BATCH];
+
+    if(i + HASH_MAP_BATCH < count) {
+      u64 next = hash_key(keys[i + HASH_MAP_BATCH]);
+
+      hashes[i % HASH_MAP_BATCH] = next;
+      hash_map_prefetch(m, next);
+    }
+
+    size_type slot = hash_map_find_slot(m, keys[i], h);
+
+    if(slot < m->capacity) {
+      out[i] = m->values[slot];
+      ++result;
+    } else {
+      out[i] = missing;
+    }
+  }
+
+  return result;
+}
+
+inline
+array_u32 find(allocator a, const hash_map<u32, u32>* m, array_u32 keys, u32 missing) {
+  array_u32 result;
+
+  result.count = keys.count;
+  result.ptr   = (u32*)cpeak_alloc(a, result.count * sizeof(u32));
+
+  find(m, keys.ptr, keys.count, result.ptr, missing);
+
+  return result;
+}
+
+//
+// the set
+//
+
+template <typename K>
+inline
+hash_set<K> make_hash_set(allocator a, size_type expected_count) {
+  hash_set<K> result;
+
+  result.map = make_hash_map<K, hash_unit>(a, expected_count);
+
+  return result;
+}
+
+template <typename K>
+inline
+hash_set<K> make_hash_set(arena ma, size_type expected_count) {
+  return make_hash_set<K>(get_arena_alloc(ma), expected_count);
+}
+
+template <typename K>
+inline
+void free_hash_set(hash_set<K>* s) {
+  free_hash_map(&s->map);
+}
+
+template <typename K>
+inline
+void clear(hash_set<K>* s) {
+  clear(&s->map);
+}
+
+template <typename K>
+inline
+void reserve(hash_set<K>* s, size_type count) {
+  reserve(&s->map, count);
+}
+
+template <typename K>
+inline
+size_type count(const hash_set<K>* s) {
+  return s->map.count;
+}
+
+template <typename K>
+inline
+bool contains(const hash_set<K>* s, K key) {
+  return contains(&s->map, key);
+}
+
+// returns true if the key is new
+
+template <typename K>
+inline
+bool insert(hash_set<K>* s, K key) {
+  u64 h = hash_key(key);
+
+  if(hash_map_find_slot(&s->map, key, h) < s->map.capacity)
+    return false;
+
+  size_type slot = hash_map_prepare_insert(&s->map, h);
+  s->map.keys[slot] = key;
+
+  return true;
+}
+
+template <typename K>
+inline
+bool erase(hash_set<K>* s, K key) {
+  return erase(&s->map, key);
+}
+
+// returns the number of new keys
+
+template <typename K>
+inline
+size_type insert(hash_set<K>* s, const K* keys, size_type count) {
+  size_type result = 0U;
+
+  reserve(&s->map, s->map.count + count);
+
+  for(size_type i = 0; i < count; ++i) {
+    result += insert(s, keys[i]) ? 1U : 0U;
+  }
+
+  return result;
+}
+
+// found[i] = 1 if keys[i] is in the set, else 0; returns the number of keys found
+
+template <typename K>
+inline
+size_type contains(const hash_set<K>* s, const K* keys, size_type count, u8* found) {
+  u64 hashes[HASH_MAP_BATCH];
+  size_type result = 0U;
+
+  for(size_type i = 0; i < count; i += HASH_MAP_BATCH) {
+    size_type n = MINIMUM(count - i, (size_type)HASH_MAP_BATCH);
+
+    for(size_type j = 0; j < n; ++j) {
+      hashes[j] = hash_key(keys[i + j]);
+
+      if(s->map.capacity != 0U)
+        hash_map_prefetch(&s->map, hashes[j]);
+    }
+
+    for(size_type j = 0; j < n; ++j) {
+      u8 hit = (hash_map_find_slot(&s->map, keys[i + j], hashes[j]) < s->map.capacity) ? 1U : 0U;
+
+      found[i + j] = hit;
+      result += hit;
+    }
+  }
+
+  return result;
+}
+
+// calls op(K key) for every key, in slot order
+
+template <typename K, typename Op>
+inline
+void for_each(const hash_set<K>* s, Op op) {
+  for_each(&s->map, [&op](K key, hash_unit*) { op(key); });
+}
+
+#endif
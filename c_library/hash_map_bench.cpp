@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+
+#include "alloc.h"
+#include "arena.h"
+#include "array_u32.h"
+#include "array_u32_generate.h"
+#include "hash_map.h"
+
+// hash_map against std::unordered_map: inserts, lookups (half of them misses),
+// bulk lookups and string keys; prints ns per operation
+
+inline
+f64 elapsed_ns(std::chrono::steady_clock::time_point start) {
+  return (f64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void bench_u32(arena ma, size_type count) {
+  allocator a = get_arena_alloc(ma);
+
+  u32* keys    = random_u32(a, count, 1U).ptr;
+  u32* queries = random_u32(a, count, 2U).ptr;
+  u32* picks   = random_below(a, count, (u32)count, 3U).ptr;
+  u32* out     = (u32*)arena_alloc(ma, count * sizeof(u32));
+  u32* out_std = (u32*)arena_alloc(ma, count * sizeof(u32));
+
+  // every other query is a key, the rest are most likely misses
+  for(size_type i = 1; i < count; i += 2U)
+    queries[i] = keys[picks[i]];
+
+  arena_push(ma);
+
+  auto start = std::chrono::steady_clock::now();
+  hash_map<u32, u32> m = make_hash_map<u32, u32>(ma, count);
+
+  for(size_type i = 0; i < count; ++i)
+    insert(&m, keys[i], (u32)i);
+
+  f64 map_insert = elapsed_ns(start);
+
+  start = std::chrono::steady_clock::now();
+
+  for(size_type i = 0; i < count; ++i) {
+    u32* v = find(&m, queries[i]);
+    out[i] = (v != 0) ? *v : 1U;
+  }
+
+  f64 map_find = elapsed_ns(start);
+  u64 check_map = 0U;
+
+  for(size_type i = 0; i < count; ++i)
+    check_map += out[i];
+
+  start = std::chrono::steady_clock::now();
+  find(&m, queries, count, out, 1U);
+
+  f64 map_bulk = elapsed_ns(start);
+
+  arena_pop(ma);
+
+  start = std::chrono::steady_clock::now();
+  std::unordered_map<u32, u32> s;
+  s.reserve(count);
+
+  for(size_type i = 0; i < count; ++i)
+    s[keys[i]] = (u32)i;
+
+  f64 std_insert = elapsed_ns(start);
+
+  start = std::chrono::steady_clock::now();
+
+  for(size_type i = 0; i < count; ++i) {
+    auto it = s.find(queries[i]);
+    out_std[i] = (it != s.end()) ? it->second : 1U;
+  }
+
+  f64 std_find = elapsed_ns(start);
+
+  u64 check_std = 0U;
+  u64 check_bulk = 0U;
+
+  for(size_type i = 0; i < count; ++i) {
+    check_std += out_std[i];
+    check_bulk += out[i];
+  }
+
+  printf("u32 x %u: insert %.1f vs %.1f ns, find %.1f vs %.1f ns, bulk find %.1f ns (%s)\n",
+         (u32)count, map_insert / count, std_insert / count, map_find / count, std_find / count, map_bulk / count,
+         (check_map == check_std && check_bulk == check_std) ? "ok" : "MISMATCH");
+}
+
+void bench_string(arena ma, size_type count) {
+  u32* picks = random_below(get_arena_alloc(ma), count, 4096U, 4U).ptr;
+  char* chars = (char*)arena_alloc(ma, count * 24U);
+  string_slice* words = (string_slice*)arena_alloc(ma, count * sizeof(string_slice));
+
+  // identifier-like words, a few thousand distinct ones
+  for(size_type i = 0; i < count; ++i) {
+    char* w = chars + i * 24U;
+    int length = snprintf(w, 24U, "name_%u", picks[i]);
+
+    words[i].ptr = w;
+    words[i].length = (size_type)length;
+  }
+
+  arena_push(ma);
+
+  auto start = std::chrono::steady_clock::now();
+  hash_map<string_slice, u32> m = make_hash_map<string_slice, u32>(ma, 4096U);
+
+  for(size_type i = 0; i < count; ++i)
+    ++*find_or_insert(&m, words[i], 0U);
+
+  f64 map_count = elapsed_ns(start);
+  size_type map_distinct = m.count;
+
+  arena_pop(ma);
+
+  start = std::chrono::steady_clock::now();
+  std::unordered_map<std::string, u32> s;
+  s.reserve(4096U);
+
+  for(size_type i = 0; i < count; ++i)
+    ++s[std::string(words[i].ptr, words[i].length)];
+
+  f64 std_count = elapsed_ns(start);
+
+  printf("string x %u: count words %.1f vs %.1f ns (%s)\n",
+         (u32)count, map_count / count, std_count / count, (map_distinct == s.size()) ? "ok" : "MISMATCH");
+}
+
+int main(int argc, char** argv) {
+  arena ma = make_system_arena(1024U * 1024U * 1024U);
+
+  size_type sizes[] = { 1000U, 100000U, 10000000U };
+
+  for(size_type i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+    arena_push(ma);
+    bench_u32(ma, sizes[i]);
+    arena_pop(ma);
+  }
+
+  arena_push(ma);
+  bench_string(ma, 1000000U);
+  arena_pop(ma);
+
+  free_system_arena(ma);
+
+  return 0;
+}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "arena.h"
+#include "array_u32.h"
+#include "array_u32_generate.h"
+#include "hash_map.h"
+
+// the map and the set against flat arrays indexed by key, through growth,
+// erases and tombstone reuse, with u32, u64 and string_slice keys
+
+#define KEY_RANGE 20000U
+
+int main(int argc, char** argv) {
+  allocator ai = std_alloc;
+
+  // inserts, overwrites and erases of random keys, checked against present[]/expected[]
+
+  hash_map<u32, u32> m = make_hash_map<u32, u32>(ai, 0U);
+  u8* present = (u8*)calloc(KEY_RANGE, 1U);
+  u32* expected = (u32*)calloc(KEY_RANGE, sizeof(u32));
+  array_u32 ops = random_u32(ai, 200000, 7U);
+  size_type live = 0U;
+  bool results = true;
+
+  for(size_type i = 0; i < ops.count; ++i) {
+    u32 key = (ops.ptr[i] >> 8) % KEY_RANGE;
+
+    if((ops.ptr[i] & 3U) == 0U) {
+      results = results && erase(&m, key) == (present[key] != 0U);
+      live -= present[key];
+      present[key] = 0U;
+    } else {
+      results = results && insert(&m, key, (u32)i) == (present[key] == 0U);
+      live += 1U - present[key];
+      present[key] = 1U;
+      expected[key] = (u32)i;
+    }
+  }
+
+  bool lookups = m.count == live;
+
+  for(u32 key = 0U; lookups && key < KEY_RANGE; ++key) {
+    u32* v = find(&m, key);
+
+    lookups = contains(&m, key) == (present[key] != 0U) && (v == 0 || *v == expected[key]) && (v != 0) == (present[key] != 0U);
+  }
+
+  size_type visited = 0U;
+  bool entries = true;
+
+  for_each(&m, [&](u32 key, u32* v) {
+    entries = entries && present[key] != 0U && *v == expected[key];
+    ++visited;
+  });
+
+  printf("random ops: results %d, lookups %d, for_each %d (%u of %u)\n", results, lookups, entries && visited == live,
+         (u32)visited, (u32)live);
+
+  // bulk lookups, keys past the range are missing
+
+  array_u32 keys = random_below(ai, 5000, 2U * KEY_RANGE, 8U);
+  array_u32 found = find(ai, &m, keys, 0xFFFFFFFFU);
+  bool bulk = true;
+
+  for(size_type i = 0; i < keys.count; ++i) {
+    u32 key = keys.ptr[i];
+
+    bulk = bulk && found.ptr[i] == ((key < KEY_RANGE && present[key]) ? expected[key] : 0xFFFFFFFFU);
+  }
+
+  printf("bulk find: %d\n", bulk);
+
+  // churn at a fixed live count reuses the tombstones, the table doubles at
+  // most once (100 live keys are too many to rehash 128 slots in place)
+
+  hash_map<u32, u32> churn = make_hash_map<u32, u32>(ai, 100U);
+  size_type churn_capacity = churn.capacity;
+  bool churned = true;
+
+  for(u32 i = 0U; i < 100U; ++i)
+    insert(&churn, i, i);
+
+  for(u32 i = 100U; i < 100000U; ++i) {
+    churned = churned && erase(&churn, i - 100U) && insert(&churn, i, i);
+  }
+
+  for(u32 i = 0U; churned && i < 100000U; ++i)
+    churned = contains(&churn, i) == (i >= 99900U);
+
+  churned = churned && churn.capacity <= 2U * churn_capacity;
+
+  printf("churn: %d, count %u, capacity %u -> %u\n", churned, (u32)churn.count, (u32)churn_capacity, (u32)churn.capacity);
+
+  // growth from empty, one insert at a time, in an arena
+
+  arena a = make_system_arena(64U * 1024U * 1024U);
+  hash_map<u64, u32> grown = make_hash_map<u64, u32>(a, 0U);
+  bool growth = true;
+
+  for(u32 i = 0U; i < 300000U; ++i)
+    insert(&grown, (u64)i << 32 | i, i);
+
+  for(u32 i = 0U; growth && i < 300000U; ++i) {
+    u32* v = find(&grown, (u64)i << 32 | i);
+
+    growth = v != 0 && *v == i && (i == 0U || !contains(&grown, (u64)i));
+  }
+
+  printf("growth: %d, count %u, capacity %u\n", growth && grown.count == 300000U, (u32)grown.count, (u32)grown.capacity);
+  free_system_arena(a);
+
+  // string_slice keys compare by contents, not by pointer
+
+  char names[1000][16];
+  hash_map<string_slice, u32> words = make_hash_map<string_slice, u32>(ai, 0U);
+  bool strings = true;
+
+  for(u32 i = 0U; i < 1000U; ++i) {
+    snprintf(names[i], sizeof(names[i]), "word_%u", i * 7U);
+    insert(&words, make_string_slice(names[i]), i);
+  }
+
+  for(u32 i = 0U; strings && i < 1000U; ++i) {
+    char copy[16];
+
+    snprintf(copy, sizeof(copy), "word_%u", i * 7U);
+
+    u32* v = find(&words, make_string_slice(copy));
+    strings = v != 0 && *v == i;
+  }
+
+  strings = strings && !contains(&words, make_string_slice("word_1")) && !contains(&words, make_string_slice("word_"));
+  strings = strings && erase(&words, make_string_slice("word_7")) && !contains(&words, make_string_slice("word_7")) && words.count == 999U;
+  strings = strings && *find_or_insert(&words, make_string_slice("word_7"), 5U) == 5U && *find_or_insert(&words, make_string_slice("word_7"), 6U) == 5U;
+
+  printf("string_slice keys: %d\n", strings);
+
+  // the set, with bulk contains
+
+  hash_set<u32> s = make_hash_set<u32>(ai, 0U);
+  array_u32 evens = mul(ai, iota_u32(ai, 10000), 2U);
+  bool set = insert(&s, evens.ptr, evens.count) == 10000U && insert(&s, evens.ptr, evens.count) == 0U && count(&s) == 10000U;
+
+  set = set && erase(&s, 2U) && !erase(&s, 2U) && !erase(&s, 3U) && insert(&s, 2U) && !insert(&s, 2U);
+
+  array_u32 probes = iota_u32(ai, 20000);
+  u8* hits = (u8*)malloc(probes.count);
+  size_type hit_count = contains(&s, probes.ptr, probes.count, hits);
+
+  for(size_type i = 0; i < probes.count; ++i)
+    set = set && hits[i] == (u8)((i & 1U) == 0U);
+
+  printf("set: %d, hits %u\n", set && hit_count == 10000U, (u32)hit_count);
+
+  clear(&m);
+  printf("clear: %d\n", m.count == 0U && !contains(&m, keys.ptr[0]) && insert(&m, 1U, 1U) && *find(&m, 1U) == 1U);
+
+  free(hits);
+  free(expected);
+  free(present);
+
+  return 0;
+}
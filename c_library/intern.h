@@ -0,0 +1,349 @@
+/**
+ *  intern.h
+ *
+ *  String interning: every distinct string gets a u32 symbol id, so names
+ *  compare by id and each one is stored once.
+ *
+ *  An interner is an open-addressing table with linear probing. A slot is a
+ *  u64 holding the 32-bit hash of the string in its high half and the
+ *  symbol + 1 in its low half (0 is an empty slot), so a probe compares the
+ *  hash before touching the string. The table is kept at most half full.
+ *  The strings are copied into the interner's arena with a terminating
+ *  null, ids are dense from 0 and index the strings array. Growing leaves
+ *  the old tables in the arena.
+ *
+ *  An interner made with a grow_size doesn't assert when its arena is full
+ *  but moves on to a system arena of grow_size bytes (doubling every time),
+ *  the full ones stay alive for the strings in them and are released by
+ *  free_interner_arenas. Without one the arena has to hold all tables and
+ *  strings, about INTERN_BYTES_PER_SYMBOL + the string length per symbol.
+ *
+ *  A sharded_interner is the thread-safe variant: INTERN_SHARD_COUNT
+ *  interners, each with its own growable arena and mutex, picked by the top
+ *  bits of the hash. Threads interning different names mostly take
+ *  different locks. Its ids encode the shard in their low bits, so they are
+ *  unique but not dense.
+ *
+ *  The lexer hashes identifiers while their bytes are still in cache and
+ *  passes the hash in (intern(names, str, length, hash)).
+ */
+
+#ifndef CPEAK_INTERN_H
+#define CPEAK_INTERN_H
+
+#include <assert.h>
+#include <string.h>
+#include <new>
+#include <mutex>
+#include "types.h"
+#include "macro.h"
+#include "arena.h"
+
+#define INTERN_NONE        0xFFFFFFFFU // symbol of a token that isn't an identifier
+#define INTERN_MIN_SLOTS   64U
+#define INTERN_SHARD_BITS  4U
+#define INTERN_SHARD_COUNT (1U << INTERN_SHARD_BITS)
+
+// the tables with all their generations: a slot pair and a string_slice per
+// symbol, doubled for the old tables left behind by growing
+#define INTERN_BYTES_PER_SYMBOL (2U * (2U * sizeof(u64) + sizeof(string_slice)))
+
+typedef struct interner {
+  arena         ma;
+  arena         grown;      // newest system arena moved on to, each one links to the previous, 0 for none
+  usize         grow_size;  // size of the next system arena, 0 when ma is fixed
+  u64*          slots;      // hash << 32 | (symbol + 1), 0 for an empty slot
+  string_slice* strings;    // by symbol
+  u32           count;
+  u32           capacity;   // of strings
+  u32           slot_count; // power of 2
+} interner;
+
+typedef struct sharded_interner {
+  interner   shards[INTERN_SHARD_COUNT];
+  std::mutex locks[INTERN_SHARD_COUNT];
+} sharded_interner;
+
+// the word-at-a-time hash of hash_key(string_slice) in hash_map.h with a 32-bit finish
+
+inline
+u32 intern_hash(cstring str, u32 length) {
+  const u8* p = (const u8*)str;
+  u64 h = 0x9E3779B97F4A7C15ULL ^ ((u64)length * 0xC2B2AE3D27D4EB4FULL);
+  u32 i = 0U;
+
+  for(; i + 8U <= length; i += 8U) {
+    u64 w;
+
+    memcpy(&w, p + i, 8U);
+    h = (h ^ w) * 0x9FB21C651E98DF25ULL;
+    h ^= h >> 29;
+  }
+
+  if(i < length) {
+    u64 w = 0U;
+
+    memcpy(&w, p + i, length - i);
+    h = (h ^ w) * 0x9FB21C651E98DF25ULL;
+  }
+
+  h ^= h >> 32;
+  h *= 0xD6E8FEB86659FD93ULL;
+  h ^= h >> 32;
+
+  return (u32)h;
+}
+
+// bytes of the tables for slot_count slots, with the alignment of both
+
+inline
+usize interner_table_bytes(u32 slot_count) {
+  return slot_count * sizeof(u64) + (slot_count / 2U) * sizeof(string_slice) + 32U;
+}
+
+// the link to the previous system arena, the first allocation in a system
+// arena (where arena_init puts the tail)
+
+inline
+arena* interner_arena_link(arena a) {
+  usize ptr_int = (usize)a;
+
+  return (arena*)((u8*)a + (ALIGN_USIZE_16(ptr_int + sizeof(arena_head)) - ptr_int));
+}
+
+// makes room for size bytes, moving on to a new system arena when growable
+
+inline
+void interner_reserve(interner* names, usize size) {
+  if(names->grow_size == 0U || names->ma->size - names->ma->tail >= size)
+    return;
+
+  usize arena_size = names->grow_size;
+
+  while(arena_size < size + 64U)
+    arena_size *= 2U;
+
+  arena next = make_system_arena(arena_size);
+
+  arena_alloc(next, sizeof(arena));
+  *interner_arena_link(next) = names->grown;
+
+  names->ma        = next;
+  names->grown     = next;
+  names->grow_size = 2U * arena_size;
+}
+
+inline
+interner make_interner(arena ma, u32 expected_count, usize grow_size) {
+  interner result;
+  u32 slot_count = INTERN_MIN_SLOTS;
+
+  while(slot_count / 2U < expected_count)
+    slot_count *= 2U;
+
+  result.ma        = ma;
+  result.grown     = 0;
+  result.grow_size = grow_size;
+
+  interner_reserve(&result, interner_table_bytes(slot_count));
+
+  result.slots      = (u64*)arena_alloc(result.ma, slot_count * sizeof(u64));
+  result.capacity   = slot_count / 2U;
+  result.strings    = (string_slice*)arena_alloc(result.ma, result.capacity * sizeof(string_slice));
+  result.count      = 0U;
+  result.slot_count = slot_count;
+
+  memset(result.slots, 0, slot_count * sizeof(u64));
+
+  return result;
+}
+
+inline
+interner make_interner(arena ma, u32 expected_count) {
+  return make_interner(ma, expected_count, 0U);
+}
+
+// releases the system arenas a growable interner moved on to, ma itself belongs to the caller
+
+inline
+void free_interner_arenas(interner* names) {
+  arena a = names->grown;
+
+  while(a) {
+    arena previous = *interner_arena_link(a);
+
+    free_system_arena(a);
+    a = previous;
+  }
+
+  names->grown = 0;
+}
+
+inline
+void interner_grow(interner* names) {
+  u32 slot_count = 2U * names->slot_count;
+
+  interner_reserve(names, interner_table_bytes(slot_count));
+
+  u64* slots = (u64*)arena_alloc(names->ma, slot_count * sizeof(u64));
+  string_slice* strings = (string_slice*)arena_alloc(names->ma, (slot_count / 2U) * sizeof(string_slice));
+
+  memset(slots, 0, slot_count * sizeof(u64));
+  memcpy(strings, names->strings, names->count * sizeof(string_slice));
+
+  for(u32 i = 0U; i < names->slot_count; ++i) {
+    u64 entry = names->slots[i];
+
+    if(entry == 0U)
+      continue;
+
+    u32 slot = (u32)(entry >> 32) & (slot_count - 1U);
+
+    while(slots[slot] != 0U)
+      slot = (slot + 1U) & (slot_count - 1U);
+
+    slots[slot] = entry;
+  }
+
+  names->slots      = slots;
+  names->strings    = strings;
+  names->capacity   = slot_count / 2U;
+  names->slot_count = slot_count;
+}
+
+// symbol of the string, interning a copy of it when it's new
+
+inline
+u32 intern(interner* names, cstring str, u32 length, u32 hash) {
+  u32 mask = names->slot_count - 1U;
+  u32 slot = hash & mask;
+
+  for(;;) {
+    u64 entry = names->slots[slot];
+
+    if(entry == 0U)
+      break;
+
+    if((u32)(entry >> 32) == hash) {
+      string_slice s = names->strings[(u32)entry - 1U];
+
+      if(s.length == length && memcmp(s.ptr, str, length) == 0)
+        return (u32)entry - 1U;
+    }
+
+    slot = (slot + 1U) & mask;
+  }
+
+  u32 result = names->count;
+
+  if(result == names->capacity) {
+    interner_grow(names);
+
+    mask = names->slot_count - 1U;
+    slot = hash & mask;
+
+    while(names->slots[slot] != 0U)
+      slot = (slot + 1U) & mask;
+  }
+
+  // packed, but rounded up to 8 bytes to keep the arena's tail aligned for the tables
+
+  interner_reserve(names, (length + 8U) & ~7U);
+
+  char* copy = (char*)arena_alloc_packed(names->ma, (length + 8U) & ~7U);
+
+  memcpy(copy, str, length);
+  copy[length] = 0;
+
+  names->strings[result].ptr    = copy;
+  names->strings[result].length = length;
+  names->slots[slot] = ((u64)hash << 32) | (u64)(result + 1U);
+  names->count = result + 1U;
+
+  return result;
+}
+
+inline
+u32 intern(interner* names, cstring str, u32 length) {
+  return intern(names, str, length, intern_hash(str, length));
+}
+
+inline
+u32 intern(interner* names, cstring str) {
+  return intern(names, str, (u32)strlen(str));
+}
+
+inline
+string_slice intern_string(const interner* names, u32 symbol) {
+  assert(symbol < names->count);
+
+  return names->strings[symbol];
+}
+
+//
+// the sharded variant
+//
+
+// every shard starts in an arena of shard_arena_size bytes from ma and
+// grows into system arenas past it, free_sharded_interner releases those
+
+inline
+sharded_interner* make_sharded_interner(arena ma, usize shard_arena_size, u32 expected_count) {
+  sharded_interner* result = new (arena_alloc(ma, sizeof(sharded_interner))) sharded_interner;
+
+  for(u32 s = 0U; s < INTERN_SHARD_COUNT; ++s)
+    result->shards[s] = make_interner(make_arena(ma, shard_arena_size), expected_count / INTERN_SHARD_COUNT, 2U * shard_arena_size);
+
+  return result;
+}
+
+inline
+void free_sharded_interner(sharded_interner* names) {
+  for(u32 s = 0U; s < INTERN_SHARD_COUNT; ++s)
+    free_interner_arenas(&names->shards[s]);
+
+  names->~sharded_interner();
+}
+
+inline
+u32 intern_shard(u32 hash) {
+  return hash >> (32U - INTERN_SHARD_BITS);
+}
+
+inline
+u32 intern(sharded_interner* names, cstring str, u32 length, u32 hash) {
+  u32 shard = intern_shard(hash);
+  u32 symbol;
+
+  {
+    std::lock_guard<std::mutex> lock(names->locks[shard]);
+    symbol = intern(&names->shards[shard], str, length, hash);
+  }
+
+  return (symbol << INTERN_SHARD_BITS) | shard;
+}
+
+inline
+u32 intern(sharded_interner* names, cstring str, u32 length) {
+  return intern(names, str, length, intern_hash(str, length));
+}
+
+inline
+string_slice intern_string(sharded_interner* names, u32 symbol) {
+  u32 shard = symbol & (INTERN_SHARD_COUNT - 1U);
+  std::lock_guard<std::mutex> lock(names->locks[shard]);
+
+  return intern_string(&names->shards[shard], symbol >> INTERN_SHARD_BITS);
+}
+
+inline
+u32 symbol_count(const sharded_interner* names) {
+  u32 result = 0U;
+
+  for(u32 s = 0U; s < INTERN_SHARD_COUNT; ++s)
+    result += names->shards[s].count;
+
+  return result;
+}
+
+#endif
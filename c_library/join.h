@@ -0,0 +1,435 @@
+/**
+ *  join.h
+ *
+ *  Equi-joins of two u32 key columns.
+ *
+ *  Both joins emit the matching row index pairs as two parallel arrays:
+ *  left.keys[result.left_rows[i]] == right.keys[result.right_rows[i]].
+ *
+ *  hash_join  - radix-partitioned hash join. Both sides are partitioned on
+ *               the high bits of a hash of the key so that the hash table
+ *               of one build partition fits in cache, then every partition
+ *               is built and probed on its own (linear probing, 8 slots per
+ *               step with AVX2). The left side is the build side.
+ *  merge_join - for inputs sorted by key, every run of equal keys produces
+ *               the cross product of its rows.
+ *
+ *  Partitions and merge ranges are spread over threads. Output sizes are
+ *  found with a counting pass first so that the threads never allocate.
+ *  All build-side memory (partitions, hash tables, counters) comes from
+ *  the 'build' arena, so it is released with a single pop or reset; the
+ *  result arrays come from the allocator.
+ */
+
+#ifndef CPEAK_JOIN_H
+#define CPEAK_JOIN_H
+
+#include <assert.h>
+#include <string.h>
+#include "types.h"
+#include "macro.h"
+#include "alloc.h"
+#include "arena.h"
+#include "bits.h"
+#include "simd.h"
+#include "parallel.h"
+#include "array_u32.h"
+
+#define JOIN_PARTITION_TUPLES  (16U * 1024U) // build tuples per partition, table ~256 KB
+#define JOIN_MAX_PARTITION_BITS 10U
+#define JOIN_MIN_PER_THREAD    (16U * 1024U)
+#define JOIN_EMPTY_ROW         0xFFFFFFFFU
+
+typedef struct join_result {
+  array_u32 left_rows;
+  array_u32 right_rows;
+} join_result;
+
+inline
+u32 join_partition_hash(u32 key) {
+  return key * 0x9E3779B1U;
+}
+
+// a second, independent hash for the slot within a partition table
+
+inline
+u32 join_slot_hash(u32 key) {
+  return key * 0x85EBCA77U;
+}
+
+inline
+join_result make_join_result(allocator a, size_type count) {
+  join_result result;
+
+  result.left_rows.ptr    = (u32*)cpeak_alloc(a, count * sizeof(u32));
+  result.left_rows.count  = count;
+  result.right_rows.ptr   = (u32*)cpeak_alloc(a, count * sizeof(u32));
+  result.right_rows.count = count;
+
+  return result;
+}
+
+//
+// parallel radix partitioning of (key, row) on the top 'bits' of the partition hash
+//
+
+typedef struct join_partitions {
+  u32* keys;
+  u32* rows;
+  u32* offsets; // partition_count + 1 entries
+  u32  bits;
+} join_partitions;
+
+inline
+u32 join_partition_of(u32 key, u32 bits) {
+  return (bits == 0U) ? 0U : (join_partition_hash(key) >> (32U - bits));
+}
+
+inline
+join_partitions join_partition(arena build, array_u32 keys, u32 bits, u32 thread_count) {
+  join_partitions result;
+  u32 partition_count = 1U << bits;
+
+  result.bits    = bits;
+  result.keys    = (u32*)arena_alloc(build, keys.count * sizeof(u32));
+  result.rows    = (u32*)arena_alloc(build, keys.count * sizeof(u32));
+  result.offsets = (u32*)arena_alloc(build, (partition_count + 1U) * sizeof(u32));
+
+  thread_count = parallel_thread_count_for(keys.count, thread_count, JOIN_MIN_PER_THREAD);
+
+  // cursors[t * partition_count + p]: histogram, then write cursor of thread t in partition p
+
+  u32* cursors = (u32*)arena_alloc(build, thread_count * partition_count * sizeof(u32));
+
+  parallel_for_ranges(thread_count, keys.count, [&](u32 t, size_type begin, size_type end) {
+    u32* hist = cursors + t * partition_count;
+
+    memset(hist, 0, partition_count * sizeof(u32));
+
+    for(size_type i = begin; i < end; ++i) {
+      ++hist[join_partition_of(keys.ptr[i], bits)];
+    }
+  });
+
+  u32 running = 0U;
+
+  for(u32 p = 0U; p < partition_count; ++p) {
+    result.offsets[p] = running;
+
+    for(u32 t = 0U; t < thread_count; ++t) {
+      u32 n = cursors[t * partition_count + p];
+
+      cursors[t * partition_count + p] = running;
+      running += n;
+    }
+  }
+
+  result.offsets[partition_count] = running;
+
+  parallel_for_ranges(thread_count, keys.count, [&](u32 t, size_type begin, size_type end) {
+    u32* cursor = cursors + t * partition_count;
+
+    for(size_type i = begin; i < end; ++i) {
+      u32 key = keys.ptr[i];
+      u32 dest = cursor[join_partition_of(key, bits)]++;
+
+      result.keys[dest] = key;
+      result.rows[dest] = (u32)i;
+    }
+  });
+
+  return result;
+}
+
+//
+// per-partition hash table: keys and rows in parallel arrays, an empty slot has row JOIN_EMPTY_ROW
+//
+
+typedef struct join_table {
+  u32* keys;
+  u32* rows;
+  u32  bits;
+} join_table;
+
+inline
+void join_table_build(join_table* jt, const u32* keys, const u32* rows, u32 count) {
+  u32 capacity = 1U << jt->bits;
+  u32 mask = capacity - 1U;
+
+  memset(jt->rows, 0xFF, capacity * sizeof(u32));
+
+  for(u32 i = 0U; i < count; ++i) {
+    u32 slot = join_slot_hash(keys[i]) >> (32U - jt->bits);
+
+    while(jt->rows[slot] != JOIN_EMPTY_ROW) {
+      slot = (slot + 1U) & mask;
+    }
+
+    jt->keys[slot] = keys[i];
+    jt->rows[slot] = rows[i];
+  }
+}
+
+// calls emit(build_row) for every build tuple with the given key, returns the match count
+
+template <typename Emit>
+inline
+u32 join_table_probe(const join_table* jt, u32 key, Emit emit) {
+  u32 capacity = 1U << jt->bits;
+  u32 mask = capacity - 1U;
+  u32 slot = join_slot_hash(key) >> (32U - jt->bits);
+  u32 matches = 0U;
+
+#if defined(CPEAK_AVX2)
+  __m256i key_v   = _mm256_set1_epi32((int)key);
+  __m256i empty_v = _mm256_set1_epi32((int)JOIN_EMPTY_ROW);
+
+  // 8 slots per step while the window doesn't wrap around
+
+  while(slot + 8U <= capacity) {
+    __m256i keys_v = _mm256_loadu_si256((const __m256i*)(jt->keys + slot));
+    __m256i rows_v = _mm256_loadu_si256((const __m256i*)(jt->rows + slot));
+
+    u32 empty = (u32)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(rows_v, empty_v)));
+    u32 hit   = (u32)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(keys_v, key_v)));
+
+    // only the slots before the first empty one belong to the probe sequence
+    u32 valid = (empty != 0U) ? ((1U << bits_ctz_u32(empty)) - 1U) : 0xFFU;
+    hit &= valid & ~empty;
+
+    while(hit != 0U) {
+      emit(jt->rows[slot + bits_ctz_u32(hit)]);
+      ++matches;
+      hit &= hit - 1U;
+    }
+
+    if(empty != 0U)
+      return matches;
+
+    slot += 8U;
+  }
+
+  slot &= mask;
+#endif
+
+  while(jt->rows[slot] != JOIN_EMPTY_ROW) {
+    if(jt->keys[slot] == key) {
+      emit(jt->rows[slot]);
+      ++matches;
+    }
+
+    slot = (slot + 1U) & mask;
+  }
+
+  return matches;
+}
+
+//
+// hash join
+//
+
+inline
+join_result hash_join(arena build, allocator a, array_u32 left, array_u32 right, u32 thread_count) {
+  // partition bits: enough partitions for each build partition to fit in cache
+
+  u32 bits = 0U;
+
+  while(bits < JOIN_MAX_PARTITION_BITS && ((u64)JOIN_PARTITION_TUPLES << bits) < (u64)left.count)
+    ++bits;
+
+  u32 partition_count = 1U << bits;
+
+  join_partitions lp = join_partition(build, left, bits, thread_count);
+  join_partitions rp = join_partition(build, right, bits, thread_count);
+
+  // hash table space of every partition, at most half full
+
+  u32* table_offsets = (u32*)arena_alloc(build, (partition_count + 1U) * sizeof(u32));
+  u8*  table_bits    = (u8*)arena_alloc(build, partition_count * sizeof(u8));
+  u32* match_counts  = (u32*)arena_alloc(build, (partition_count + 1U) * sizeof(u32));
+
+  u32 table_total = 0U;
+
+  for(u32 p = 0U; p < partition_count; ++p) {
+    u32 n = lp.offsets[p + 1U] - lp.offsets[p];
+    u32 tb = MAXIMUM(bits_width_u32(2U * n), 3U);
+
+    table_offsets[p] = table_total;
+    table_bits[p] = (u8)tb;
+    table_total += 1U << tb;
+  }
+
+  u32* table_keys = (u32*)arena_alloc(build, table_total * sizeof(u32));
+  u32* table_rows = (u32*)arena_alloc(build, table_total * sizeof(u32));
+
+  u32 part_threads = parallel_thread_count_for(partition_count, thread_count, 1U);
+
+  // pass 1: build every partition table and count the matches
+
+  parallel_for_morsels(part_threads, partition_count, 1U, [&](u32, size_type p, size_type) {
+    join_table jt = { table_keys + table_offsets[p], table_rows + table_offsets[p], table_bits[p] };
+    u32 first = lp.offsets[p];
+
+    join_table_build(&jt, lp.keys + first, lp.rows + first, lp.offsets[p + 1U] - first);
+
+    u32 count = 0U;
+
+    for(u32 i = rp.offsets[p]; i < rp.offsets[p + 1U]; ++i) {
+      count += join_table_probe(&jt, rp.keys[i], [](u32) {});
+    }
+
+    match_counts[p] = count;
+  });
+
+  u64 total = 0U;
+
+  for(u32 p = 0U; p < partition_count; ++p) {
+    u32 n = match_counts[p];
+
+    match_counts[p] = (u32)total;
+    total += n;
+  }
+
+  assert(total <= (u64)0xFFFFFFFFU);
+
+  join_result result = make_join_result(a, (size_type)total);
+
+  // pass 2: probe again and write the pairs of every partition at its offset
+
+  parallel_for_morsels(part_threads, partition_count, 1U, [&](u32, size_type p, size_type) {
+    join_table jt = { table_keys + table_offsets[p], table_rows + table_offsets[p], table_bits[p] };
+    u32 out = match_counts[p];
+
+    for(u32 i = rp.offsets[p]; i < rp.offsets[p + 1U]; ++i) {
+      u32 probe_row = rp.rows[i];
+
+      join_table_probe(&jt, rp.keys[i], [&](u32 build_row) {
+        result.left_rows.ptr[out]  = build_row;
+        result.right_rows.ptr[out] = probe_row;
+        ++out;
+      });
+    }
+  });
+
+  return result;
+}
+
+//
+// merge join
+//
+
+// first index in [begin, end) with x[index] >= key
+
+inline
+size_type join_lower_bound(const u32* x, size_type begin, size_type end, u32 key) {
+  while(begin < end) {
+    size_type mid = begin + (end - begin) / 2U;
+
+    if(x[mid] < key)
+      begin = mid + 1U;
+    else
+      end = mid;
+  }
+
+  return begin;
+}
+
+// calls emit(left_row, right_row) for every match of the sorted ranges, returns the match count
+
+template <typename Emit>
+inline
+u64 merge_join_range(array_u32 left, size_type l, size_type l_end, array_u32 right, size_type r, size_type r_end, Emit emit) {
+  u64 matches = 0U;
+
+  while(l < l_end && r < r_end) {
+    u32 lk = left.ptr[l];
+    u32 rk = right.ptr[r];
+
+    if(lk < rk) {
+      ++l;
+    } else if(rk < lk) {
+      ++r;
+    } else {
+      size_type l_run = l;
+      size_type r_run = r;
+
+      while(l_run < l_end && left.ptr[l_run] == lk)
+        ++l_run;
+      while(r_run < r_end && right.ptr[r_run] == rk)
+        ++r_run;
+
+      for(size_type i = l; i < l_run; ++i) {
+        for(size_type j = r; j < r_run; ++j) {
+          emit((u32)i, (u32)j);
+        }
+      }
+
+      matches += (u64)(l_run - l) * (u64)(r_run - r);
+      l = l_run;
+      r = r_run;
+    }
+  }
+
+  return matches;
+}
+
+// precondition: left and right are sorted ascending
+
+inline
+join_result merge_join(allocator a, array_u32 left, array_u32 right, u32 thread_count) {
+  size_type l_begin[PARALLEL_MAX_THREADS + 1U];
+  size_type r_begin[PARALLEL_MAX_THREADS + 1U];
+  u64 offsets[PARALLEL_MAX_THREADS + 1U];
+
+  thread_count = parallel_thread_count_for(left.count, thread_count, JOIN_MIN_PER_THREAD);
+
+  // split the left side evenly, moving every split to the start of its key run,
+  // and split the right side at the same keys
+
+  l_begin[0] = 0U;
+  r_begin[0] = 0U;
+
+  for(u32 t = 1U; t < thread_count; ++t) {
+    size_type l = MAXIMUM(parallel_range_begin(left.count, thread_count, t), l_begin[t - 1U]);
+
+    if(l < left.count)
+      l = join_lower_bound(left.ptr, l_begin[t - 1U], l + 1U, left.ptr[l]);
+
+    l_begin[t] = l;
+    r_begin[t] = (l < left.count) ? join_lower_bound(right.ptr, r_begin[t - 1U], right.count, left.ptr[l]) : right.count;
+  }
+
+  l_begin[thread_count] = left.count;
+  r_begin[thread_count] = right.count;
+
+  parallel_run(thread_count, [&](u32 t) {
+    offsets[t] = merge_join_range(left, l_begin[t], l_begin[t + 1U], right, r_begin[t], r_begin[t + 1U], [](u32, u32) {});
+  });
+
+  u64 total = 0U;
+
+  for(u32 t = 0U; t < thread_count; ++t) {
+    u64 n = offsets[t];
+
+    offsets[t] = total;
+    total += n;
+  }
+
+  assert(total <= (u64)0xFFFFFFFFU);
+
+  join_result result = make_join_result(a, (size_type)total);
+
+  parallel_run(thread_count, [&](u32 t) {
+    u64 out = offsets[t];
+
+    merge_join_range(left, l_begin[t], l_begin[t + 1U], right, r_begin[t], r_begin[t + 1U], [&](u32 i, u32 j) {
+      result.left_rows.ptr[out]  = i;
+      result.right_rows.ptr[out] = j;
+      ++out;
+    });
+  });
+
+  return result;
+}
+
+#endif
@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "arena.h"
+#include "array_u32.h"
+#include "join.h"
+
+int main(int argc, char** argv) {
+  arena a = make_system_arena(256U * 1024U * 1024U);
+  arena build = make_arena(a, 128U * 1024U * 1024U);
+  allocator ai = get_arena_alloc(a);
+
+  u32 thread_count = parallel_default_thread_count();
+
+  // orders.customer joined with customers.id, about a quarter of the orders find their customer
+
+  const size_type customer_count = 250000U;
+  const size_type order_count = 1000000U;
+
+  array_u32 customers = mul(ai, iota_u32(ai, customer_count), 3U);
+  array_u32 orders = mod(ai, mul(ai, iota_u32(ai, order_count), 2654435761U), customer_count * 4U);
+
+  join_result hj = hash_join(build, ai, customers, orders, thread_count);
+  arena_reset(build);
+
+  u32 bad = 0U;
+
+  for(size_type i = 0; i < hj.left_rows.count; ++i) {
+    if(customers.ptr[hj.left_rows.ptr[i]] != orders.ptr[hj.right_rows.ptr[i]])
+      ++bad;
+  }
+
+  printf("hash join matches: %u, mismatched pairs: %u\n", (u32)hj.left_rows.count, bad);
+
+  // the same join on sorted keys
+
+  array_u32 sorted_orders = add(ai, orders, 0U);
+
+  qsort(sorted_orders.ptr, order_count, sizeof(u32), [](const void* x, const void* y) {
+    u32 l = *(const u32*)x;
+    u32 r = *(const u32*)y;
+    return (l > r) - (l < r);
+  });
+
+  join_result mj = merge_join(ai, customers, sorted_orders, thread_count);
+
+  printf("merge join matches: %u\n", (u32)mj.left_rows.count);
+  print(take_at_most(mj.left_rows, 8));
+  printf("\n");
+  print(take_at_most(mj.right_rows, 8));
+  printf("\n");
+
+  free_system_arena(a);
+
+  return 0;
+}
@@ -5,6 +5,10 @@
 #include "types.h"
 #include "macro.h"
 #include "arena.h"
+#include "lexer_classify.h"
+#include "lexer_lines.h"
+#include "intern.h"
+#include "source_file.h"
 
 #include <stdio.h>
 
@@ -26,29 +30,33 @@ enum token_tag_enum {
   token_tag_struct = 2,
   token_tag_if = 3,
   token_tag_while = 4,
+  token_tag_import = 5,
+  token_tag_variant = 6,
+  token_tag_interface = 7,
+  token_tag_lambda = 8,
 
   // classification of non-keyword identifiers and literals
-  token_tag_identifier = 5,
-  token_tag_integer_literal = 6,
-  token_tag_hex_literal = 7,
-  token_tag_float_literal = 8,
-  token_tag_string_literal = 9,
-  token_tag_char_literal = 10,
+  token_tag_identifier = 9,
+  token_tag_integer_literal = 10,
+  token_tag_hex_literal = 11,
+  token_tag_float_literal = 12,
+  token_tag_string_literal = 13,
+  token_tag_char_literal = 14,
 
   // operators
-  token_tag_op_left_param = 11,
-  token_tag_op_right_param = 12,
-  token_tag_op_left_brace = 13,
-  token_tag_op_right_brace = 14,
-  token_tag_op_left_bracket = 15,
-  token_tag_op_right_bracket = 16,
-
-  token_tag_op_add = 17,    // +
-  token_tag_op_sub = 18,    // -
-  token_tag_op_negate = 18, // -
-  token_tag_op_mul = 19,    // *
-  token_tag_op_div = 20,    // /
-  token_tag_op_mod = 21,    // %
+  token_tag_op_left_param = 15,
+  token_tag_op_right_param = 16,
+  token_tag_op_left_brace = 17,
+  token_tag_op_right_brace = 18,
+  token_tag_op_left_bracket = 19,
+  token_tag_op_right_bracket = 20,
+
+  token_tag_op_add = 21,    // +
+  token_tag_op_sub = 22,    // -
+  token_tag_op_negate = 22, // -
+  token_tag_op_mul = 23,    // *
+  token_tag_op_div = 24,    // /
+  token_tag_op_mod = 25,    // %
 
   token_tag_op_and,         // &&
   token_tag_op_or,          // ||
@@ -78,28 +86,66 @@ enum token_tag_enum {
 
   token_tag_op_ref,             // &
   token_tag_op_deref,           // *
+
+  token_tag_op_xor,             // ^
+  token_tag_op_bit_or,          // |
+
+  token_tag_op_add_assignment,     // +=
+  token_tag_op_sub_assignment,     // -=
+  token_tag_op_mul_assignment,     // *=
+  token_tag_op_div_assignment,     // /=
+  token_tag_op_mod_assignment,     // %=
+  token_tag_op_bit_and_assignment, // &=
+  token_tag_op_bit_or_assignment,  // |=
+  token_tag_op_xor_assignment,     // ^=
 };
 
+// operator and keyword tables generated from tokens.txt by lexer_gen:
+// lexer_gen tokens.txt lexer_tables.h
+
+#include "lexer_tables.h"
+
 struct lexer_state {
   cstring str;
   u32     str_len;
   u32     pos;
-  u32     row;
-  u32     col;
 
   arena   ma;
+
+  // built by lexer_lines the first time a location is asked for
+  line_index* lines;
+
+  // identifiers are interned into one of these when it isn't null
+  interner*         names;
+  sharded_interner* shared_names;
 };
 
 struct token {
   u32 tag;
   u32 start;
   u32 length;
-  u32 row;
-  u32 col;
+  u32 symbol; // interned name of an identifier, else INTERN_NONE
 };
 
 typedef token* token_ptr;
 
+// the line index of the lexer's source, built on first use
+
+inline
+const line_index* lexer_lines(lexer_state* lex) {
+  if(lex->lines == 0) {
+    lex->lines = (line_index*)arena_alloc(lex->ma, sizeof(line_index));
+    *lex->lines = make_line_index(lex->ma, lex->str, lex->str_len);
+  }
+
+  return lex->lines;
+}
+
+inline
+source_location lexer_locate(lexer_state* lex, u32 offset) {
+  return locate(lexer_lines(lex), lex->str, offset);
+}
+
 void print_token(token_ptr tok, lexer_state* lex) {
   cstring str = lex->str;
   arena a     = lex->ma;
@@ -124,7 +170,9 @@ void print_token(token_ptr tok, lexer_state* lex) {
 
     fwrite(postamble, 1, sizeof(postamble) - 1, stdout);
 
-    sprintf(tag_buf, "L%uC%u", tok->row, tok->col);
+    source_location loc = lexer_locate(lex, tok->start);
+
+    sprintf(tag_buf, "L%uC%u", loc.row, loc.col);
     fwrite(tag_buf, 1, strlen(tag_buf), stdout);
   }
 }
@@ -147,292 +195,219 @@ lexer_state* make_lexer(arena ma, cstring str, u32 str_len) {
   result->str = str;
   result->str_len = str_len;
   result->pos = 0;
-  result->row = 1;
-  result->col = 1;
   result->ma  = ma;
+  result->lines = 0;
+  result->names = 0;
+  result->shared_names = 0;
 
   return result;
 }
 
-token_ptr lexer_enclosed_literal(lexer_state* lex, token_tag_enum tag, char terminator) {
-  token_ptr result = 0;
+inline
+lexer_state* make_lexer(arena ma, interner* names, cstring str, u32 str_len) {
+  lexer_state* result = make_lexer(ma, str, str_len);
+
+  result->names = names;
+
+  return result;
+}
+
+// lexes a source_file in place, token starts are offsets into its mapping
 
+inline
+lexer_state* make_lexer(arena ma, const source_file* file) {
+  return make_lexer(ma, file->text, file->length);
+}
+
+inline
+lexer_state* make_lexer(arena ma, interner* names, const source_file* file) {
+  return make_lexer(ma, names, file->text, file->length);
+}
+
+inline
+void lexer_enclosed_literal(lexer_state* lex, token* result, token_tag_enum tag, char terminator) {
   cstring str = lex->str;
   u32 str_len = lex->str_len;
   u32 pos = lex->pos;
-  u32 row = lex->row;
-  u32 col = lex->col;
 
   ++pos;
 
-  result = (token_ptr)arena_alloc(lex->ma, sizeof(token));  
   result->tag = tag;
   result->start = pos;
 
-  ++col;
-  
-  result->row = row;
-  result->col = col;
-
   char c = str[pos];
   bool backslash = false;
   while(pos < str_len) {
     if(backslash) {
-      ++col;
       backslash = false;
     } else {
       if(c == terminator) {
         ++pos;
-        ++col;
         break;
       }
       if(c == '\\') {
         backslash = true;
       }
     }
-    if(c == '\n') {
-      ++row;
-      col = 1;
-    }
     c = str[++pos];
   }
 
   result->length = (pos - result->start) - 1U;
 
   lex->pos = pos;
-  lex->row = row;
-  lex->col = col;
-
-  return result;
 }
 
-token_ptr lexer_hex_literal(lexer_state* lex) {
-  token_ptr result = 0;
-
+inline
+void lexer_hex_literal(lexer_state* lex, token* result) {
   cstring str = lex->str;
   u32 str_len = lex->str_len;
   u32 pos = lex->pos;
-  u32 row = lex->row;
-  u32 col = lex->col;
 
   u32 start = pos;
 
-  printf("lex hex\n");
-
-  result = (token_ptr)arena_alloc(lex->ma, sizeof(token));
   result->tag = token_tag_hex_literal;
   result->start = pos;
-  result->row = row;
-  result->col = col;
-
-  bool not_done = true;
 
-  while(pos < str_len && not_done) {
-    char c = str[pos];
-    not_done = ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'));
+  pos = lexer_scan_class(str, pos, str_len, LEXER_CLASS_HEX);
 
-    if(not_done) {
-      ++pos;
-      ++col;
-    }
-  }
-  
   result->length = pos - start;
 
   lex->pos = pos;
-  lex->col = col;
-
-  return result;
 }
 
-token_ptr lexer_numeric_literal(lexer_state* lex) {
-  token_ptr result = 0;
-
+inline
+void lexer_numeric_literal(lexer_state* lex, token* result) {
   cstring str = lex->str;
   u32 str_len = lex->str_len;
   u32 pos = lex->pos;
-  u32 row = lex->row;
-  u32 col = lex->col;
-
-  if(pos >= str_len)
-    return result;
 
   // detect special case: hex form 0x....
 
   if(pos + 2 < str_len && str[pos] == '0' && str[pos + 1] == 'x') {
-    pos += 2;
-    col += 2;
+    lex->pos = pos + 2;
 
-    lex->pos = pos;
-    lex->col = col;
-
-    result = lexer_hex_literal(lex);
+    lexer_hex_literal(lex, result);
   } else {
     u32 start = pos;
 
-    result = (token_ptr)arena_alloc(lex->ma, sizeof(token));
     result->start = pos;
-    result->row = row;
-    result->col = col;
 
-    bool not_done = true;
-    bool is_float = false;
+    pos = lexer_scan_class(str, pos, str_len, LEXER_CLASS_DIGIT);
 
-    while(pos < str_len && not_done) {
-      char c = str[pos];
+    if(pos < str_len && str[pos] == '.') {
+      pos = lexer_scan_class(str, pos + 1U, str_len, LEXER_CLASS_DIGIT);
+      result->tag = token_tag_float_literal;
+    } else {
+      result->tag = token_tag_integer_literal;
+    }
 
-      if(c >= '0' && c <= '9') {
-        ++pos;
-        ++col;
-      } else if(c == '.') {
-        ++pos;
-        ++col;
+    result->length = pos - start;
 
-        not_done = false;
-        is_float = true;
-      } else {
-        not_done = false;
-      }
-    }
+    lex->pos = pos;
+  }
+}
 
-    if(is_float) {
-      not_done = true;
+// identifiers are a letter or '_' followed by letters, digits and '_'; a
+// keyword is recognized by its perfect hash slot, the length compare
+// rejects most identifiers before the memcmp
 
-      while(pos < str_len && not_done) {
-        char c = str[pos];
+inline
+u32 lexer_keyword_slot(cstring str, u32 length) {
+  u32 first = (u8)str[0];
+  u32 last = (u8)str[length - 1U];
 
-        if(c < '0' || c > '9') {
-          not_done = false;
-        } else {
-          ++pos;
-          ++col;
-        }
-      }
+  return (first * LEXER_KEYWORD_MUL_FIRST + last * LEXER_KEYWORD_MUL_LAST + length) & (LEXER_KEYWORD_SLOTS - 1U);
+}
 
-      result->length = pos - start;
-      result->tag = token_tag_float_literal;
+inline
+void lexer_identifier(lexer_state* lex, token* result) {
+  cstring str = lex->str;
+  u32 pos = lex->pos;
+  u32 end = lexer_scan_class(str, pos + 1U, lex->str_len, LEXER_CLASS_IDENT);
+  u32 length = end - pos;
 
-      lex->pos = pos;
-      lex->col = col;
-    } else {
-      result->length = pos - start;
-      result->tag = token_tag_integer_literal;
+  result->tag = token_tag_identifier;
+  result->symbol = INTERN_NONE;
 
-      lex->pos = pos;
-      lex->col = col;
-    }
+  if(length <= LEXER_KEYWORD_MAX_LENGTH) {
+    u32 slot = lexer_keyword_slot(str + pos, length);
+
+    if(lexer_keyword_length[slot] == length && memcmp(str + pos, lexer_keyword_text[slot], length) == 0)
+      result->tag = lexer_keyword_tag[slot];
   }
 
-  return result;
+  if(result->tag == token_tag_identifier) {
+    if(lex->names)
+      result->symbol = intern(lex->names, str + pos, length, intern_hash(str + pos, length));
+    else if(lex->shared_names)
+      result->symbol = intern(lex->shared_names, str + pos, length, intern_hash(str + pos, length));
+  }
+
+  result->start = pos;
+  result->length = length;
+
+  lex->pos = end;
 }
 
-inline
-token_ptr lexer_operator_1(lexer_state* lex) {
-  token_ptr result;
+// operators by maximal munch through the generated DFA, one transition per byte;
+// a character that doesn't start any token becomes a one byte invalid token
 
+inline
+void lexer_operator(lexer_state* lex, token* result) {
   cstring str = lex->str;
   u32 str_len = lex->str_len;
   u32 pos = lex->pos;
-  u32 row = lex->row;
-  u32 col = lex->col;
+  u32 end = pos;
+  u32 state = LEXER_OP_START;
 
-  result = (token_ptr)arena_alloc(lex->ma, sizeof(token));
-  
-  result->start = pos;
-  result->length = 1U;
-  result->row = row;
-  result->col = col;
+  while(end < str_len) {
+    u32 next = lexer_op_next[state * LEXER_OP_CLASS_COUNT + lexer_op_class[(u8)str[end]]];
 
-  switch(str[pos]) {
-    case '(':
-      result->tag = token_tag_op_left_param;
-      break;
-    case ')':
-      result->tag = token_tag_op_right_param;
-      break;
-    case '[':
-      result->tag = token_tag_op_left_bracket;
-      break;
-    case ']':
-      result->tag = token_tag_op_right_bracket;
-      break;
-    case '{':
-      result->tag = token_tag_op_left_brace;
-      break;
-    case '}':
-      result->tag = token_tag_op_right_brace;
-      break;
-    case '+':
-      result->tag = token_tag_op_add;
-      break;
-    case '-':
-      result->tag = token_tag_op_sub;
-      break;
-    case '*':
-      result->tag = token_tag_op_mul;
-      break;
-    case '/':
-      result->tag = token_tag_op_div;
+    if(next == 0U)
       break;
+
+    state = next;
+    ++end;
   }
 
-  lex->pos = pos + 1U;
-  lex->col = col + 1U;
+  u32 length = MAXIMUM(end - pos, 1U);
 
-  return result;
+  result->tag = lexer_op_tag[state];
+  result->start = pos;
+  result->length = length;
+
+  lex->pos = pos + length;
 }
 
-inline
-token_ptr lexer_process(lexer_state* lex) {
-  token_ptr result = 0;
+// lexes the next token into *result, returns false at the end of the input
+// (str_len or a null character)
 
+inline
+bool lexer_next(lexer_state* lex, token* result) {
   cstring str = lex->str;
   u32 str_len = lex->str_len;
   u32 pos = lex->pos;
   
   if(pos >= str_len)
-    return result; // reached end
+    return false; // reached end
 
   // skip whitespace
 
-  bool not_done_skipping_ws = true;
+  pos = lexer_scan_class(str, pos, str_len, LEXER_CLASS_SPACE);
 
-  u32 row = lex->row;
-  u32 col = lex->col;
-
-  while(not_done_skipping_ws && pos < str_len) {
-    char c = str[pos];
+  lex->pos = pos;
 
-    switch(c) {
-      case ' ':
-        ++pos;
-        ++col;
-        break;
-      case '\t':
-        ++pos;
-        col += 2;
-        break;
-      case '\n':
-        ++pos;
-        ++row;
-        col = 1;
-        break;
-      default:
-        not_done_skipping_ws = false;
-        break;
-    }
-  }
+  if(pos >= str_len || str[pos] == 0)
+    return false;
 
-  lex->row = row;
-  lex->col = col;
-  lex->pos = pos;
+  result->symbol = INTERN_NONE;
 
   switch(str[pos]) {
     case '\"': // string literal
-      result = lexer_enclosed_literal(lex, token_tag_string_literal, '\"');
+      lexer_enclosed_literal(lex, result, token_tag_string_literal, '\"');
       break;
     case '\'': // char literal
-      result = lexer_enclosed_literal(lex, token_tag_char_literal, '\'');
+      lexer_enclosed_literal(lex, result, token_tag_char_literal, '\'');
       break;
     case '0': // numeric literal
     case '1':
@@ -444,27 +419,181 @@ token_ptr lexer_process(lexer_state* lex) {
     case '7':
     case '8':
     case '9':
-      result = lexer_numeric_literal(lex);
-      break;
-    case '(':
-    case ')':
-    case '[':
-    case ']':
-    case '{':
-    case '}':
-      result = lexer_operator_1(lex);
+      lexer_numeric_literal(lex, result);
       break;
-    case '+':
-    case '-':
-    case '*':
-    case '/':
-    case '&':
-    case '|':
-      result = lexer_operator_1(lex);
+    default:
+      if(lexer_char_class(str[pos]) & LEXER_CLASS_IDENT_START)
+        lexer_identifier(lex, result);
+      else
+        lexer_operator(lex, result);
       break;
   }
 
+  return true;
+}
+
+inline
+token_ptr lexer_process(lexer_state* lex) {
+  token_ptr result = 0;
+  token tok;
+
+  if(lexer_next(lex, &tok)) {
+    result = (token_ptr)arena_alloc(lex->ma, sizeof(token));
+    *result = tok;
+  }
+
   return result;
 }
 
+//
+// batch lexing into a struct-of-arrays token buffer
+//
+
+// the buffer is sized up front for str_len / LEXER_BYTES_PER_TOKEN tokens and
+// doubled when a source is denser than that
+
+#define LEXER_BYTES_PER_TOKEN 4U
+
+typedef struct token_buffer {
+  u8*  tags;
+  u32* starts;
+  u32* lengths;
+  u32* symbols; // INTERN_NONE for tokens that aren't identifiers
+  u32  count;
+  u32  capacity;
+} token_buffer;
+
+inline
+token_buffer make_token_buffer(arena ma, u32 capacity) {
+  token_buffer result;
+
+  result.tags     = (u8*)arena_alloc(ma, capacity * sizeof(u8));
+  result.starts   = (u32*)arena_alloc(ma, capacity * sizeof(u32));
+  result.lengths  = (u32*)arena_alloc(ma, capacity * sizeof(u32));
+  result.symbols  = (u32*)arena_alloc(ma, capacity * sizeof(u32));
+  result.count    = 0U;
+  result.capacity = capacity;
+
+  return result;
+}
+
+inline
+void token_buffer_grow(arena ma, token_buffer* b) {
+  token_buffer grown = make_token_buffer(ma, 2U * b->capacity);
+
+  memcpy(grown.tags, b->tags, b->count * sizeof(u8));
+  memcpy(grown.starts, b->starts, b->count * sizeof(u32));
+  memcpy(grown.lengths, b->lengths, b->count * sizeof(u32));
+  memcpy(grown.symbols, b->symbols, b->count * sizeof(u32));
+  grown.count = b->count;
+
+  *b = grown;
+}
+
+// a system arena that holds just a token buffer of capacity tokens
+
+inline
+arena make_token_arena(u32 capacity) {
+  return make_system_arena(ALIGN_USIZE_16((usize)capacity * (sizeof(u8) + 3U * sizeof(u32))) + 4096U);
+}
+
+// moves a full buffer held in a token arena into one of twice the size and frees the old one
+
+inline
+void token_buffer_grow(arena* ma, token_buffer* b) {
+  arena grown_arena = make_token_arena(2U * b->capacity);
+  token_buffer grown = make_token_buffer(grown_arena, 2U * b->capacity);
+
+  memcpy(grown.tags, b->tags, b->count * sizeof(u8));
+  memcpy(grown.starts, b->starts, b->count * sizeof(u32));
+  memcpy(grown.lengths, b->lengths, b->count * sizeof(u32));
+  memcpy(grown.symbols, b->symbols, b->count * sizeof(u32));
+  grown.count = b->count;
+
+  free_system_arena(*ma);
+
+  *ma = grown_arena;
+  *b = grown;
+}
+
+inline
+void push_token(arena ma, token_buffer* b, const token* tok) {
+  if(b->count == b->capacity)
+    token_buffer_grow(ma, b);
+
+  u32 id = b->count++;
+
+  b->tags[id]    = (u8)tok->tag;
+  b->starts[id]  = tok->start;
+  b->lengths[id] = tok->length;
+  b->symbols[id] = tok->symbol;
+}
+
+inline
+token_buffer lex_all(lexer_state* lex) {
+  token_buffer result = make_token_buffer(lex->ma, lex->str_len / LEXER_BYTES_PER_TOKEN + 16U);
+  token tok;
+
+  while(lexer_next(lex, &tok))
+    push_token(lex->ma, &result, &tok);
+
+  return result;
+}
+
+// lexes the whole of str, tokens are then addressed by their u32 index
+
+inline
+token_buffer lex_all(arena ma, cstring str, u32 str_len) {
+  lexer_state lex;
+
+  lex.str          = str;
+  lex.str_len      = str_len;
+  lex.pos          = 0;
+  lex.ma           = ma;
+  lex.lines        = 0;
+  lex.names        = 0;
+  lex.shared_names = 0;
+
+  return lex_all(&lex);
+}
+
+// the same, interning the identifiers
+
+inline
+token_buffer lex_all(arena ma, interner* names, cstring str, u32 str_len) {
+  lexer_state lex;
+
+  lex.str          = str;
+  lex.str_len      = str_len;
+  lex.pos          = 0;
+  lex.ma           = ma;
+  lex.lines        = 0;
+  lex.names        = names;
+  lex.shared_names = 0;
+
+  return lex_all(&lex);
+}
+
+inline
+token_buffer lex_all(arena ma, sharded_interner* names, cstring str, u32 str_len) {
+  lexer_state lex;
+
+  lex.str          = str;
+  lex.str_len      = str_len;
+  lex.pos          = 0;
+  lex.ma           = ma;
+  lex.lines        = 0;
+  lex.names        = 0;
+  lex.shared_names = names;
+
+  return lex_all(&lex);
+}
+
+inline
+void print_token(const token_buffer* b, u32 id, cstring str) {
+  printf("[tag: %d, len: %u, ", b->tags[id], b->lengths[id]);
+  fwrite(str + b->starts[id], 1, b->lengths[id], stdout);
+  printf("]");
+}
+
 #endif
@@ -0,0 +1,213 @@
+/**
+ *  lexer_classify.h
+ *
+ *  Character classification for the lexer's scanning loops, a block of
+ *  LEXER_BLOCK bytes at a time.
+ *
+ *  A byte's class bits are lexer_class_lo[low nibble] & lexer_class_hi[high
+ *  nibble]: every class is a union of (high nibble, low nibble ranges)
+ *  rectangles, each with its own bit. With SSSE3/AVX2 both lookups are one
+ *  pshufb per block; SSE2 alone uses compares; the scalar code looks the
+ *  bits up in lexer_class_table, the two nibble tables expanded to 256
+ *  entries.
+ *
+ *  lexer_class_mask turns a block into a bit mask of the bytes in any of
+ *  the requested classes, and the scan functions find the end of a run
+ *  with ctz on the inverted mask.
+ *
+ *  Most runs are short (one space between tokens, small numbers), so the
+ *  first LEXER_SCALAR_PREFIX bytes of a run are tested one at a time and
+ *  the block loops only take over for longer runs. They only load blocks
+ *  entirely inside [0, str_len), the rest is scanned byte by byte.
+ */
+
+#ifndef CPEAK_LEXER_CLASSIFY_H
+#define CPEAK_LEXER_CLASSIFY_H
+
+#include "types.h"
+#include "macro.h"
+#include "bits.h"
+#include "simd.h"
+
+// class bits:
+// 0x01 ' '         0x02 '\t' '\n'    0x04 '0'-'9'    0x08 'a'-'f' 'A'-'F'
+// 0x10 'a'-'o' 'A'-'O'   0x20 'p'-'z' 'P'-'Z'   0x40 '_'
+
+#define LEXER_CLASS_SPACE       0x03U
+#define LEXER_CLASS_DIGIT       0x04U
+#define LEXER_CLASS_HEX         0x0CU
+#define LEXER_CLASS_IDENT       0x74U
+#define LEXER_CLASS_IDENT_START 0x70U
+
+#define LEXER_SCALAR_PREFIX 4U
+
+#if defined(CPEAK_AVX2)
+#define LEXER_BLOCK      32U
+#define LEXER_BLOCK_MASK 0xFFFFFFFFU
+#elif defined(CPEAK_SSE2)
+#define LEXER_BLOCK      16U
+#define LEXER_BLOCK_MASK 0xFFFFU
+#endif
+
+static const u8 lexer_class_lo[16] = {
+  0x25, 0x3C, 0x3C, 0x3C, 0x3C, 0x3C, 0x3C, 0x34,
+  0x34, 0x36, 0x32, 0x10, 0x10, 0x10, 0x10, 0x50,
+};
+
+static const u8 lexer_class_hi[16] = {
+  0x02, 0x00, 0x01, 0x04, 0x18, 0x60, 0x18, 0x20,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+// lexer_class_table[b] == lexer_class_lo[b & 15] & lexer_class_hi[b >> 4]
+
+static const u8 lexer_class_table[256] = {
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0x00, 0x40,
+  0x00, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+inline
+u32 lexer_char_class(char c) {
+  return lexer_class_table[(u8)c];
+}
+
+//
+// block masks
+//
+
+#if defined(CPEAK_AVX2)
+inline
+u32 lexer_class_mask(const char* p, u32 classes) {
+  __m256i lo_lut = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)lexer_class_lo));
+  __m256i hi_lut = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)lexer_class_hi));
+  __m256i nibble = _mm256_set1_epi8(0x0F);
+
+  __m256i v  = _mm256_loadu_si256((const __m256i*)p);
+  __m256i lo = _mm256_shuffle_epi8(lo_lut, _mm256_and_si256(v, nibble));
+  __m256i hi = _mm256_shuffle_epi8(hi_lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+  __m256i c  = _mm256_and_si256(_mm256_and_si256(lo, hi), _mm256_set1_epi8((char)classes));
+
+  return ~(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(c, _mm256_setzero_si256()));
+}
+
+inline
+u32 lexer_byte_mask(const char* p, char c) {
+  __m256i v = _mm256_loadu_si256((const __m256i*)p);
+
+  return (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)));
+}
+#elif defined(CPEAK_SSSE3)
+inline
+u32 lexer_class_mask(const char* p, u32 classes) {
+  __m128i lo_lut = _mm_loadu_si128((const __m128i*)lexer_class_lo);
+  __m128i hi_lut = _mm_loadu_si128((const __m128i*)lexer_class_hi);
+  __m128i nibble = _mm_set1_epi8(0x0F);
+
+  __m128i v  = _mm_loadu_si128((const __m128i*)p);
+  __m128i lo = _mm_shuffle_epi8(lo_lut, _mm_and_si128(v, nibble));
+  __m128i hi = _mm_shuffle_epi8(hi_lut, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+  __m128i c  = _mm_and_si128(_mm_and_si128(lo, hi), _mm_set1_epi8((char)classes));
+
+  return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_setzero_si128())) ^ 0xFFFFU;
+}
+#elif defined(CPEAK_SSE2)
+// x in [lo, hi] as unsigned bytes
+
+inline
+__m128i lexer_in_range_sse2(__m128i x, char lo, char hi) {
+  __m128i d = _mm_sub_epi8(x, _mm_set1_epi8(lo));
+
+  return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8((char)(hi - lo))), d);
+}
+
+// without pshufb the classes are tested with compares; 'classes' is a constant at the call sites
+
+inline
+u32 lexer_class_mask(const char* p, u32 classes) {
+  __m128i v = _mm_loadu_si128((const __m128i*)p);
+  __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  __m128i m = _mm_setzero_si128();
+
+  if(classes & 0x01U)
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+
+  if(classes & 0x02U)
+    m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+
+  if(classes & 0x04U)
+    m = _mm_or_si128(m, lexer_in_range_sse2(v, '0', '9'));
+
+  if(classes & 0x08U)
+    m = _mm_or_si128(m, lexer_in_range_sse2(lower, 'a', 'f'));
+
+  if(classes & 0x30U)
+    m = _mm_or_si128(m, lexer_in_range_sse2(lower, 'a', 'z'));
+
+  if(classes & 0x40U)
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+
+  return (u32)_mm_movemask_epi8(m);
+}
+#endif
+
+#if defined(CPEAK_SSE2) && !defined(CPEAK_AVX2)
+inline
+u32 lexer_byte_mask(const char* p, char c) {
+  __m128i v = _mm_loadu_si128((const __m128i*)p);
+
+  return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+}
+#endif
+
+//
+// scanning
+//
+
+// end of the run of bytes in any of 'classes' starting at pos, a block at a time
+
+inline
+u32 lexer_scan_class_blocks(cstring str, u32 pos, u32 str_len, u32 classes) {
+#if defined(LEXER_BLOCK)
+  while(pos + LEXER_BLOCK <= str_len) {
+    u32 other = ~lexer_class_mask(str + pos, classes) & LEXER_BLOCK_MASK;
+
+    if(other != 0U)
+      return pos + bits_ctz_u32(other);
+
+    pos += LEXER_BLOCK;
+  }
+#endif
+
+  while(pos < str_len && (lexer_char_class(str[pos]) & classes))
+    ++pos;
+
+  return pos;
+}
+
+inline
+u32 lexer_scan_class(cstring str, u32 pos, u32 str_len, u32 classes) {
+  u32 prefix_end = MINIMUM(pos + LEXER_SCALAR_PREFIX, str_len);
+
+  for(; pos < prefix_end; ++pos) {
+    if(!(lexer_char_class(str[pos]) & classes))
+      return pos;
+  }
+
+  return lexer_scan_class_blocks(str, pos, str_len, classes);
+}
+
+#endif
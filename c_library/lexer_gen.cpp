@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "macro.h"
+
+// generates lexer_tables.h from tokens.txt
+//
+// usage: lexer_gen tokens.txt lexer_tables.h
+//
+// every line of tokens.txt is "symbol tag_name", the token's tag is
+// token_tag_<tag_name>; blank lines are ignored.
+//
+// the operators become a maximal-munch DFA over byte classes: a byte maps
+// to its class with lexer_op_class, a state and a class to the next state
+// with lexer_op_next (0 is the dead state, LEXER_OP_START the start), and
+// lexer_op_tag is the tag of the operator ending in a state. Every prefix
+// of an operator has to be an operator itself, so the lexer can stop at
+// the dead state without backtracking.
+//
+// symbols starting with a letter or '_' are keywords. They get a perfect
+// hash of length, first and last character:
+//   (first * LEXER_KEYWORD_MUL_FIRST + last * LEXER_KEYWORD_MUL_LAST + length)
+//     & (LEXER_KEYWORD_SLOTS - 1)
+// the generator searches the multipliers and the smallest power of two
+// slot count without collisions. A slot holds the keyword's length, text
+// and tag, so an identifier is a keyword iff its slot has the same length
+// and one memcmp matches.
+
+#define GEN_MAX_TOKENS  256
+#define GEN_MAX_SYMBOL  16
+#define GEN_MAX_NAME    64
+#define GEN_MAX_STATES  256
+#define GEN_MAX_CLASSES 64
+#define GEN_MAX_SLOTS   256
+#define GEN_MAX_MUL     64
+
+typedef struct gen_token {
+  char symbol[GEN_MAX_SYMBOL];
+  char name[GEN_MAX_NAME];
+} gen_token;
+
+typedef struct gen_dfa {
+  u32 state_count;
+  u32 class_count;
+  u8  byte_class[256];
+  u8  next[GEN_MAX_STATES][GEN_MAX_CLASSES];
+  i32 token[GEN_MAX_STATES]; // index of the token ending in the state, -1 if none
+} gen_dfa;
+
+typedef struct gen_keyword_hash {
+  u32 slot_count;
+  u32 mul_first;
+  u32 mul_last;
+  u32 max_length;
+  i32 token[GEN_MAX_SLOTS]; // index of the keyword in the slot, -1 if none
+} gen_keyword_hash;
+
+static gen_token        tokens[GEN_MAX_TOKENS];
+static u32              token_count;
+static gen_dfa          dfa;
+static gen_keyword_hash keywords;
+
+bool is_keyword(const gen_token* tok) {
+  char c = tok->symbol[0];
+
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+u32 keyword_slot(const gen_token* tok, u32 mul_first, u32 mul_last, u32 slot_count) {
+  u32 length = (u32)strlen(tok->symbol);
+  u32 first = (u8)tok->symbol[0];
+  u32 last = (u8)tok->symbol[length - 1U];
+
+  return (first * mul_first + last * mul_last + length) & (slot_count - 1U);
+}
+
+bool read_tokens(cstring path) {
+  FILE* f = fopen(path, "r");
+  char line[256];
+
+  if(f == 0) {
+    printf("can't open %s\n", path);
+    return false;
+  }
+
+  while(fgets(line, sizeof(line), f)) {
+    gen_token tok;
+
+    if(sscanf(line, "%15s %63s", tok.symbol, tok.name) != 2)
+      continue;
+
+    if(token_count == GEN_MAX_TOKENS) {
+      printf("too many tokens\n");
+      fclose(f);
+      return false;
+    }
+
+    tokens[token_count++] = tok;
+  }
+
+  fclose(f);
+
+  return true;
+}
+
+bool build_dfa() {
+  memset(&dfa, 0, sizeof(dfa));
+
+  dfa.state_count = 2U; // dead and start
+  dfa.class_count = 1U; // bytes that aren't in any operator
+  dfa.token[0] = -1;
+  dfa.token[1] = -1;
+
+  for(u32 t = 0U; t < token_count; ++t) {
+    u32 state = 1U;
+
+    if(is_keyword(&tokens[t]))
+      continue;
+
+    for(cstring c = tokens[t].symbol; *c; ++c) {
+      u8 b = (u8)*c;
+
+      if(dfa.byte_class[b] == 0U) {
+        if(dfa.class_count == GEN_MAX_CLASSES) {
+          printf("too many operator characters\n");
+          return false;
+        }
+
+        dfa.byte_class[b] = (u8)dfa.class_count++;
+      }
+
+      u32 cls = dfa.byte_class[b];
+
+      if(dfa.next[state][cls] == 0U) {
+        if(dfa.state_count == GEN_MAX_STATES) {
+          printf("too many states\n");
+          return false;
+        }
+
+        dfa.token[dfa.state_count] = -1;
+        dfa.next[state][cls] = (u8)dfa.state_count++;
+      }
+
+      state = dfa.next[state][cls];
+    }
+
+    if(dfa.token[state] >= 0) {
+      printf("duplicate operator %s\n", tokens[t].symbol);
+      return false;
+    }
+
+    dfa.token[state] = (i32)t;
+  }
+
+  for(u32 state = 2U; state < dfa.state_count; ++state) {
+    if(dfa.token[state] < 0) {
+      printf("an operator has a prefix that isn't an operator\n");
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool try_keyword_hash(u32 mul_first, u32 mul_last, u32 slot_count) {
+  for(u32 slot = 0U; slot < slot_count; ++slot)
+    keywords.token[slot] = -1;
+
+  for(u32 t = 0U; t < token_count; ++t) {
+    if(!is_keyword(&tokens[t]))
+      continue;
+
+    u32 slot = keyword_slot(&tokens[t], mul_first, mul_last, slot_count);
+
+    if(keywords.token[slot] >= 0)
+      return false;
+
+    keywords.token[slot] = (i32)t;
+  }
+
+  keywords.slot_count = slot_count;
+  keywords.mul_first  = mul_first;
+  keywords.mul_last   = mul_last;
+
+  return true;
+}
+
+bool build_keyword_hash() {
+  u32 keyword_count = 0U;
+
+  keywords.max_length = 0U;
+
+  for(u32 t = 0U; t < token_count; ++t) {
+    if(!is_keyword(&tokens[t]))
+      continue;
+
+    for(u32 s = 0U; s < t; ++s) {
+      if(strcmp(tokens[s].symbol, tokens[t].symbol) == 0) {
+        printf("duplicate keyword %s\n", tokens[t].symbol);
+        return false;
+      }
+    }
+
+    keywords.max_length = MAXIMUM(keywords.max_length, (u32)strlen(tokens[t].symbol));
+    ++keyword_count;
+  }
+
+  u32 slot_count = 1U;
+
+  while(slot_count < keyword_count)
+    slot_count *= 2U;
+
+  for(; slot_count <= GEN_MAX_SLOTS; slot_count *= 2U) {
+    for(u32 mul_first = 0U; mul_first < GEN_MAX_MUL; ++mul_first) {
+      for(u32 mul_last = 0U; mul_last < GEN_MAX_MUL; ++mul_last) {
+        if(try_keyword_hash(mul_first, mul_last, slot_count))
+          return true;
+      }
+    }
+  }
+
+  printf("no perfect hash for the keywords\n");
+  return false;
+}
+
+bool write_tables(cstring tokens_path, cstring path) {
+  FILE* f = fopen(path, "w");
+
+  if(f == 0) {
+    printf("can't write %s\n", path);
+    return false;
+  }
+
+  fprintf(f, "// generated by lexer_gen from %s, do not edit\n\n", tokens_path);
+  fprintf(f, "#ifndef CPEAK_LEXER_TABLES_H\n");
+  fprintf(f, "#define CPEAK_LEXER_TABLES_H\n\n");
+
+  fprintf(f, "#define LEXER_OP_CLASS_COUNT %uU\n", dfa.class_count);
+  fprintf(f, "#define LEXER_OP_STATE_COUNT %uU\n", dfa.state_count);
+  fprintf(f, "#define LEXER_OP_START       1U\n\n");
+
+  fprintf(f, "static const u8 lexer_op_class[256] = {\n");
+
+  for(u32 b = 0U; b < 256U; ++b)
+    fprintf(f, "%s%2u,%s", (b % 16U == 0U) ? "  " : " ", dfa.byte_class[b], (b % 16U == 15U) ? "\n" : "");
+
+  fprintf(f, "};\n\n");
+
+  fprintf(f, "static const u8 lexer_op_next[LEXER_OP_STATE_COUNT * LEXER_OP_CLASS_COUNT] = {\n");
+
+  for(u32 state = 0U; state < dfa.state_count; ++state) {
+    fprintf(f, " ");
+
+    for(u32 cls = 0U; cls < dfa.class_count; ++cls)
+      fprintf(f, " %2u,", dfa.next[state][cls]);
+
+    fprintf(f, "\n");
+  }
+
+  fprintf(f, "};\n\n");
+
+  fprintf(f, "static const u8 lexer_op_tag[LEXER_OP_STATE_COUNT] = {\n");
+
+  for(u32 state = 0U; state < dfa.state_count; ++state) {
+    if(dfa.token[state] < 0)
+      fprintf(f, "  token_tag_invalid,\n");
+    else
+      fprintf(f, "  token_tag_%s, // %s\n", tokens[dfa.token[state]].name, tokens[dfa.token[state]].symbol);
+  }
+
+  fprintf(f, "};\n\n");
+
+  fprintf(f, "#define LEXER_KEYWORD_SLOTS      %uU\n", keywords.slot_count);
+  fprintf(f, "#define LEXER_KEYWORD_MUL_FIRST  %uU\n", keywords.mul_first);
+  fprintf(f, "#define LEXER_KEYWORD_MUL_LAST   %uU\n", keywords.mul_last);
+  fprintf(f, "#define LEXER_KEYWORD_MAX_LENGTH %uU\n\n", keywords.max_length);
+
+  fprintf(f, "static const u8 lexer_keyword_length[LEXER_KEYWORD_SLOTS] = {\n");
+
+  for(u32 slot = 0U; slot < keywords.slot_count; ++slot)
+    fprintf(f, "  %u,\n", (keywords.token[slot] < 0) ? 0U : (u32)strlen(tokens[keywords.token[slot]].symbol));
+
+  fprintf(f, "};\n\n");
+
+  fprintf(f, "static const char lexer_keyword_text[LEXER_KEYWORD_SLOTS][LEXER_KEYWORD_MAX_LENGTH + 1U] = {\n");
+
+  for(u32 slot = 0U; slot < keywords.slot_count; ++slot)
+    fprintf(f, "  \"%s\",\n", (keywords.token[slot] < 0) ? "" : tokens[keywords.token[slot]].symbol);
+
+  fprintf(f, "};\n\n");
+
+  fprintf(f, "static const u8 lexer_keyword_tag[LEXER_KEYWORD_SLOTS] = {\n");
+
+  for(u32 slot = 0U; slot < keywords.slot_count; ++slot) {
+    if(keywords.token[slot] < 0)
+      fprintf(f, "  token_tag_identifier,\n");
+    else
+      fprintf(f, "  token_tag_%s,\n", tokens[keywords.token[slot]].name);
+  }
+
+  fprintf(f, "};\n\n");
+  fprintf(f, "#endif\n");
+
+  fclose(f);
+
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if(argc != 3) {
+    printf("usage: %s tokens.txt lexer_tables.h\n", argv[0]);
+    return 1;
+  }
+
+  if(!read_tokens(argv[1]) || !build_dfa() || !build_keyword_hash() || !write_tables(argv[1], argv[2]))
+    return 1;
+
+  return 0;
+}
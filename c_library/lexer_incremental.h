@@ -0,0 +1,195 @@
+/**
+ *  lexer_incremental.h
+ *
+ *  Updating a token buffer after an edit of its source instead of lexing
+ *  the whole source again.
+ *
+ *  The lexer has no state besides its position, so two runs over the same
+ *  text that start a token at the same position produce the same tokens
+ *  from there on. relex restarts after the last token that the edit can't
+ *  have changed and lexes the new text until it starts a token exactly
+ *  where an old token after the edit started (shifted by the change in
+ *  length). The old tokens from there on are kept, with their starts
+ *  shifted. The work in the lexer is bounded by the tokens around the
+ *  edit; moving and shifting the tail of the buffer is a memmove and an
+ *  add per token.
+ *
+ *  A token is safe to restart after when it ends at least 2 bytes before
+ *  the edit: the lexer looks one byte past the end of a token to end it,
+ *  and a 0 looks 2 bytes ahead for a 0x prefix. An unterminated literal
+ *  runs to the end of the source and is never safe.
+ */
+
+#ifndef CPEAK_LEXER_INCREMENTAL_H
+#define CPEAK_LEXER_INCREMENTAL_H
+
+#include <string.h>
+#include "types.h"
+#include "macro.h"
+#include "arena.h"
+#include "lexer.h"
+
+// removed bytes at offset of the old source were replaced by inserted bytes
+
+typedef struct lexer_edit {
+  u32 offset;
+  u32 removed;
+  u32 inserted;
+} lexer_edit;
+
+// bytes of a token in front of its start: string and char literal tokens
+// don't include their opening quote, hex literals their 0x
+
+inline
+u32 token_prefix_length(u32 tag) {
+  u32 result = 0U;
+
+  if(tag == token_tag_string_literal || tag == token_tag_char_literal)
+    result = 1U;
+  else if(tag == token_tag_hex_literal)
+    result = 2U;
+
+  return result;
+}
+
+inline
+u32 token_begin(const token_buffer* b, u32 id) {
+  return b->starts[id] - token_prefix_length(b->tags[id]);
+}
+
+inline
+u32 token_end(const token_buffer* b, u32 id) {
+  bool enclosed = b->tags[id] == token_tag_string_literal || b->tags[id] == token_tag_char_literal;
+
+  return b->starts[id] + b->lengths[id] + (enclosed ? 1U : 0U);
+}
+
+// number of tokens that end 2 or more bytes before offset, the index of the first token to lex again
+
+inline
+u32 relex_first_token(const token_buffer* b, u32 offset) {
+  u32 lo = 0U;
+  u32 hi = b->count;
+
+  while(lo < hi) {
+    u32 mid = lo + (hi - lo) / 2U;
+
+    if(token_end(b, mid) + 1U < offset)
+      lo = mid + 1U;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+// first token that begins at or after offset
+
+inline
+u32 relex_first_token_after(const token_buffer* b, u32 offset) {
+  u32 lo = 0U;
+  u32 hi = b->count;
+
+  while(lo < hi) {
+    u32 mid = lo + (hi - lo) / 2U;
+
+    if(token_begin(b, mid) < offset)
+      lo = mid + 1U;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+// updates tokens, lexed from the old source, to the edited source str; new
+// identifiers are interned into names when it isn't null, it should be the
+// interner the buffer was lexed with. The tokens lexed again are staged in a
+// token arena that's freed before returning (ma can't be pushed and popped
+// around them, the interner may allocate from it). Only an edit that adds
+// tokens past the capacity allocates from ma: the buffer doubles and, as
+// with lex_all, the old arrays stay in ma. Returns the number of tokens
+// lexed again.
+
+inline
+u32 relex(arena ma, interner* names, token_buffer* tokens, cstring str, u32 str_len, lexer_edit edit) {
+  u32 first = relex_first_token(tokens, edit.offset);
+  u32 old_tail = relex_first_token_after(tokens, edit.offset + edit.removed);
+  u32 resync = tokens->count;
+  bool resynced = false;
+
+  lexer_state lex;
+  token tok;
+
+  lex.str          = str;
+  lex.str_len      = str_len;
+  lex.pos          = (first == 0U) ? 0U : token_end(tokens, first - 1U);
+  lex.ma           = ma;
+  lex.lines        = 0;
+  lex.names        = names;
+  lex.shared_names = 0;
+
+  // old token j begins at token_begin(tokens, j) + edit.inserted - edit.removed in the new source
+
+  arena fresh_ma = make_token_arena(64U);
+  token_buffer fresh = make_token_buffer(fresh_ma, 64U);
+  u32 j = old_tail;
+
+  while(lexer_next(&lex, &tok)) {
+    u32 begin = tok.start - token_prefix_length(tok.tag);
+
+    while(j < tokens->count && token_begin(tokens, j) + edit.inserted < begin + edit.removed)
+      ++j;
+
+    if(j < tokens->count && token_begin(tokens, j) + edit.inserted == begin + edit.removed) {
+      resync = j;
+      resynced = true;
+      break;
+    }
+
+    if(fresh.count == fresh.capacity)
+      token_buffer_grow(&fresh_ma, &fresh);
+
+    push_token(fresh_ma, &fresh, &tok);
+  }
+
+  // [0, first) stays, then the fresh tokens, then [resync, count) shifted
+
+  u32 tail_count = tokens->count - resync;
+  u32 count = first + fresh.count + tail_count;
+
+  while(count > tokens->capacity)
+    token_buffer_grow(ma, tokens);
+
+  u32 to = first + fresh.count;
+
+  memmove(tokens->tags + to, tokens->tags + resync, tail_count * sizeof(u8));
+  memmove(tokens->starts + to, tokens->starts + resync, tail_count * sizeof(u32));
+  memmove(tokens->lengths + to, tokens->lengths + resync, tail_count * sizeof(u32));
+  memmove(tokens->symbols + to, tokens->symbols + resync, tail_count * sizeof(u32));
+
+  u32 shift = edit.inserted - edit.removed; // wraps for a shrinking edit, the sum still comes out right
+
+  for(u32 id = to; id < count; ++id)
+    tokens->starts[id] += shift;
+
+  memcpy(tokens->tags + first, fresh.tags, fresh.count * sizeof(u8));
+  memcpy(tokens->starts + first, fresh.starts, fresh.count * sizeof(u32));
+  memcpy(tokens->lengths + first, fresh.lengths, fresh.count * sizeof(u32));
+  memcpy(tokens->symbols + first, fresh.symbols, fresh.count * sizeof(u32));
+
+  tokens->count = count;
+
+  free_system_arena(fresh_ma);
+
+  // the token lexed at the resync point isn't kept, it's the same as the old one
+
+  return fresh.count + (resynced ? 1U : 0U);
+}
+
+inline
+u32 relex(arena ma, token_buffer* tokens, cstring str, u32 str_len, lexer_edit edit) {
+  return relex(ma, 0, tokens, str, str_len, edit);
+}
+
+#endif
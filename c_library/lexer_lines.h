@@ -0,0 +1,117 @@
+/**
+ *  lexer_lines.h
+ *
+ *  Source locations on demand: tokens only hold their byte offset, and the
+ *  row and col of an offset are looked up in a line index when a printer or
+ *  a diagnostic needs them.
+ *
+ *  The line index holds the offset of the first byte of every line. It is
+ *  built with two passes of the lexer_classify.h block masks: popcount of
+ *  the newline masks for the number of lines, then ctz over the same masks
+ *  for their starts. A location is a binary search for the line, and the
+ *  col counts the bytes from the start of the line with a tab counting 2,
+ *  as the lexer used to count them.
+ */
+
+#ifndef CPEAK_LEXER_LINES_H
+#define CPEAK_LEXER_LINES_H
+
+#include "types.h"
+#include "macro.h"
+#include "arena.h"
+#include "bits.h"
+#include "lexer_classify.h"
+
+typedef struct line_index {
+  u32* starts; // starts[0] == 0
+  u32  count;  // number of lines, newlines + 1
+} line_index;
+
+typedef struct source_location {
+  u32 row; // from 1
+  u32 col; // from 1
+} source_location;
+
+inline
+u32 count_newlines(cstring str, u32 str_len) {
+  u32 result = 0U;
+  u32 pos = 0U;
+
+#if defined(LEXER_BLOCK)
+  for(; pos + LEXER_BLOCK <= str_len; pos += LEXER_BLOCK)
+    result += bits_popcount_u32(lexer_byte_mask(str + pos, '\n'));
+#endif
+
+  for(; pos < str_len; ++pos)
+    result += (str[pos] == '\n') ? 1U : 0U;
+
+  return result;
+}
+
+inline
+line_index make_line_index(arena ma, cstring str, u32 str_len) {
+  line_index result;
+
+  result.count  = count_newlines(str, str_len) + 1U;
+  result.starts = (u32*)arena_alloc(ma, result.count * sizeof(u32));
+
+  u32* out = result.starts;
+  u32 pos = 0U;
+
+  *out++ = 0U;
+
+#if defined(LEXER_BLOCK)
+  for(; pos + LEXER_BLOCK <= str_len; pos += LEXER_BLOCK) {
+    u32 newlines = lexer_byte_mask(str + pos, '\n');
+
+    while(newlines != 0U) {
+      *out++ = pos + bits_ctz_u32(newlines) + 1U;
+      newlines &= newlines - 1U;
+    }
+  }
+#endif
+
+  for(; pos < str_len; ++pos) {
+    if(str[pos] == '\n')
+      *out++ = pos + 1U;
+  }
+
+  return result;
+}
+
+// index of the line holding offset, the last line whose start is <= offset
+
+inline
+u32 line_of(const line_index* lines, u32 offset) {
+  u32 lo = 0U;
+  u32 hi = lines->count;
+
+  while(hi - lo > 1U) {
+    u32 mid = lo + (hi - lo) / 2U;
+
+    if(lines->starts[mid] <= offset)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+inline
+source_location locate(const line_index* lines, cstring str, u32 offset) {
+  source_location result;
+  u32 line = line_of(lines, offset);
+  u32 start = lines->starts[line];
+  u32 tabs = 0U;
+
+  for(u32 pos = start; pos < offset; ++pos)
+    tabs += (str[pos] == '\t') ? 1U : 0U;
+
+  result.row = line + 1U;
+  result.col = 1U + (offset - start) + tabs;
+
+  return result;
+}
+
+#endif
@@ -0,0 +1,523 @@
+/**
+ *  lexer_numbers.h
+ *
+ *  Decoding integer, hex and float literals into their values while they
+ *  are lexed, into a number_table indexed by token id, so nothing after
+ *  the lexer parses digits again.
+ *
+ *  Decimal digits are parsed 8 at a time: one u64 load, and three
+ *  multiplies that combine neighbouring digits into pairs, fours and the
+ *  8-digit value (SWAR). Hex digits are parsed 8 at a time the same way
+ *  with shifts. A u64 holds any 19 digits, so an integer literal fits in
+ *  two 8-digit steps and a short one, and overflows iff it has more than
+ *  20 significant digits or the 20th one doesn't fit.
+ *
+ *  A float literal is read into a significand w of at most 19 significant
+ *  digits and a power of ten q, and converted with the Eisel-Lemire
+ *  algorithm: w, normalized, times the 128-bit significand of 5^q from
+ *  number_tables.h (number_gen.cpp) gives the rounded f64 significand,
+ *  and the binary exponent comes from q. Small cases take Clinger's fast
+ *  path, one exact multiply or divide in f64. Digits past the 19th are
+ *  dropped; when that leaves w and w + 1 rounding differently the literal
+ *  falls back to strtod, which depends on the C locale.
+ *
+ *  The table's values are the u64 of integer and hex literals and the bits
+ *  of the f64 of float literals, with a flag for literals that overflow:
+ *  integers saturate to U64_MAX and floats become infinity. Entries of
+ *  tokens that aren't numeric literals are undefined.
+ */
+
+#ifndef CPEAK_LEXER_NUMBERS_H
+#define CPEAK_LEXER_NUMBERS_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "macro.h"
+#include "arena.h"
+#include "bits.h"
+#include "lexer.h"
+
+// the powers of five, generated by number_gen: number_gen number_tables.h
+
+#include "number_tables.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define NUMBER_OVERFLOW        0x01U // the literal doesn't fit, the value saturated
+#define NUMBER_MAX_DIGITS      19U   // significant digits that always fit in a u64
+#define NUMBER_FALLBACK_BUFFER 128U  // literals strtod can parse without an allocation
+
+typedef struct number_table {
+  u64* values;   // by token id, the bits of the f64 for float literals
+  u8*  flags;    // by token id
+  u32  capacity;
+} number_table;
+
+static const u64 number_pow10_u64[NUMBER_MAX_DIGITS + 1U] = {
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+  100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+  10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+  100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL,
+};
+
+// the powers of ten that are exact in an f64
+
+static const f64 number_pow10_f64[23] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+//
+// digits
+//
+
+// the 8 decimal digits at p, little-endian loads
+
+inline
+u32 number_parse_8_digits(const char* p) {
+  u64 v;
+
+  memcpy(&v, p, 8U);
+
+  v = ((v & 0x0F0F0F0F0F0F0F0FULL) * 2561U) >> 8;                 // pairs of digits
+  v = ((v & 0x00FF00FF00FF00FFULL) * 6553601U) >> 16;             // fours
+  v = ((v & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32;    // all eight
+
+  return (u32)v;
+}
+
+// the 8 hex digits at p
+
+inline
+u32 number_parse_8_hex_digits(const char* p) {
+  u64 v;
+
+  memcpy(&v, p, 8U);
+
+  // a letter has bit 6 set and its low nibble is its value - 9
+  v = (v & 0x0F0F0F0F0F0F0F0FULL) + ((v >> 6) & 0x0101010101010101ULL) * 9U;
+
+  v = ((v << 4) | (v >> 8)) & 0x00FF00FF00FF00FFULL;
+  v = ((v << 8) | (v >> 16)) & 0x0000FFFF0000FFFFULL;
+  v = ((v << 16) | (v >> 32)) & 0x00000000FFFFFFFFULL;
+
+  return (u32)v;
+}
+
+// the value of count <= NUMBER_MAX_DIGITS decimal digits
+
+inline
+u64 number_parse_digits(const char* p, u32 count) {
+  u64 result = 0U;
+  u32 i = 0U;
+
+  for(; i + 8U <= count; i += 8U)
+    result = result * 100000000U + number_parse_8_digits(p + i);
+
+  for(; i < count; ++i)
+    result = result * 10U + (u64)(p[i] - '0');
+
+  return result;
+}
+
+inline
+u32 number_hex_digit(char c) {
+  return (u32)(c & 0x0F) + ((c & 0x40) ? 9U : 0U);
+}
+
+inline
+u32 number_skip_zeros(const char* p, u32 count) {
+  u32 result = 0U;
+
+  while(result < count && p[result] == '0')
+    ++result;
+
+  return result;
+}
+
+//
+// integers
+//
+
+// the value of count decimal digits, returns NUMBER_OVERFLOW when it doesn't fit
+
+inline
+u32 number_decode_integer(const char* p, u32 count, u64* value) {
+  u32 zeros = number_skip_zeros(p, count);
+
+  p += zeros;
+  count -= zeros;
+
+  if(count <= NUMBER_MAX_DIGITS) {
+    *value = number_parse_digits(p, count);
+    return 0U;
+  }
+
+  u64 head = number_parse_digits(p, NUMBER_MAX_DIGITS);
+  u64 digit = (u64)(p[NUMBER_MAX_DIGITS] - '0');
+
+  if(count > NUMBER_MAX_DIGITS + 1U || head > (~0ULL - digit) / 10U) {
+    *value = ~0ULL;
+    return NUMBER_OVERFLOW;
+  }
+
+  *value = head * 10U + digit;
+
+  return 0U;
+}
+
+inline
+u32 number_decode_hex(const char* p, u32 count, u64* value) {
+  u32 zeros = number_skip_zeros(p, count);
+
+  p += zeros;
+  count -= zeros;
+
+  if(count > 16U) {
+    *value = ~0ULL;
+    return NUMBER_OVERFLOW;
+  }
+
+  u64 result = 0U;
+  u32 i = 0U;
+
+  for(; i + 8U <= count; i += 8U)
+    result = (result << 32) | number_parse_8_hex_digits(p + i);
+
+  for(; i < count; ++i)
+    result = (result << 4) | number_hex_digit(p[i]);
+
+  *value = result;
+
+  return 0U;
+}
+
+//
+// floats
+//
+
+// the low word of a * b, the high word into hi
+
+inline
+u64 number_mul_u64(u64 a, u64 b, u64* hi) {
+#if defined(_MSC_VER) && defined(_M_X64)
+  return _umul128(a, b, hi);
+#elif defined(__SIZEOF_INT128__)
+  unsigned __int128 p = (unsigned __int128)a * b;
+
+  *hi = (u64)(p >> 64);
+
+  return (u64)p;
+#else
+  u64 a_lo = (u32)a;
+  u64 a_hi = a >> 32;
+  u64 b_lo = (u32)b;
+  u64 b_hi = b >> 32;
+
+  u64 lo_lo = a_lo * b_lo;
+  u64 hi_lo = a_hi * b_lo;
+  u64 lo_hi = a_lo * b_hi;
+  u64 cross = (lo_lo >> 32) + (u32)hi_lo + lo_hi;
+
+  *hi = a_hi * b_hi + (hi_lo >> 32) + (cross >> 32);
+
+  return (cross << 32) | (u32)lo_lo;
+#endif
+}
+
+// the bits of the f64 nearest to w * 10^q, for w != 0
+
+inline
+u64 number_eisel_lemire(u64 w, i32 q) {
+  if(q < NUMBER_POW5_MIN)
+    return 0U;
+
+  if(q > NUMBER_POW5_MAX)
+    return 0x7FFULL << 52;
+
+  u32 lz = bits_clz_u64(w);
+
+  w <<= lz;
+
+  // the top bits of w * 5^q; the low word of 5^q only matters when the
+  // bits below the 54 that are kept could carry into them
+
+  u32 index = 2U * (u32)(q - NUMBER_POW5_MIN);
+  u64 hi;
+  u64 lo = number_mul_u64(w, number_pow5_128[index], &hi);
+
+  if((hi & 0x1FFU) == 0x1FFU) {
+    u64 carry;
+
+    number_mul_u64(w, number_pow5_128[index + 1U], &carry);
+    lo += carry;
+
+    if(carry > lo)
+      ++hi;
+  }
+
+  // 54 bits of significand, one more than an f64 keeps, for rounding
+
+  u32 upper = (u32)(hi >> 63);
+  u32 shift = upper + 9U;
+  u64 mantissa = hi >> shift;
+
+  // floor(log2(10^q)) + 63 is the exponent of the product's top bit, biased by 1023
+  i32 power2 = ((217706 * q) >> 16) + 63 + (i32)upper - (i32)lz + 1023;
+
+  if(power2 <= 0) {
+    // subnormal, or rounds up to the smallest normal
+    if(1 - power2 >= 64)
+      return 0U;
+
+    mantissa >>= 1 - power2;
+    mantissa += mantissa & 1U;
+    mantissa >>= 1;
+
+    power2 = (mantissa < (1ULL << 52)) ? 0 : 1;
+
+    return ((u64)power2 << 52) | (mantissa & ((1ULL << 52) - 1U));
+  }
+
+  // exactly halfway between two f64s, which only happens for small q: round to even
+
+  if(lo <= 1U && q >= -4 && q <= 23 && (mantissa & 3U) == 1U && (mantissa << shift) == hi)
+    mantissa &= ~1ULL;
+
+  mantissa += mantissa & 1U;
+  mantissa >>= 1;
+
+  if(mantissa >= (2ULL << 52)) {
+    mantissa = 1ULL << 52;
+    ++power2;
+  }
+
+  if(power2 >= 0x7FF)
+    return 0x7FFULL << 52;
+
+  return ((u64)power2 << 52) | (mantissa & ((1ULL << 52) - 1U));
+}
+
+inline
+u64 number_strtod_bits(const char* p, u32 count) {
+  char buffer[NUMBER_FALLBACK_BUFFER];
+  char* copy = (count < NUMBER_FALLBACK_BUFFER) ? buffer : (char*)malloc(count + 1U);
+
+  memcpy(copy, p, count);
+  copy[count] = 0;
+
+  f64 value = strtod(copy, 0);
+  u64 result;
+
+  memcpy(&result, &value, sizeof(u64));
+
+  if(copy != buffer)
+    free(copy);
+
+  return result;
+}
+
+// appends up to NUMBER_MAX_DIGITS significant digits of a run of count
+// digits to *w; returns the number of digits appended, leading zeros of
+// the number included, and sets *dropped when a digit left out isn't 0
+
+inline
+u32 number_append_digits(const char* p, u32 count, u64* w, u32* significant, bool* dropped) {
+  u32 result = (*significant == 0U) ? number_skip_zeros(p, count) : 0U;
+  u32 take = MINIMUM(count - result, NUMBER_MAX_DIGITS - *significant);
+
+  *w = *w * number_pow10_u64[take] + number_parse_digits(p + result, take);
+  *significant += take;
+  result += take;
+
+  for(u32 i = result; i < count; ++i)
+    *dropped = *dropped || p[i] != '0';
+
+  return result;
+}
+
+// the value of digits '.' digits, returns NUMBER_OVERFLOW when it's infinite
+
+inline
+u32 number_decode_float(const char* p, u32 count, f64* value) {
+  u32 dot = 0U;
+
+  while(dot < count && p[dot] != '.')
+    ++dot;
+
+  u32 fraction = (dot < count) ? dot + 1U : count;
+  u64 w = 0U;
+  u32 significant = 0U;
+  bool dropped = false;
+
+  // integer digits that don't fit scale w up, fraction digits that fit scale it down
+
+  u32 integer_taken = number_append_digits(p, dot, &w, &significant, &dropped);
+  u32 fraction_taken = number_append_digits(p + fraction, count - fraction, &w, &significant, &dropped);
+  i32 q = (i32)(dot - integer_taken) - (i32)fraction_taken;
+
+  u64 bits;
+
+  if(w == 0U) {
+    bits = 0U;
+  } else if(!dropped && q >= -22 && q <= 22 && w <= (1ULL << 53)) {
+    f64 v = (f64)w;
+
+    v = (q < 0) ? v / number_pow10_f64[-q] : v * number_pow10_f64[q];
+    memcpy(&bits, &v, sizeof(u64));
+  } else {
+    bits = number_eisel_lemire(w, q);
+
+    if(dropped && number_eisel_lemire(w + 1U, q) != bits)
+      bits = number_strtod_bits(p, count);
+  }
+
+  memcpy(value, &bits, sizeof(f64));
+
+  return (bits == (0x7FFULL << 52)) ? NUMBER_OVERFLOW : 0U;
+}
+
+// decodes a numeric literal token into *value, the bits of the f64 for a float; returns its flags
+
+inline
+u32 number_decode_token(u32 tag, cstring str, u32 start, u32 length, u64* value) {
+  u32 result = 0U;
+
+  if(tag == token_tag_integer_literal) {
+    result = number_decode_integer(str + start, length, value);
+  } else if(tag == token_tag_hex_literal) {
+    result = number_decode_hex(str + start, length, value);
+  } else {
+    f64 v;
+
+    result = number_decode_float(str + start, length, &v);
+    memcpy(value, &v, sizeof(u64));
+  }
+
+  return result;
+}
+
+inline
+bool is_numeric_literal(u32 tag) {
+  return tag == token_tag_integer_literal || tag == token_tag_hex_literal || tag == token_tag_float_literal;
+}
+
+//
+// the side table
+//
+
+inline
+number_table make_number_table(arena ma, u32 capacity) {
+  number_table result;
+
+  result.values   = (u64*)arena_alloc(ma, capacity * sizeof(u64));
+  result.flags    = (u8*)arena_alloc(ma, capacity * sizeof(u8));
+  result.capacity = capacity;
+
+  return result;
+}
+
+// grows the table to capacity entries, keeping the first count
+
+inline
+void number_table_grow(arena ma, number_table* numbers, u32 count, u32 capacity) {
+  number_table grown = make_number_table(ma, capacity);
+
+  memcpy(grown.values, numbers->values, count * sizeof(u64));
+  memcpy(grown.flags, numbers->flags, count * sizeof(u8));
+
+  *numbers = grown;
+}
+
+inline
+void number_table_set(number_table* numbers, u32 id, const token* tok, cstring str) {
+  u64 value;
+
+  numbers->flags[id]  = (u8)number_decode_token(tok->tag, str, tok->start, tok->length, &value);
+  numbers->values[id] = value;
+}
+
+inline
+u64 number_u64(const number_table* numbers, u32 id) {
+  return numbers->values[id];
+}
+
+inline
+f64 number_f64(const number_table* numbers, u32 id) {
+  f64 result;
+
+  memcpy(&result, numbers->values + id, sizeof(f64));
+
+  return result;
+}
+
+inline
+bool number_overflow(const number_table* numbers, u32 id) {
+  return (numbers->flags[id] & NUMBER_OVERFLOW) != 0U;
+}
+
+// lex_all, decoding the numeric literals into numbers as they are lexed;
+// the table is allocated in lex->ma with the buffer's capacity
+
+inline
+token_buffer lex_all(lexer_state* lex, number_table* numbers) {
+  token_buffer result = make_token_buffer(lex->ma, lex->str_len / LEXER_BYTES_PER_TOKEN + 16U);
+  token tok;
+
+  *numbers = make_number_table(lex->ma, result.capacity);
+
+  while(lexer_next(lex, &tok)) {
+    push_token(lex->ma, &result, &tok);
+
+    if(is_numeric_literal(tok.tag)) {
+      if(numbers->capacity < result.capacity)
+        number_table_grow(lex->ma, numbers, result.count - 1U, result.capacity);
+
+      number_table_set(numbers, result.count - 1U, &tok, lex->str);
+    }
+  }
+
+  return result;
+}
+
+inline
+token_buffer lex_all(arena ma, interner* names, number_table* numbers, cstring str, u32 str_len) {
+  lexer_state lex;
+
+  lex.str          = str;
+  lex.str_len      = str_len;
+  lex.pos          = 0;
+  lex.ma           = ma;
+  lex.lines        = 0;
+  lex.names        = names;
+  lex.shared_names = 0;
+
+  return lex_all(&lex, numbers);
+}
+
+// decodes the numeric literals of tokens lexed some other way, by
+// lex_all_parallel or after a relex
+
+inline
+number_table decode_numbers(arena ma, const token_buffer* tokens, cstring str) {
+  number_table result = make_number_table(ma, tokens->count + 1U);
+  token tok;
+
+  for(u32 id = 0U; id < tokens->count; ++id) {
+    if(is_numeric_literal(tokens->tags[id])) {
+      tok.tag    = tokens->tags[id];
+      tok.start  = tokens->starts[id];
+      tok.length = tokens->lengths[id];
+      tok.symbol = INTERN_NONE;
+
+      number_table_set(&result, id, &tok, str);
+    }
+  }
+
+  return result;
+}
+
+#endif
@@ -0,0 +1,276 @@
+/**
+ *  lexer_parallel.h
+ *
+ *  Lexing a large source on several threads, into the same tokens as lex_all.
+ *
+ *  The source is cut into one chunk per thread at newlines outside string
+ *  and char literals. No token spans such a newline, so the serial lexer
+ *  is between two tokens there as well and every chunk can be lexed on its
+ *  own.
+ *
+ *  Whether a newline is inside a literal depends on all of the source
+ *  before it, so the cuts are found speculatively: every thread scans a
+ *  region of the source for quotes, backslashes and newlines, tracking the
+ *  literal state for each of the lexer_quote_state_count states the region
+ *  could start in side by side. For each start state a region records its
+ *  end state and its first newline outside literals. A serial pass then
+ *  chains the end states from the start of the source and picks the cuts.
+ *
+ *  Every chunk is lexed in place, so token starts stay absolute, into a
+ *  buffer in a system arena of its own, sized like lex_all's for one token
+ *  per LEXER_BYTES_PER_TOKEN bytes. A denser chunk moves its buffer into a
+ *  new arena of twice the size and frees the old one, so a chunk holds at
+ *  most one buffer at a time. The buffers are concatenated at offsets from
+ *  a prefix sum of their token counts.
+ *  The serial lexer ends at a null character outside literals, so the
+ *  chunks after the one that stops at it are dropped.
+ *
+ *  With a sharded_interner the identifiers are interned concurrently. The
+ *  occurrences of a name share a symbol, but the ids differ from a serial
+ *  run's.
+ */
+
+#ifndef CPEAK_LEXER_PARALLEL_H
+#define CPEAK_LEXER_PARALLEL_H
+
+#include "types.h"
+#include "macro.h"
+#include "arena.h"
+#include "bits.h"
+#include "lexer.h"
+#include "parallel.h"
+
+// sources with less than this per thread use fewer threads
+
+#ifndef LEXER_PARALLEL_MIN_CHUNK
+#define LEXER_PARALLEL_MIN_CHUNK (1U << 20)
+#endif
+
+#define LEXER_NO_SPLIT 0xFFFFFFFFU
+
+enum lexer_quote_state {
+  lexer_quote_out,
+  lexer_quote_string,
+  lexer_quote_string_escape,
+  lexer_quote_char,
+  lexer_quote_char_escape,
+
+  lexer_quote_state_count,
+};
+
+// next state by state and byte class: other, '"', '\'', '\\'
+
+static const u8 lexer_quote_next[lexer_quote_state_count][4] = {
+  { lexer_quote_out,    lexer_quote_string, lexer_quote_char,   lexer_quote_out           },
+  { lexer_quote_string, lexer_quote_out,    lexer_quote_string, lexer_quote_string_escape },
+  { lexer_quote_string, lexer_quote_string, lexer_quote_string, lexer_quote_string        },
+  { lexer_quote_char,   lexer_quote_char,   lexer_quote_out,    lexer_quote_char_escape   },
+  { lexer_quote_char,   lexer_quote_char,   lexer_quote_char,   lexer_quote_char          },
+};
+
+typedef struct lexer_region {
+  u8  end_state[lexer_quote_state_count];
+  u32 split[lexer_quote_state_count]; // just past the first newline outside literals, LEXER_NO_SPLIT if none
+} lexer_region;
+
+inline
+u32 lexer_quote_class(char c) {
+  return (c == '\"') ? 1U : (c == '\'') ? 2U : (c == '\\') ? 3U : 0U;
+}
+
+inline
+bool lexer_quote_special(char c) {
+  return c == '\n' || lexer_quote_class(c) != 0U;
+}
+
+// advances every start state's literal state over the byte at pos
+
+inline
+void lexer_quote_step(lexer_region* r, u8* states, cstring str, u32 pos) {
+  char c = str[pos];
+
+  if(c == '\n') {
+    for(u32 s = 0U; s < lexer_quote_state_count; ++s) {
+      if(states[s] == lexer_quote_out && r->split[s] == LEXER_NO_SPLIT)
+        r->split[s] = pos + 1U;
+    }
+  }
+
+  u32 k = lexer_quote_class(c);
+
+  for(u32 s = 0U; s < lexer_quote_state_count; ++s)
+    states[s] = lexer_quote_next[states[s]][k];
+}
+
+// only the special bytes change a state, and the byte after a backslash,
+// which ends the escape states
+
+inline
+void lexer_quote_special_step(lexer_region* r, u8* states, cstring str, u32 pos, u32 end) {
+  lexer_quote_step(r, states, str, pos);
+
+  if(str[pos] == '\\' && pos + 1U < end && !lexer_quote_special(str[pos + 1U]))
+    lexer_quote_step(r, states, str, pos + 1U);
+}
+
+inline
+lexer_region lexer_scan_region(cstring str, u32 begin, u32 end) {
+  lexer_region result;
+  u8 states[lexer_quote_state_count];
+
+  for(u32 s = 0U; s < lexer_quote_state_count; ++s) {
+    states[s] = (u8)s;
+    result.split[s] = LEXER_NO_SPLIT;
+  }
+
+  u32 pos = begin;
+
+  // a region can start right after a backslash, in the escape states its
+  // first byte is consumed even when it isn't special
+
+  if(pos < end && !lexer_quote_special(str[pos]))
+    lexer_quote_step(&result, states, str, pos);
+
+#if defined(LEXER_BLOCK)
+  while(pos + LEXER_BLOCK <= end) {
+    const char* p = str + pos;
+    u32 special = lexer_byte_mask(p, '\n') | lexer_byte_mask(p, '\"') | lexer_byte_mask(p, '\'') | lexer_byte_mask(p, '\\');
+
+    while(special != 0U) {
+      lexer_quote_special_step(&result, states, str, pos + bits_ctz_u32(special), end);
+      special &= special - 1U;
+    }
+
+    pos += LEXER_BLOCK;
+  }
+#endif
+
+  for(; pos < end; ++pos) {
+    if(lexer_quote_special(str[pos]))
+      lexer_quote_special_step(&result, states, str, pos, end);
+  }
+
+  for(u32 s = 0U; s < lexer_quote_state_count; ++s)
+    result.end_state[s] = states[s];
+
+  return result;
+}
+
+// lexes str on up to thread_count threads, interning into names when it isn't null
+
+inline
+token_buffer lex_all_parallel(arena ma, sharded_interner* names, cstring str, u32 str_len, u32 thread_count) {
+  thread_count = parallel_thread_count_for(str_len, thread_count, LEXER_PARALLEL_MIN_CHUNK);
+
+  if(thread_count == 1U)
+    return names ? lex_all(ma, names, str, str_len) : lex_all(ma, str, str_len);
+
+  lexer_region regions[PARALLEL_MAX_THREADS];
+  u32 cuts[PARALLEL_MAX_THREADS + 1U];
+
+  parallel_for_ranges(thread_count, str_len, [&](u32 t, size_type begin, size_type end) {
+    regions[t] = lexer_scan_region(str, (u32)begin, (u32)end);
+  });
+
+  // the real state at the start of every region, and the first newline outside literals from there on
+
+  u32 state = lexer_quote_out;
+  u8 start_states[PARALLEL_MAX_THREADS];
+
+  for(u32 t = 0U; t < thread_count; ++t) {
+    start_states[t] = (u8)state;
+    state = regions[t].end_state[state];
+  }
+
+  cuts[0] = 0U;
+  cuts[thread_count] = str_len;
+
+  for(u32 t = 1U; t < thread_count; ++t) {
+    u32 cut = str_len;
+
+    for(u32 r = t; r < thread_count; ++r) {
+      if(regions[r].split[start_states[r]] != LEXER_NO_SPLIT) {
+        cut = regions[r].split[start_states[r]];
+        break;
+      }
+    }
+
+    cuts[t] = cut;
+  }
+
+  // every chunk into its own buffer
+
+  arena chunk_arenas[PARALLEL_MAX_THREADS];
+  token_buffer chunks[PARALLEL_MAX_THREADS];
+  bool stopped[PARALLEL_MAX_THREADS];
+
+  parallel_run(thread_count, [&](u32 t) {
+    u32 capacity = (cuts[t + 1U] - cuts[t]) / LEXER_BYTES_PER_TOKEN + 16U;
+    lexer_state lex;
+    token tok;
+
+    chunk_arenas[t] = make_token_arena(capacity);
+    chunks[t] = make_token_buffer(chunk_arenas[t], capacity);
+
+    lex.str          = str;
+    lex.str_len      = cuts[t + 1U];
+    lex.pos          = cuts[t];
+    lex.ma           = chunk_arenas[t];
+    lex.lines        = 0;
+    lex.names        = 0;
+    lex.shared_names = names;
+
+    while(lexer_next(&lex, &tok)) {
+      if(chunks[t].count == chunks[t].capacity) {
+        token_buffer_grow(&chunk_arenas[t], &chunks[t]);
+        lex.ma = chunk_arenas[t];
+      }
+
+      push_token(lex.ma, &chunks[t], &tok);
+    }
+
+    stopped[t] = lex.pos < lex.str_len;
+  });
+
+  // stitch the buffers together
+
+  u32 offsets[PARALLEL_MAX_THREADS];
+  u32 count = 0U;
+  u32 chunk_count = thread_count;
+
+  for(u32 t = 0U; t < thread_count; ++t) {
+    offsets[t] = count;
+    count += chunks[t].count;
+
+    if(stopped[t]) {
+      chunk_count = t + 1U;
+      break;
+    }
+  }
+
+  token_buffer result = make_token_buffer(ma, count + 16U);
+
+  parallel_run(chunk_count, [&](u32 t) {
+    const token_buffer* b = &chunks[t];
+    u32 offset = offsets[t];
+
+    memcpy(result.tags + offset, b->tags, b->count * sizeof(u8));
+    memcpy(result.starts + offset, b->starts, b->count * sizeof(u32));
+    memcpy(result.lengths + offset, b->lengths, b->count * sizeof(u32));
+    memcpy(result.symbols + offset, b->symbols, b->count * sizeof(u32));
+  });
+
+  result.count = count;
+
+  for(u32 t = 0U; t < thread_count; ++t)
+    free_system_arena(chunk_arenas[t]);
+
+  return result;
+}
+
+inline
+token_buffer lex_all_parallel(arena ma, cstring str, u32 str_len, u32 thread_count) {
+  return lex_all_parallel(ma, 0, str, str_len, thread_count);
+}
+
+#endif
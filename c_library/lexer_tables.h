@@ -0,0 +1,189 @@
+// generated by lexer_gen from tokens.txt, do not edit
+
+#ifndef CPEAK_LEXER_TABLES_H
+#define CPEAK_LEXER_TABLES_H
+
+#define LEXER_OP_CLASS_COUNT 26U
+#define LEXER_OP_STATE_COUNT 46U
+#define LEXER_OP_START       1U
+
+static const u8 lexer_op_class[256] = {
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0, 13,  0, 14, 15,  5,  7,  0, 16, 17,  3,  1, 24,  2, 25,  4,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 10, 23, 11,  6, 12, 22,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 18,  0, 19,  9,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 20,  8, 21,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+};
+
+static const u8 lexer_op_next[LEXER_OP_STATE_COUNT * LEXER_OP_CLASS_COUNT] = {
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  2,  3,  4,  5,  6, 18, 12, 14, 16, 19, 21, 25, 28, 32, 33, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45,
+   0,  0,  0,  0,  0,  0,  7,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  8,  0,  0,  0,  0,  0, 23,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  9,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0, 10,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0, 11,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0, 13, 34,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0, 15,  0, 35,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0, 17,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0, 27,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0, 20,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0, 22,  0,  0,  0, 30,  0,  0,  0,  0, 24,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0, 31,  0,  0,  0,  0,  0, 26,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0, 29,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+};
+
+static const u8 lexer_op_tag[LEXER_OP_STATE_COUNT] = {
+  token_tag_invalid,
+  token_tag_invalid,
+  token_tag_op_add, // +
+  token_tag_op_sub, // -
+  token_tag_op_mul, // *
+  token_tag_op_div, // /
+  token_tag_op_mod, // %
+  token_tag_op_add_assignment, // +=
+  token_tag_op_sub_assignment, // -=
+  token_tag_op_mul_assignment, // *=
+  token_tag_op_div_assignment, // /=
+  token_tag_op_mod_assignment, // %=
+  token_tag_op_ref, // &
+  token_tag_op_bit_and_assignment, // &=
+  token_tag_op_bit_or, // |
+  token_tag_op_bit_or_assignment, // |=
+  token_tag_op_xor, // ^
+  token_tag_op_xor_assignment, // ^=
+  token_tag_op_assignment, // =
+  token_tag_op_colon, // :
+  token_tag_op_decl_assignment, // :=
+  token_tag_op_less_than, // <
+  token_tag_op_left_arrow, // <-
+  token_tag_op_right_arrow, // ->
+  token_tag_op_left_shift, // <<
+  token_tag_op_greater_than, // >
+  token_tag_op_right_shift, // >>
+  token_tag_op_equality, // ==
+  token_tag_op_not, // !
+  token_tag_op_inequality, // !=
+  token_tag_op_less_than_or_equal, // <=
+  token_tag_op_greater_than_or_equal, // >=
+  token_tag_op_hash, // #
+  token_tag_op_dollar, // $
+  token_tag_op_and, // &&
+  token_tag_op_or, // ||
+  token_tag_op_left_param, // (
+  token_tag_op_right_param, // )
+  token_tag_op_left_bracket, // [
+  token_tag_op_right_bracket, // ]
+  token_tag_op_left_brace, // {
+  token_tag_op_right_brace, // }
+  token_tag_op_question, // ?
+  token_tag_op_semicolon, // ;
+  token_tag_op_comma, // ,
+  token_tag_op_dot, // .
+};
+
+#define LEXER_KEYWORD_SLOTS      16U
+#define LEXER_KEYWORD_MUL_FIRST  1U
+#define LEXER_KEYWORD_MUL_LAST   6U
+#define LEXER_KEYWORD_MAX_LENGTH 9U
+
+static const u8 lexer_keyword_length[LEXER_KEYWORD_SLOTS] = {
+  9,
+  6,
+  0,
+  0,
+  0,
+  7,
+  0,
+  6,
+  6,
+  0,
+  5,
+  3,
+  0,
+  0,
+  0,
+  2,
+};
+
+static const char lexer_keyword_text[LEXER_KEYWORD_SLOTS][LEXER_KEYWORD_MAX_LENGTH + 1U] = {
+  "interface",
+  "struct",
+  "",
+  "",
+  "",
+  "variant",
+  "",
+  "import",
+  "lambda",
+  "",
+  "while",
+  "def",
+  "",
+  "",
+  "",
+  "if",
+};
+
+static const u8 lexer_keyword_tag[LEXER_KEYWORD_SLOTS] = {
+  token_tag_interface,
+  token_tag_struct,
+  token_tag_identifier,
+  token_tag_identifier,
+  token_tag_identifier,
+  token_tag_variant,
+  token_tag_identifier,
+  token_tag_import,
+  token_tag_lambda,
+  token_tag_identifier,
+  token_tag_while,
+  token_tag_def,
+  token_tag_identifier,
+  token_tag_identifier,
+  token_tag_identifier,
+  token_tag_if,
+};
+
+#endif
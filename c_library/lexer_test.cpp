@@ -1,5 +1,12 @@
 
+// small chunks so that the short test source is split between threads
+
+#define LEXER_PARALLEL_MIN_CHUNK 256U
+
 #include "lexer.h"
+#include "lexer_parallel.h"
+#include "lexer_incremental.h"
+#include "lexer_numbers.h"
 
 token_ptr process_next(lexer_state* lex) {
   token_ptr tok = lexer_process(lex);
@@ -10,7 +17,9 @@ token_ptr process_next(lexer_state* lex) {
 
   fflush(stdout);
 
-  printf("row: %u, col: %u.\n", lex->row, lex->col);
+  source_location loc = lexer_locate(lex, lex->pos);
+
+  printf("row: %u, col: %u.\n", loc.row, loc.col);
 
   fflush(stdout);
 
@@ -36,6 +45,277 @@ int main(int argc, void** argv) {
     tok = process_next(lex);
   } while(tok);
 
+  // the same and some characters that don't start a token, lexed all at once
+
+  const char str_all[] =
+    "0xdeadbeef (05.5 + 7) / 2 \n"
+    "@ \"galttjosan\" ~ \'a\'";
+
+  token_buffer tokens = lex_all(a, str_all, sizeof(str_all));
+
+  printf("%u tokens, capacity %u\n", tokens.count, tokens.capacity);
+
+  for(u32 id = 0; id < tokens.count; ++id) {
+    print_token(&tokens, id, str_all);
+    printf("\n");
+  }
+
+  // every operator of tokens.txt, maximal munch
+
+  const char str_ops[] =
+    "+ - * / % += -= *= /= %= &= |= ^= ^ = := <- -> << >> == != ! < > <= >= # $ & && | || "
+    "( ) [ ] { } ? : ; , . a:=b<-c->d<<=e&&&f|||g";
+
+  tokens = lex_all(a, str_ops, sizeof(str_ops));
+
+  for(u32 id = 0; id < tokens.count; ++id) {
+    print_token(&tokens, id, str_ops);
+    printf("\n");
+  }
+
+  // keywords and identifiers that share a keyword's hash inputs
+
+  const char str_idents[] =
+    "def struct if while import variant interface lambda "
+    "define iff whilst imp0rt _variant Interface lambda_ x x1 _ de_f f00";
+
+  interner names = make_interner(a, 64U);
+
+  tokens = lex_all(a, &names, str_idents, sizeof(str_idents));
+
+  for(u32 id = 0; id < tokens.count; ++id) {
+    print_token(&tokens, id, str_idents);
+    printf(" symbol: %d\n", (i32)tokens.symbols[id]);
+  }
+
+  // lexing it again finds the same symbols
+
+  token_buffer again = lex_all(a, &names, str_idents, sizeof(str_idents));
+  bool same = again.count == tokens.count;
+
+  for(u32 id = 0; same && id < tokens.count; ++id)
+    same = again.symbols[id] == tokens.symbols[id];
+
+  printf("%u symbols, same symbols: %d\n", names.count, same);
+
+  // parallel lexing, with newlines inside the literals where a chunk can't be cut
+
+  const char str_line[] =
+    "def f(x: i32) { s := \"a \\\" \n b\"; c := '\\''; y := x << 0x1f + 2.5 }\n";
+
+  u32 str_par_len = 64U * (sizeof(str_line) - 1U);
+  char* str_par = (char*)arena_alloc(a, str_par_len);
+
+  for(u32 i = 0; i < 64U; ++i)
+    memcpy(str_par + i * (sizeof(str_line) - 1U), str_line, sizeof(str_line) - 1U);
+
+  token_buffer serial = lex_all(a, str_par, str_par_len);
+  token_buffer parallel = lex_all_parallel(a, str_par, str_par_len, 4U);
+  bool identical = serial.count == parallel.count;
+
+  for(u32 id = 0; identical && id < serial.count; ++id) {
+    identical = serial.tags[id] == parallel.tags[id] && serial.starts[id] == parallel.starts[id] &&
+                serial.lengths[id] == parallel.lengths[id];
+  }
+
+  printf("%u tokens, parallel identical: %d\n", serial.count, identical);
+
+  // a region that starts right after a backslash in a literal, the escaped
+  // byte is the first of the region, and a newline inside a later literal
+
+  u32 str_esc_len = 1024U;
+  char* str_esc = (char*)arena_alloc(a, str_esc_len);
+
+  for(u32 i = 0; i < str_esc_len; ++i)
+    str_esc[i] = (i % 32U == 31U) ? '\n' : "x + "[i % 4U];
+
+  memcpy(str_esc + 250U, "\"abcd\\n\"", 8U);
+  memcpy(str_esc + 300U, "\"p\nq\"", 5U);
+
+  token_buffer serial_esc = lex_all(a, str_esc, str_esc_len);
+  token_buffer parallel_esc = lex_all_parallel(a, str_esc, str_esc_len, 4U);
+  bool identical_esc = serial_esc.count == parallel_esc.count;
+
+  for(u32 id = 0; identical_esc && id < serial_esc.count; ++id)
+    identical_esc = serial_esc.tags[id] == parallel_esc.tags[id] && serial_esc.starts[id] == parallel_esc.starts[id];
+
+  // random sources of quotes, backslashes, newlines and nulls between other bytes
+
+  u32 fuzz_mismatches = 0U;
+  u32 fuzz_state = 777U;
+  char* str_fuzz = (char*)arena_alloc(a, 600U);
+  u32 fuzz_threads[] = { 2U, 5U, 8U };
+
+  for(u32 run = 0; run < 3000U; ++run) {
+    for(u32 i = 0; i < 600U; ++i) {
+      fuzz_state = fuzz_state * 1664525U + 1013904223U;
+
+      u32 r = (fuzz_state >> 16) % 64U;
+      str_fuzz[i] = (r < 3U) ? '\"' : (r < 5U) ? '\'' : (r < 8U) ? '\\' : (r < 11U) ? '\n' : (r < 12U && run % 4U == 0U) ? 0 : "ab 1+"[r % 5U];
+    }
+
+    arena_push(a);
+
+    token_buffer serial_fuzz = lex_all(a, str_fuzz, 600U);
+    token_buffer parallel_fuzz = lex_all_parallel(a, str_fuzz, 600U, fuzz_threads[run % 3U]);
+    bool same_fuzz = serial_fuzz.count == parallel_fuzz.count;
+
+    for(u32 id = 0; same_fuzz && id < serial_fuzz.count; ++id)
+      same_fuzz = serial_fuzz.tags[id] == parallel_fuzz.tags[id] && serial_fuzz.starts[id] == parallel_fuzz.starts[id];
+
+    fuzz_mismatches += same_fuzz ? 0U : 1U;
+    arena_pop(a);
+  }
+
+  printf("%u tokens, cut after a backslash identical: %d; random sources, mismatches: %u of 3000\n", serial_esc.count,
+         identical_esc, fuzz_mismatches);
+
+  // a token per byte, denser than the chunk buffers are sized for, so they grow
+
+  u32 str_dense_len = 4096U;
+  char* str_dense = (char*)arena_alloc(a, str_dense_len);
+
+  for(u32 i = 0; i < str_dense_len; ++i)
+    str_dense[i] = (i % 64U == 63U) ? '\n' : "(+)"[i % 3U];
+
+  token_buffer serial_dense = lex_all(a, str_dense, str_dense_len);
+  token_buffer parallel_dense = lex_all_parallel(a, str_dense, str_dense_len, 4U);
+  bool identical_dense = serial_dense.count == parallel_dense.count;
+
+  for(u32 id = 0; identical_dense && id < serial_dense.count; ++id)
+    identical_dense = serial_dense.tags[id] == parallel_dense.tags[id] && serial_dense.starts[id] == parallel_dense.starts[id];
+
+  printf("%u dense tokens, parallel identical: %d\n", serial_dense.count, identical_dense);
+
+  // many distinct names interned in parallel, the 4 KB shard arenas grow into system arenas
+
+  u32 str_names_len = 0U;
+  char* str_names = (char*)arena_alloc(a, 5000U * 12U);
+
+  for(u32 i = 0; i < 5000U; ++i)
+    str_names_len += (u32)sprintf(str_names + str_names_len, "name_%u%c", i, (i % 8U == 7U) ? '\n' : ' ');
+
+  sharded_interner* shared = make_sharded_interner(a, 4096U, 64U);
+  token_buffer named = lex_all_parallel(a, shared, str_names, str_names_len, 4U);
+  token_buffer named_again = lex_all(a, shared, str_names, str_names_len);
+  bool interned = named.count == 5000U && named_again.count == 5000U && symbol_count(shared) == 5000U;
+
+  for(u32 id = 0; interned && id < named.count; ++id) {
+    string_slice s = intern_string(shared, named.symbols[id]);
+
+    interned = named.symbols[id] == named_again.symbols[id] && s.length == named.lengths[id] &&
+               memcmp(s.ptr, str_names + named.starts[id], s.length) == 0;
+  }
+
+  printf("%u names interned in parallel, same symbols and strings: %d\n", symbol_count(shared), interned);
+  free_sharded_interner(shared);
+
+  // relexing after an edit, "x := 0x1f" -> "x := 0x1ff" and a string literal opened in front of it
+
+  const char str_before[] = "a := b + c\nx := 0x1f\ny := \"s\" - 1\n";
+  const char str_edit_1[] = "a := b + c\nx := 0x1ff\ny := \"s\" - 1\n";
+  const char str_edit_2[] = "a := b + c\"\nx := 0x1ff\ny := \"s\" - 1\n";
+
+  token_buffer edited = lex_all(a, &names, str_before, sizeof(str_before) - 1U);
+  lexer_edit edit_1 = { 20U, 0U, 1U };
+  lexer_edit edit_2 = { 10U, 0U, 1U };
+
+  u32 relexed_1 = relex(a, &names, &edited, str_edit_1, sizeof(str_edit_1) - 1U, edit_1);
+  u32 count_1 = edited.count;
+  token_buffer expected_1 = lex_all(a, &names, str_edit_1, sizeof(str_edit_1) - 1U);
+  bool same_1 = edited.count == expected_1.count;
+
+  for(u32 id = 0; same_1 && id < edited.count; ++id)
+    same_1 = edited.starts[id] == expected_1.starts[id] && edited.lengths[id] == expected_1.lengths[id];
+
+  u32 relexed_2 = relex(a, &names, &edited, str_edit_2, sizeof(str_edit_2) - 1U, edit_2);
+  token_buffer expected_2 = lex_all(a, &names, str_edit_2, sizeof(str_edit_2) - 1U);
+  bool same_2 = edited.count == expected_2.count;
+
+  for(u32 id = 0; same_2 && id < edited.count; ++id)
+    same_2 = edited.starts[id] == expected_2.starts[id] && edited.lengths[id] == expected_2.lengths[id];
+
+  printf("relexed %u of %u tokens, same: %d; relexed %u of %u tokens, same: %d\n",
+         relexed_1, count_1, same_1, relexed_2, edited.count, same_2);
+
+  // edits back and forth leave nothing in the arena while the buffer has room
+
+  char str_toggle[] = "a := b + c\nx := 0x1f\ny := \"s\" - 1\n";
+  token_buffer toggled = lex_all(a, &names, str_toggle, sizeof(str_toggle) - 1U);
+  lexer_edit edit_toggle = { 18U, 1U, 1U };
+  usize tail_before = a->tail;
+
+  for(u32 i = 0; i < 1000U; ++i) {
+    str_toggle[18] = (i & 1U) ? '1' : '2';
+    relex(a, &names, &toggled, str_toggle, sizeof(str_toggle) - 1U, edit_toggle);
+  }
+
+  bool unchanged = tail_before == a->tail;
+
+  // an edit that adds more tokens than the staging and the buffer hold, so both grow
+
+  u32 str_inserted_len = 0U;
+  char* str_inserted = (char*)arena_alloc(a, 4096U);
+  u32 insert_at = 11U;
+
+  memcpy(str_inserted, str_toggle, insert_at);
+  str_inserted_len = insert_at;
+
+  for(u32 i = 0; i < 300U; ++i)
+    str_inserted_len += (u32)sprintf(str_inserted + str_inserted_len, "z%u + ", i);
+
+  lexer_edit edit_insert = { insert_at, 0U, str_inserted_len - insert_at };
+
+  memcpy(str_inserted + str_inserted_len, str_toggle + insert_at, sizeof(str_toggle) - 1U - insert_at);
+  str_inserted_len += sizeof(str_toggle) - 1U - insert_at;
+
+  u32 relexed_3 = relex(a, &names, &toggled, str_inserted, str_inserted_len, edit_insert);
+  token_buffer expected_3 = lex_all(a, &names, str_inserted, str_inserted_len);
+  bool same_3 = toggled.count == expected_3.count;
+
+  for(u32 id = 0; same_3 && id < toggled.count; ++id) {
+    same_3 = toggled.starts[id] == expected_3.starts[id] && toggled.lengths[id] == expected_3.lengths[id] &&
+             toggled.symbols[id] == expected_3.symbols[id];
+  }
+
+  printf("1000 relexes, arena unchanged: %d; relexed %u of %u tokens, same: %d\n", unchanged, relexed_3,
+         toggled.count, same_3);
+
+  // numeric literals decoded while lexing, the last integer and hex literals overflow
+
+  const char str_numbers[] = "x := 42 + 0x1F * 3.25 - 0.1 + 123456789012345678.5 + 18446744073709551615 + 18446744073709551616 + 0x10000000000000000";
+  number_table numbers;
+  token_buffer number_tokens = lex_all(a, 0, &numbers, str_numbers, sizeof(str_numbers) - 1U);
+
+  for(u32 id = 0; id < number_tokens.count; ++id) {
+    u32 tag = number_tokens.tags[id];
+
+    if(tag == token_tag_float_literal)
+      printf("%.17g overflow: %d\n", number_f64(&numbers, id), number_overflow(&numbers, id));
+    else if(is_numeric_literal(tag))
+      printf("%llu overflow: %d\n", (unsigned long long)number_u64(&numbers, id), number_overflow(&numbers, id));
+  }
+
+  // a mapped source file, opened twice but mapped once
+
+  source_manager sources = make_source_manager(a);
+  const source_file* file = open_source(&sources, "test_code.cpk");
+
+  if(file) {
+    lexer_state* file_lex = make_lexer(a, file);
+    token tok;
+    u32 count = 0;
+
+    while(lexer_next(file_lex, &tok))
+      ++count;
+
+    printf("%s: %u bytes, %u tokens, cached: %d, padding zero: %d\n", file->path, file->length, count,
+           open_source(&sources, "test_code.cpk") == file, file->text[file->length + SOURCE_FILE_PADDING - 1U] == 0);
+  }
+
+  printf("missing file: %d\n", open_source(&sources, "no_such_file.cpk") == 0);
+
+  free_source_manager(&sources);
   free_system_arena(a);
 
   return 0;
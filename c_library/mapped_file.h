@@ -0,0 +1,183 @@
+/**
+ *  mapped_file.h
+ *
+ *  Read-only or read/write memory mappings of (parts of) files.
+ *
+ *  Offsets and sizes are always 64-bit, independent of CPEAK_64BIT, so that
+ *  files larger than 4 GB can be mapped piecewise from 32-bit size_type builds.
+ *  A failed mapping is signalled by a null 'ptr'.
+ */
+
+#ifndef CPEAK_MAPPED_FILE_H
+#define CPEAK_MAPPED_FILE_H
+
+#include "types.h"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+enum mapped_file_flags_enum {
+  mapped_file_read       = 0,
+  mapped_file_write      = 1,  // shared read/write mapping, the file must exist
+  mapped_file_populate   = 2,  // prefault all pages up front (MAP_POPULATE)
+  mapped_file_sequential = 4,  // access pattern hint: sequential (read-ahead)
+  mapped_file_random     = 8,  // access pattern hint: random (no read-ahead)
+  mapped_file_willneed   = 16, // start reading the pages in asynchronously
+};
+
+typedef struct mapped_file {
+  void* ptr;      // start of the requested range
+  u64   size;     // size of the requested range in bytes
+  void* map_base; // page-aligned start of the mapping
+  u64   map_size;
+} mapped_file;
+
+inline
+u64 mapped_file_page_size() {
+#if defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+
+  // note: views have to start at the allocation granularity, not the page size
+  return (u64)info.dwAllocationGranularity;
+#else
+  return (u64)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+// size of the file at 'path' in bytes, or ~0 if it can't be opened
+
+inline
+u64 mapped_file_size(cstring path) {
+#if defined(_WIN32)
+  WIN32_FILE_ATTRIBUTE_DATA data;
+
+  if(!GetFileAttributesExA(path, GetFileExInfoStandard, &data))
+    return ~(u64)0U;
+
+  return ((u64)data.nFileSizeHigh << 32U) | (u64)data.nFileSizeLow;
+#else
+  struct stat st;
+
+  if(stat(path, &st) != 0)
+    return ~(u64)0U;
+
+  return (u64)st.st_size;
+#endif
+}
+
+inline
+void mapped_file_advise(mapped_file m, u32 flags) {
+  if(m.map_size == 0U)
+    return;
+
+#if defined(_WIN32)
+  // no madvise equivalent for the hints, prefault by touching every page
+  if(flags & (mapped_file_populate | mapped_file_willneed)) {
+    volatile u8* byte_ptr = (volatile u8*)m.map_base;
+    u64 page = mapped_file_page_size();
+
+    for(u64 offset = 0U; offset < m.map_size; offset += page)
+      (void)byte_ptr[offset];
+  }
+#else
+  if(flags & mapped_file_sequential)
+    madvise(m.map_base, (size_t)m.map_size, MADV_SEQUENTIAL);
+  if(flags & mapped_file_random)
+    madvise(m.map_base, (size_t)m.map_size, MADV_RANDOM);
+  if(flags & mapped_file_willneed)
+    madvise(m.map_base, (size_t)m.map_size, MADV_WILLNEED);
+#endif
+}
+
+// maps 'size' bytes starting at byte 'offset' of the file, the offset doesn't need to be aligned
+
+inline
+mapped_file map_file(cstring path, u64 offset, u64 size, u32 flags) {
+  mapped_file result = { 0, 0U, 0, 0U };
+
+  u64 page = mapped_file_page_size();
+  u64 aligned_offset = offset - (offset % page);
+  u64 map_size = size + (offset - aligned_offset);
+
+  if(size == 0U || (u64)(size_t)map_size != map_size)
+    return result;
+
+  bool writable = (flags & mapped_file_write) != 0;
+
+#if defined(_WIN32)
+  HANDLE file = CreateFileA(path, writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ,
+                            FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+
+  if(file == INVALID_HANDLE_VALUE)
+    return result;
+
+  HANDLE mapping = CreateFileMappingA(file, 0, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, 0);
+  CloseHandle(file); // the mapping keeps the file open
+
+  if(mapping == 0)
+    return result;
+
+  void* base = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+                             (DWORD)(aligned_offset >> 32U), (DWORD)aligned_offset, (SIZE_T)map_size);
+  CloseHandle(mapping); // the view keeps the mapping alive
+
+  if(base == 0)
+    return result;
+#else
+  int fd = open(path, writable ? O_RDWR : O_RDONLY);
+
+  if(fd < 0)
+    return result;
+
+  int map_flags = MAP_SHARED;
+
+#if defined(MAP_POPULATE)
+  if(flags & mapped_file_populate)
+    map_flags |= MAP_POPULATE;
+#endif
+
+  void* base = mmap(0, (size_t)map_size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+                    map_flags, fd, (off_t)aligned_offset);
+  close(fd); // the mapping keeps the file open
+
+  if(base == MAP_FAILED)
+    return result;
+#endif
+
+  result.map_base = base;
+  result.map_size = map_size;
+  result.ptr      = (void*)((u8*)base + (offset - aligned_offset));
+  result.size     = size;
+
+  mapped_file_advise(result, flags);
+
+  return result;
+}
+
+inline
+void unmap_file(mapped_file* m) {
+  if(m->map_base) {
+#if defined(_WIN32)
+    UnmapViewOfFile(m->map_base);
+#else
+    munmap(m->map_base, (size_t)m->map_size);
+#endif
+  }
+
+  m->ptr = 0;
+  m->size = 0U;
+  m->map_base = 0;
+  m->map_size = 0U;
+}
+
+#endif
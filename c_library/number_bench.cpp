@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "arena.h"
+#include "array_u32_generate.h"
+#include "lexer.h"
+#include "lexer_numbers.h"
+#include "bench.h"
+
+// decoding numeric literals with lexer_numbers.h against the C library,
+// strtoull for integer and hex literals and strtod for float literals, on
+// sources of NUMBER_COUNT literals each:
+//
+//   int_short   - 1 to 6 digits
+//   int_long    - 15 to 19 digits
+//   hex         - 1 to 16 hex digits
+//   float_short - up to 8 significant digits, like 3.25 or 1024.5
+//   float_long  - random f64s in [0, 1e6) printed with 17 significant digits
+//
+// the literals are lexed once, every case then decodes all of them from
+// their token spans; lex/ and lex_numbers/ compare lex_all with and without
+// decoding during lexing. The decoded values are checked against the C
+// library before anything is timed.
+//
+// usage: number_bench [--filter substring] [--reps n] [--cpu n] [--json path]
+
+#define NUMBER_COUNT 100000U
+
+static bench_state state;
+
+enum number_set_enum {
+  number_set_int_short,
+  number_set_int_long,
+  number_set_hex,
+  number_set_float_short,
+  number_set_float_long,
+  number_set_count,
+};
+
+inline
+cstring number_set_name(u32 set) {
+  switch(set) {
+    case number_set_int_short:   return "int_short";
+    case number_set_int_long:    return "int_long";
+    case number_set_hex:         return "hex";
+    case number_set_float_short: return "float_short";
+    case number_set_float_long:  return "float_long";
+  }
+
+  return "";
+}
+
+// appends one literal of the set, made from the random bits r, to out; returns its length
+
+u32 write_literal(char* out, u32 set, u64 r) {
+  int length = 0;
+
+  switch(set) {
+    case number_set_int_short:
+      length = sprintf(out, "%llu", (unsigned long long)(r % number_pow10_u64[1U + r % 6U]));
+      break;
+    case number_set_int_long:
+      length = sprintf(out, "%llu", (unsigned long long)(r % number_pow10_u64[15U + r % 5U]));
+      break;
+    case number_set_hex:
+      length = sprintf(out, "0x%llx", (unsigned long long)(r >> (4U * (r % 16U))));
+      break;
+    case number_set_float_short:
+      length = sprintf(out, "%llu.%llu", (unsigned long long)(r % 10000U), (unsigned long long)((r >> 32) % 10000U));
+      break;
+    case number_set_float_long:
+      length = sprintf(out, "%.17g", (f64)(r >> 11) / (f64)(1ULL << 53) * 1e6);
+
+      if(strchr(out, '.') == 0 || strchr(out, 'e') != 0)
+        length = sprintf(out, "%.10f", (f64)(r >> 11) / (f64)(1ULL << 53) * 1e6);
+      break;
+  }
+
+  return (u32)length;
+}
+
+// the source of a set, literals separated by " + "
+
+cstring make_number_source(arena ma, u32 set, u32* length) {
+  char* result = (char*)arena_alloc(ma, NUMBER_COUNT * 32U);
+  u64 seed = 0x9E3779B97F4A7C15ULL + set;
+  u32 pos = 0U;
+
+  for(u32 i = 0U; i < NUMBER_COUNT; ++i) {
+    pos += write_literal(result + pos, set, philox_u64(i, seed));
+    memcpy(result + pos, " + ", 3U);
+    pos += 3U;
+  }
+
+  result[pos] = 0;
+  *length = pos;
+
+  return result;
+}
+
+// the C library's value of a numeric literal token
+
+inline
+u64 libc_decode(const token_buffer* tokens, u32 id, cstring str) {
+  cstring p = str + tokens->starts[id];
+  u64 result;
+
+  if(tokens->tags[id] == token_tag_float_literal) {
+    f64 v = strtod(p, 0);
+    memcpy(&result, &v, sizeof(u64));
+  } else {
+    result = strtoull(p, 0, (tokens->tags[id] == token_tag_hex_literal) ? 16 : 10);
+  }
+
+  return result;
+}
+
+void bench_set(arena ma, u32 set) {
+  u32 length;
+  cstring str = make_number_source(ma, set, &length);
+  token_buffer tokens = lex_all(ma, str, length);
+  number_table numbers = decode_numbers(ma, &tokens, str);
+  u32 mismatches = 0U;
+
+  for(u32 id = 0U; id < tokens.count; ++id) {
+    if(is_numeric_literal(tokens.tags[id]) && numbers.values[id] != libc_decode(&tokens, id, str))
+      ++mismatches;
+  }
+
+  printf("%s: %u literals, %u bytes, %u mismatches against the C library\n", number_set_name(set), NUMBER_COUNT, length, mismatches);
+
+  char name[BENCH_NAME_SIZE];
+
+  snprintf(name, sizeof(name), "decode/%s", number_set_name(set));
+  bench_run(&state, name, NUMBER_COUNT, length, [&]() {
+    u64 sum = 0U;
+
+    for(u32 id = 0U; id < tokens.count; ++id) {
+      if(is_numeric_literal(tokens.tags[id])) {
+        u64 value;
+
+        number_decode_token(tokens.tags[id], str, tokens.starts[id], tokens.lengths[id], &value);
+        sum += value;
+      }
+    }
+
+    bench_do_not_optimize(&sum);
+  });
+
+  snprintf(name, sizeof(name), "libc/%s", number_set_name(set));
+  bench_run(&state, name, NUMBER_COUNT, length, [&]() {
+    u64 sum = 0U;
+
+    for(u32 id = 0U; id < tokens.count; ++id) {
+      if(is_numeric_literal(tokens.tags[id]))
+        sum += libc_decode(&tokens, id, str);
+    }
+
+    bench_do_not_optimize(&sum);
+  });
+
+  snprintf(name, sizeof(name), "lex/%s", number_set_name(set));
+  bench_run(&state, name, NUMBER_COUNT, length, [&]() {
+    arena_push(ma);
+
+    token_buffer b = lex_all(ma, str, length);
+
+    bench_do_not_optimize(b.tags);
+    arena_pop(ma);
+  });
+
+  snprintf(name, sizeof(name), "lex_numbers/%s", number_set_name(set));
+  bench_run(&state, name, NUMBER_COUNT, length, [&]() {
+    arena_push(ma);
+
+    number_table n;
+    token_buffer b = lex_all(ma, 0, &n, str, length);
+
+    bench_do_not_optimize(n.values);
+    bench_do_not_optimize(b.tags);
+    arena_pop(ma);
+  });
+}
+
+int main(int argc, char** argv) {
+  bench_config config = default_bench_config();
+  cstring json_path = 0;
+
+  if(!bench_parse_args(argc, argv, &config, &json_path))
+    return 1;
+
+  bench_init(&state, config);
+
+  arena ma = make_system_arena(256ULL << 20);
+
+  for(u32 set = 0U; set < number_set_count; ++set)
+    bench_set(ma, set);
+
+  if(json_path) {
+    FILE* f = fopen(json_path, "w");
+
+    if(f) {
+      bench_write_json(&state, f);
+      fclose(f);
+    } else {
+      printf("can't write %s\n", json_path);
+    }
+  }
+
+  free_system_arena(ma);
+  bench_finish(&state);
+
+  return 0;
+}
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "macro.h"
+
+// generates number_tables.h, the powers of five for number parsing
+//
+// usage: number_gen number_tables.h
+//
+// for every q from NUMBER_POW5_MIN to NUMBER_POW5_MAX the table holds a
+// 128-bit approximation of 5^q, normalized so its top bit is set, as two
+// u64 words (high word first). 10^q is 5^q * 2^q, so the binary exponent
+// is kept apart and the table only needs the significand of 5^q.
+//
+// positive powers are truncated to their top 128 bits. For negative
+// powers the significand is 2^b / 5^-q rounded up, with b picked so the
+// quotient has at least 128 bits, then truncated to 128 bits. Rounded
+// up, a product with the table's value is never below the exact one,
+// which the Eisel-Lemire algorithm relies on.
+//
+// the arithmetic is on fixed size bigints of u32 limbs, little-endian.
+
+#define NUMBER_POW5_MIN -342
+#define NUMBER_POW5_MAX 308
+#define GEN_LIMBS       64 // 2048 bits, 2^b for the smallest power needs 1718
+
+typedef struct gen_bigint {
+  u32 limbs[GEN_LIMBS];
+} gen_bigint;
+
+void bigint_set_u32(gen_bigint* x, u32 value) {
+  memset(x->limbs, 0, sizeof(x->limbs));
+  x->limbs[0] = value;
+}
+
+void bigint_mul_u32(gen_bigint* x, u32 m) {
+  u64 carry = 0U;
+
+  for(u32 i = 0U; i < GEN_LIMBS; ++i) {
+    u64 v = (u64)x->limbs[i] * m + carry;
+
+    x->limbs[i] = (u32)v;
+    carry = v >> 32;
+  }
+
+  if(carry != 0U) {
+    printf("bigint overflow\n");
+    exit(1);
+  }
+}
+
+void bigint_add_u32(gen_bigint* x, u32 a) {
+  u64 carry = a;
+
+  for(u32 i = 0U; i < GEN_LIMBS && carry != 0U; ++i) {
+    u64 v = (u64)x->limbs[i] + carry;
+
+    x->limbs[i] = (u32)v;
+    carry = v >> 32;
+  }
+}
+
+// number of bits required to represent x
+
+u32 bigint_width(const gen_bigint* x) {
+  for(u32 i = GEN_LIMBS; i > 0U; --i) {
+    u32 limb = x->limbs[i - 1U];
+
+    if(limb != 0U) {
+      u32 width = 0U;
+
+      while(limb != 0U) {
+        ++width;
+        limb >>= 1;
+      }
+
+      return 32U * (i - 1U) + width;
+    }
+  }
+
+  return 0U;
+}
+
+bool bigint_bit(const gen_bigint* x, u32 bit) {
+  return (x->limbs[bit / 32U] >> (bit % 32U)) & 1U;
+}
+
+void bigint_set_bit(gen_bigint* x, u32 bit) {
+  x->limbs[bit / 32U] |= 1U << (bit % 32U);
+}
+
+i32 bigint_compare(const gen_bigint* a, const gen_bigint* b) {
+  for(u32 i = GEN_LIMBS; i > 0U; --i) {
+    if(a->limbs[i - 1U] != b->limbs[i - 1U])
+      return (a->limbs[i - 1U] < b->limbs[i - 1U]) ? -1 : 1;
+  }
+
+  return 0;
+}
+
+void bigint_sub(gen_bigint* a, const gen_bigint* b) {
+  u64 borrow = 0U;
+
+  for(u32 i = 0U; i < GEN_LIMBS; ++i) {
+    u64 v = (u64)a->limbs[i] - b->limbs[i] - borrow;
+
+    a->limbs[i] = (u32)v;
+    borrow = (v >> 32) & 1U;
+  }
+}
+
+void bigint_shift_left(gen_bigint* x, u32 count) {
+  gen_bigint result;
+
+  bigint_set_u32(&result, 0U);
+
+  for(u32 bit = 0U; bit + count < 32U * GEN_LIMBS; ++bit) {
+    if(bigint_bit(x, bit))
+      bigint_set_bit(&result, bit + count);
+  }
+
+  *x = result;
+}
+
+void bigint_shift_right(gen_bigint* x, u32 count) {
+  gen_bigint result;
+
+  bigint_set_u32(&result, 0U);
+
+  for(u32 bit = count; bit < 32U * GEN_LIMBS; ++bit) {
+    if(bigint_bit(x, bit))
+      bigint_set_bit(&result, bit - count);
+  }
+
+  *x = result;
+}
+
+// 2^b / d rounded down, by binary long division
+
+gen_bigint bigint_power_of_two_div(u32 b, const gen_bigint* d) {
+  gen_bigint quotient;
+  gen_bigint remainder;
+
+  bigint_set_u32(&quotient, 0U);
+  bigint_set_u32(&remainder, 0U);
+
+  for(u32 i = b + 1U; i > 0U; --i) {
+    u32 bit = i - 1U;
+
+    bigint_shift_left(&remainder, 1U);
+
+    if(bit == b)
+      remainder.limbs[0] |= 1U;
+
+    if(bigint_compare(&remainder, d) >= 0) {
+      bigint_sub(&remainder, d);
+      bigint_set_bit(&quotient, bit);
+    }
+  }
+
+  return quotient;
+}
+
+u64 bigint_word(const gen_bigint* x, u32 index) {
+  return ((u64)x->limbs[2U * index + 1U] << 32) | x->limbs[2U * index];
+}
+
+// the 128-bit significand of 5^q
+
+void pow5_128(i32 q, u64* hi, u64* lo) {
+  gen_bigint power5;
+
+  bigint_set_u32(&power5, 1U);
+
+  for(i32 i = 0; i < ((q < 0) ? -q : q); ++i)
+    bigint_mul_u32(&power5, 5U);
+
+  gen_bigint c;
+
+  if(q >= 0) {
+    c = power5;
+
+    u32 width = bigint_width(&c);
+
+    if(width < 128U)
+      bigint_shift_left(&c, 128U - width);
+    else
+      bigint_shift_right(&c, width - 128U);
+  } else {
+    // the smallest z with 2^z >= 5^-q, 5^-q isn't a power of two
+    u32 z = bigint_width(&power5);
+
+    // up to 5^27 a 2^(z + 127) numerator leaves a 128-bit quotient
+    u32 b = (q >= -27) ? z + 127U : 2U * z + 128U;
+
+    c = bigint_power_of_two_div(b, &power5);
+    bigint_add_u32(&c, 1U);
+
+    u32 width = bigint_width(&c);
+
+    if(width > 128U)
+      bigint_shift_right(&c, width - 128U);
+  }
+
+  *hi = bigint_word(&c, 1U);
+  *lo = bigint_word(&c, 0U);
+}
+
+bool write_tables(cstring path) {
+  FILE* f = fopen(path, "w");
+
+  if(f == 0) {
+    printf("can't write %s\n", path);
+    return false;
+  }
+
+  fprintf(f, "// generated by number_gen, do not edit\n\n");
+  fprintf(f, "#ifndef CPEAK_NUMBER_TABLES_H\n");
+  fprintf(f, "#define CPEAK_NUMBER_TABLES_H\n\n");
+
+  fprintf(f, "#define NUMBER_POW5_MIN (%d)\n", NUMBER_POW5_MIN);
+  fprintf(f, "#define NUMBER_POW5_MAX %d\n\n", NUMBER_POW5_MAX);
+
+  fprintf(f, "// 5^q for q from NUMBER_POW5_MIN, normalized to 128 bits, high word first\n\n");
+  fprintf(f, "static const u64 number_pow5_128[2 * (NUMBER_POW5_MAX - NUMBER_POW5_MIN + 1)] = {\n");
+
+  for(i32 q = NUMBER_POW5_MIN; q <= NUMBER_POW5_MAX; ++q) {
+    u64 hi;
+    u64 lo;
+
+    pow5_128(q, &hi, &lo);
+    fprintf(f, "  0x%016llXULL, 0x%016llXULL, // 5^%d\n", (unsigned long long)hi, (unsigned long long)lo, q);
+  }
+
+  fprintf(f, "};\n\n");
+  fprintf(f, "#endif\n");
+
+  fclose(f);
+
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if(argc != 2) {
+    printf("usage: %s number_tables.h\n", argv[0]);
+    return 1;
+  }
+
+  if(!write_tables(argv[1]))
+    return 1;
+
+  return 0;
+}
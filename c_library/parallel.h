@@ -0,0 +1,106 @@
+/**
+ *  parallel.h
+ *
+ *  Minimal fork-join helpers on top of std::thread.
+ *
+ *  Work is split into one contiguous range per thread, or handed out in
+ *  fixed-size morsels from a shared counter so that threads which finish
+ *  early pick up more work. The calling thread always takes part as thread
+ *  0, so a thread count of 1 never spawns a thread.
+ */
+
+#ifndef CPEAK_PARALLEL_H
+#define CPEAK_PARALLEL_H
+
+#include <assert.h>
+#include <thread>
+#include <atomic>
+#include "types.h"
+#include "macro.h"
+
+#define PARALLEL_MAX_THREADS 64U
+
+inline
+u32 parallel_default_thread_count() {
+  u32 n = (u32)std::thread::hardware_concurrency();
+
+  if(n == 0U)
+    return 1U;
+
+  return MINIMUM(n, PARALLEL_MAX_THREADS);
+}
+
+// start of the range of thread t when [0, count) is split into thread_count ranges
+
+inline
+size_type parallel_range_begin(size_type count, u32 thread_count, u32 t) {
+  return (size_type)(((u64)count * t) / thread_count);
+}
+
+// number of threads worth using for 'count' items when a thread should get at least 'min_per_thread'
+
+inline
+u32 parallel_thread_count_for(size_type count, u32 thread_count, size_type min_per_thread) {
+  u64 useful = (u64)count / MAXIMUM(min_per_thread, (size_type)1U);
+
+  if(useful < thread_count)
+    thread_count = (u32)MAXIMUM(useful, (u64)1U);
+
+  return MINIMUM(thread_count, PARALLEL_MAX_THREADS);
+}
+
+// calls op(u32 thread_index) on thread_count threads and waits for all of them
+
+template <typename Op>
+inline
+void parallel_run(u32 thread_count, Op op) {
+  std::thread threads[PARALLEL_MAX_THREADS];
+
+  assert(thread_count >= 1U && thread_count <= PARALLEL_MAX_THREADS);
+
+  for(u32 t = 1U; t < thread_count; ++t) {
+    threads[t] = std::thread([&op, t]() { op(t); });
+  }
+
+  op(0U);
+
+  for(u32 t = 1U; t < thread_count; ++t) {
+    threads[t].join();
+  }
+}
+
+// calls op(u32 thread_index, size_type begin, size_type end) for one range of [0, count) per thread
+
+template <typename Op>
+inline
+void parallel_for_ranges(u32 thread_count, size_type count, Op op) {
+  parallel_run(thread_count, [&op, count, thread_count](u32 t) {
+    op(t, parallel_range_begin(count, thread_count, t), parallel_range_begin(count, thread_count, t + 1U));
+  });
+}
+
+// calls op(u32 thread_index, size_type begin, size_type end) for every morsel of [0, count),
+// morsels are claimed dynamically so the order in which a thread sees them is unspecified
+
+template <typename Op>
+inline
+void parallel_for_morsels(u32 thread_count, size_type count, size_type morsel_count, Op op) {
+  std::atomic<u64> next(0U);
+  u64 morsels = ((u64)count + morsel_count - 1U) / morsel_count;
+
+  parallel_run(thread_count, [&](u32 t) {
+    for(;;) {
+      u64 m = next.fetch_add(1U, std::memory_order_relaxed);
+
+      if(m >= morsels)
+        break;
+
+      size_type begin = (size_type)(m * morsel_count);
+      size_type end = (size_type)MINIMUM((u64)begin + morsel_count, (u64)count);
+
+      op(t, begin, end);
+    }
+  });
+}
+
+#endif
@@ -0,0 +1,238 @@
+/**
+ *  pool.h
+ *
+ *  A size-class pool allocator with random-access free, for the allocation
+ *  patterns an arena can't serve: long-lived objects freed in any order.
+ *
+ *  Requests up to POOL_MAX_SIZE bytes are rounded up to one of
+ *  POOL_CLASS_COUNT size classes (16-byte steps up to 128, then two
+ *  classes per power of two) and carved from POOL_SLAB_SIZE slabs taken
+ *  from malloc. Freed blocks go to a per-class free list and are reused
+ *  by the next request of the same class; slabs are only returned by
+ *  free_pool. Larger requests go straight to malloc.
+ *
+ *  Every block has a POOL_HEADER_SIZE header in front of it holding the
+ *  size class and the requested size, so free and realloc don't need the
+ *  size, and the pool can count how much of its reserved memory is live.
+ *
+ *  A pool is not thread-safe, use one per thread.
+ */
+
+#ifndef CPEAK_POOL_H
+#define CPEAK_POOL_H
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "macro.h"
+
+#define POOL_SLAB_SIZE   (256U * 1024U)
+#define POOL_MAX_SIZE    4096U
+#define POOL_CLASS_COUNT 18U
+#define POOL_LARGE_CLASS 0xFFFFFFFFU
+#define POOL_HEADER_SIZE 16U
+
+typedef struct pool_header {
+  usize size;       // requested size
+  u32   size_class; // POOL_LARGE_CLASS for blocks from malloc
+} pool_header;
+
+typedef struct pool_free_block {
+  struct pool_free_block* next;
+} pool_free_block;
+
+typedef struct pool_slab {
+  struct pool_slab* next;
+} pool_slab;
+
+typedef struct pool {
+  pool_free_block* free_lists[POOL_CLASS_COUNT];
+  pool_slab*       slabs;
+  u8*              bump;           // unused part of the newest slab
+  u8*              bump_end;
+  usize            reserved_bytes; // slabs and large blocks
+  usize            live_bytes;     // requested bytes of the allocated blocks
+} pool;
+
+inline
+u32 pool_size_class(usize size) {
+  u32 result;
+
+  if(size <= 128U) {
+    result = (size == 0U) ? 0U : (u32)((size - 1U) / 16U);
+  } else {
+    u32 b = 0U;
+
+    // size lies in (2^b, 2^(b + 1)], the classes are 2^b + 2^(b - 1) and 2^(b + 1)
+
+    while(((usize)2U << b) < size)
+      ++b;
+
+    usize half = ((usize)1U << b) + ((usize)1U << (b - 1U));
+
+    result = 8U + 2U * (b - 7U) + ((size > half) ? 1U : 0U);
+  }
+
+  return result;
+}
+
+inline
+usize pool_class_size(u32 size_class) {
+  usize result;
+
+  if(size_class < 8U) {
+    result = 16U * (size_class + 1U);
+  } else {
+    u32 k = size_class - 8U;
+    u32 b = 7U + k / 2U;
+
+    result = (k & 1U) ? ((usize)2U << b) : ((usize)1U << b) + ((usize)1U << (b - 1U));
+  }
+
+  return result;
+}
+
+inline
+pool make_pool() {
+  pool result;
+
+  memset(&result, 0, sizeof(result));
+
+  return result;
+}
+
+// releases all slabs; large blocks that weren't freed are leaked
+
+inline
+void free_pool(pool* p) {
+  pool_slab* slab = p->slabs;
+
+  while(slab) {
+    pool_slab* next = slab->next;
+
+    free(slab);
+    slab = next;
+  }
+
+  *p = make_pool();
+}
+
+inline
+pool_header* pool_header_of(void* ptr) {
+  return (pool_header*)((u8*)ptr - POOL_HEADER_SIZE);
+}
+
+// capacity of the block, at least the requested size
+
+inline
+usize pool_block_size(void* ptr) {
+  pool_header* h = pool_header_of(ptr);
+
+  return (h->size_class == POOL_LARGE_CLASS) ? h->size : pool_class_size(h->size_class);
+}
+
+inline
+u8* pool_carve(pool* p, usize block_size) {
+  if((usize)(p->bump_end - p->bump) < block_size) {
+    pool_slab* slab = (pool_slab*)malloc(POOL_SLAB_SIZE);
+
+    // note: error handling via assert, as for make_system_arena
+    assert(slab);
+
+    slab->next = p->slabs;
+    p->slabs = slab;
+    p->reserved_bytes += POOL_SLAB_SIZE;
+
+    // the slab link takes the first 16 bytes, blocks start 16-byte aligned after it
+
+    p->bump     = (u8*)slab + 16U;
+    p->bump_end = (u8*)slab + POOL_SLAB_SIZE;
+  }
+
+  u8* result = p->bump;
+  p->bump += block_size;
+
+  return result;
+}
+
+inline
+void* pool_alloc(pool* p, usize size) {
+  u8* block;
+  u32 size_class;
+
+  if(size > POOL_MAX_SIZE) {
+    size_class = POOL_LARGE_CLASS;
+    block = (u8*)malloc(POOL_HEADER_SIZE + size);
+
+    assert(block);
+
+    p->reserved_bytes += POOL_HEADER_SIZE + size;
+  } else {
+    size_class = pool_size_class(size);
+
+    pool_free_block* free_block = p->free_lists[size_class];
+
+    if(free_block) {
+      p->free_lists[size_class] = free_block->next;
+      block = (u8*)free_block - POOL_HEADER_SIZE;
+    } else {
+      block = pool_carve(p, POOL_HEADER_SIZE + pool_class_size(size_class));
+    }
+  }
+
+  pool_header* h = (pool_header*)block;
+
+  h->size       = size;
+  h->size_class = size_class;
+
+  p->live_bytes += size;
+
+  return block + POOL_HEADER_SIZE;
+}
+
+inline
+void pool_free(pool* p, void* ptr) {
+  if(ptr == 0)
+    return;
+
+  pool_header* h = pool_header_of(ptr);
+
+  p->live_bytes -= h->size;
+
+  if(h->size_class == POOL_LARGE_CLASS) {
+    p->reserved_bytes -= POOL_HEADER_SIZE + h->size;
+    free(h);
+  } else {
+    pool_free_block* free_block = (pool_free_block*)ptr;
+
+    free_block->next = p->free_lists[h->size_class];
+    p->free_lists[h->size_class] = free_block;
+  }
+}
+
+inline
+void* pool_realloc(pool* p, void* ptr, usize size) {
+  if(ptr == 0)
+    return pool_alloc(p, size);
+
+  pool_header* h = pool_header_of(ptr);
+
+  // stays in its block while the new size fits the size class
+
+  if(h->size_class != POOL_LARGE_CLASS && size <= pool_class_size(h->size_class)) {
+    p->live_bytes = p->live_bytes - h->size + size;
+    h->size = size;
+
+    return ptr;
+  }
+
+  void* result = pool_alloc(p, size);
+
+  memcpy(result, ptr, MINIMUM(h->size, size));
+  pool_free(p, ptr);
+
+  return result;
+}
+
+#endif
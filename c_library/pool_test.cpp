@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "pool.h"
+
+// the size classes at their boundaries, block reuse, realloc in place and
+// across classes, large blocks and the live/reserved accounting
+
+bool filled_with(const u8* p, usize size, u8 v) {
+  bool result = true;
+
+  for(usize i = 0; result && i < size; ++i)
+    result = p[i] == v;
+
+  return result;
+}
+
+int main(int argc, char** argv) {
+  // every size up to POOL_MAX_SIZE gets the smallest class that holds it
+
+  bool classes = pool_size_class(0U) == 0U && pool_size_class(POOL_MAX_SIZE) == POOL_CLASS_COUNT - 1U;
+
+  for(usize size = 1U; classes && size <= POOL_MAX_SIZE; ++size) {
+    u32 c = pool_size_class(size);
+
+    classes = c < POOL_CLASS_COUNT && pool_class_size(c) >= size && (c == 0U || pool_class_size(c - 1U) < size);
+  }
+
+  printf("classes: %d, 128 -> %u, 129 -> %u, 4096 -> %u\n", classes, (u32)pool_class_size(pool_size_class(128U)),
+         (u32)pool_class_size(pool_size_class(129U)), (u32)pool_class_size(pool_size_class(4096U)));
+
+  pool p = make_pool();
+
+  // blocks at the boundaries, 4097 is the first large block
+
+  usize sizes[] = { 1U, 16U, 17U, 128U, 129U, 4096U, 4097U, 100000U };
+  u8* blocks[8];
+  usize live = 0U;
+  bool accounting = true;
+
+  for(u32 i = 0U; i < 8U; ++i) {
+    usize reserved = p.reserved_bytes;
+
+    blocks[i] = (u8*)pool_alloc(&p, sizes[i]);
+    memset(blocks[i], (int)i + 1, sizes[i]);
+    live += sizes[i];
+
+    bool large = sizes[i] > POOL_MAX_SIZE;
+
+    accounting = accounting && ((usize)blocks[i] & 15U) == 0U && p.live_bytes == live && pool_block_size(blocks[i]) >= sizes[i] &&
+                 pool_header_of(blocks[i])->size_class == (large ? POOL_LARGE_CLASS : pool_size_class(sizes[i])) &&
+                 (!large || p.reserved_bytes == reserved + POOL_HEADER_SIZE + sizes[i]);
+  }
+
+  bool intact = true;
+
+  for(u32 i = 0U; i < 8U; ++i)
+    intact = intact && filled_with(blocks[i], sizes[i], (u8)(i + 1U));
+
+  printf("boundary blocks: accounting %d, intact %d, live %u, reserved %u\n", accounting, intact, (u32)p.live_bytes,
+         (u32)p.reserved_bytes);
+
+  // a freed block is the next one of its class, a large block is given back
+
+  usize reserved = p.reserved_bytes;
+
+  pool_free(&p, blocks[4]);
+  pool_free(&p, blocks[7]);
+
+  bool reuse = p.live_bytes == live - 129U - 100000U && p.reserved_bytes == reserved - POOL_HEADER_SIZE - 100000U;
+  u8* again = (u8*)pool_alloc(&p, 150U);
+
+  reuse = reuse && again == blocks[4] && p.live_bytes == live - 129U - 100000U + 150U;
+  pool_free(&p, again);
+  pool_free(&p, 0);
+
+  printf("reuse: %d\n", reuse);
+
+  // realloc inside the class keeps the block, past it moves to the next class or to malloc
+
+  u8* r = (u8*)pool_realloc(&p, 0, 20U);
+
+  memset(r, 0x5A, 20U);
+
+  u8* r_same = (u8*)pool_realloc(&p, r, 32U);
+  bool in_place = r_same == r && p.live_bytes == live - 129U - 100000U + 32U && pool_header_of(r)->size == 32U;
+
+  u8* r_next = (u8*)pool_realloc(&p, r_same, 33U);
+  bool moved = r_next != r && pool_header_of(r_next)->size_class == pool_size_class(33U) && filled_with(r_next, 20U, 0x5A);
+
+  u8* r_large = (u8*)pool_realloc(&p, r_next, 5000U);
+  moved = moved && pool_header_of(r_large)->size_class == POOL_LARGE_CLASS && filled_with(r_large, 20U, 0x5A);
+
+  // a large block always moves, also when it shrinks back into a class
+
+  u8* r_small = (u8*)pool_realloc(&p, r_large, 64U);
+  moved = moved && r_small != r_large && pool_header_of(r_small)->size_class == pool_size_class(64U) && filled_with(r_small, 20U, 0x5A);
+  moved = moved && p.live_bytes == live - 129U - 100000U + 64U && p.reserved_bytes == reserved - POOL_HEADER_SIZE - 100000U;
+
+  printf("realloc: in place %d, moved %d\n", in_place, moved);
+
+  // many blocks of every class through the allocator view, freed in random order
+
+  allocator pa = get_pool_alloc(&p);
+  u8** many = (u8**)malloc(20000U * sizeof(u8*));
+  usize* many_sizes = (usize*)malloc(20000U * sizeof(usize));
+  usize before = p.live_bytes;
+  u32 state = 12345U;
+
+  for(u32 i = 0U; i < 20000U; ++i) {
+    state = state * 1664525U + 1013904223U;
+    many_sizes[i] = 1U + (state >> 8) % 5000U;
+    many[i] = (u8*)cpeak_alloc(pa, many_sizes[i]);
+    memset(many[i], (int)(i & 0xFFU), many_sizes[i]);
+  }
+
+  bool churn = true;
+
+  for(u32 i = 20000U; i > 1U; --i) {
+    state = state * 1664525U + 1013904223U;
+
+    u32 j = (state >> 8) % i;
+    u8* t = many[i - 1U];
+    usize ts = many_sizes[i - 1U];
+
+    many[i - 1U] = many[j];
+    many_sizes[i - 1U] = many_sizes[j];
+    many[j] = t;
+    many_sizes[j] = ts;
+  }
+
+  for(u32 i = 0U; i < 20000U; ++i) {
+    u8 v = many[i][0];
+
+    churn = churn && filled_with(many[i], many_sizes[i], v);
+    cpeak_free(pa, many[i]);
+  }
+
+  churn = churn && p.live_bytes == before;
+
+  printf("random frees: %d, reserved %u\n", churn, (u32)p.reserved_bytes);
+
+  free(many_sizes);
+  free(many);
+
+  for(u32 i = 0U; i < 8U; ++i) {
+    if(i != 4U && i != 7U)
+      pool_free(&p, blocks[i]);
+  }
+
+  pool_free(&p, r_small);
+  free_pool(&p);
+
+  printf("freed: live %u, reserved %u\n", (u32)p.live_bytes, (u32)p.reserved_bytes);
+
+  return 0;
+}
@@ -0,0 +1,44 @@
+/**
+ *  simd.h
+ *
+ *  Instruction set selection for the vectorized kernels.
+ *
+ *  The kernels are written against one of the following #defines, from
+ *  the widest to the narrowest. Each level implies the levels below it.
+ *  CPEAK_AVX512 - AVX-512F (512-bit integer ops, compress/expand).
+ *  CPEAK_AVX2   - AVX2 (256-bit integer ops, gathers).
+ *  CPEAK_SSSE3  - SSSE3 (byte shuffles).
+ *  CPEAK_SSE2   - SSE2 (128-bit integer ops).
+ *
+ *  They can be set by the build or are picked up from the compiler's own
+ *  target macros. Defining CPEAK_NO_SIMD forces the scalar code paths.
+ */
+
+#ifndef CPEAK_SIMD_H
+#define CPEAK_SIMD_H
+
+#ifndef CPEAK_NO_SIMD
+
+#if defined(__AVX512F__) && !defined(CPEAK_AVX512)
+#define CPEAK_AVX512
+#endif
+
+#if (defined(__AVX2__) || defined(CPEAK_AVX512)) && !defined(CPEAK_AVX2)
+#define CPEAK_AVX2
+#endif
+
+#if (defined(__SSSE3__) || defined(CPEAK_AVX2)) && !defined(CPEAK_SSSE3)
+#define CPEAK_SSSE3
+#endif
+
+#if (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(CPEAK_SSSE3)) && !defined(CPEAK_SSE2)
+#define CPEAK_SSE2
+#endif
+
+#endif
+
+#if defined(CPEAK_SSE2)
+#include <immintrin.h>
+#endif
+
+#endif
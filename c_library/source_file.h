@@ -0,0 +1,218 @@
+/**
+ *  source_file.h
+ *
+ *  Source files for the lexer, mapped into memory instead of read into
+ *  buffers, and cached by path.
+ *
+ *  Every source is followed by at least SOURCE_FILE_PADDING readable zero
+ *  bytes, so text[length] is a null character and loads of up to that
+ *  many bytes past the end stay inside the mapping. On POSIX systems an
+ *  anonymous zero-filled region one page larger than the file is reserved
+ *  and the file is mapped over its start with MAP_FIXED: the rest of the
+ *  file's last page is zero-filled by the kernel, and the extra page is a
+ *  zero guard page behind it. The text is never copied. Windows can't
+ *  place a file view in front of a reserved page, so there the file is
+ *  read into a padded allocation instead.
+ *
+ *  The mapping is private and read-only; a file that changes on disk after
+ *  it was opened may or may not show the change. Sources are limited to
+ *  u32 offsets, like the lexer.
+ *
+ *  A source_manager interns the paths it opened and keeps one source_file
+ *  per path symbol, so a file opened twice is mapped once. The source_file
+ *  pointers stay valid until free_source_manager releases the files.
+ */
+
+#ifndef CPEAK_SOURCE_FILE_H
+#define CPEAK_SOURCE_FILE_H
+
+#include <string.h>
+#include "types.h"
+#include "macro.h"
+#include "arena.h"
+#include "intern.h"
+#include "mapped_file.h"
+
+#define SOURCE_FILE_PADDING 64U
+
+typedef struct source_file {
+  cstring path;
+  cstring text;   // length bytes, followed by SOURCE_FILE_PADDING zero bytes
+  u32     length;
+  void*   base;   // the mapping or allocation holding the text
+  usize   base_size;
+} source_file;
+
+typedef struct source_manager {
+  arena        ma;
+  interner     paths;
+  source_file** files;   // by path symbol, text is null when the file couldn't be opened
+  u32          capacity;
+} source_manager;
+
+inline
+usize source_file_round_up(usize size, usize page) {
+  return (size + page - 1U) / page * page;
+}
+
+// maps the file at path, returns false when it can't be opened or is too large
+
+inline
+bool map_source_file(source_file* result, cstring path) {
+  u64 size = mapped_file_size(path);
+
+  result->path = path;
+  result->text = 0;
+  result->length = 0U;
+  result->base = 0;
+  result->base_size = 0U;
+
+  if(size == ~(u64)0U || size > (u64)(0xFFFFFFFFU - SOURCE_FILE_PADDING))
+    return false;
+
+  usize page = (usize)mapped_file_page_size();
+  usize text_size = (usize)size;
+
+#if defined(_WIN32)
+  usize base_size = source_file_round_up(text_size + SOURCE_FILE_PADDING, page);
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+
+  if(file == INVALID_HANDLE_VALUE)
+    return false;
+
+  // committed pages are zero-filled, the padding stays zero
+
+  u8* base = (u8*)VirtualAlloc(0, base_size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  usize done = 0U;
+
+  while(base && done < text_size) {
+    DWORD chunk = (DWORD)MINIMUM(text_size - done, (usize)(1U << 30));
+    DWORD read = 0;
+
+    if(!ReadFile(file, base + done, chunk, &read, 0) || read == 0)
+      break;
+
+    done += read;
+  }
+
+  CloseHandle(file);
+
+  if(base == 0)
+    return false;
+
+  if(done != text_size) {
+    VirtualFree(base, 0, MEM_RELEASE);
+    return false;
+  }
+
+  DWORD old_protect;
+  VirtualProtect(base, base_size, PAGE_READONLY, &old_protect);
+#else
+  usize map_size = source_file_round_up(text_size, page);
+  usize base_size = map_size + source_file_round_up(SOURCE_FILE_PADDING, page);
+
+  void* base = mmap(0, base_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if(base == MAP_FAILED)
+    return false;
+
+  if(map_size != 0U) {
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0) {
+      munmap(base, base_size);
+      return false;
+    }
+
+    void* text = mmap(base, map_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+    close(fd); // the mapping keeps the file open
+
+    if(text == MAP_FAILED) {
+      munmap(base, base_size);
+      return false;
+    }
+
+    madvise(base, map_size, MADV_SEQUENTIAL);
+  }
+#endif
+
+  result->text = (cstring)base;
+  result->length = (u32)text_size;
+  result->base = base;
+  result->base_size = base_size;
+
+  return true;
+}
+
+inline
+void unmap_source_file(source_file* f) {
+  if(f->base) {
+#if defined(_WIN32)
+    VirtualFree(f->base, 0, MEM_RELEASE);
+#else
+    munmap(f->base, f->base_size);
+#endif
+  }
+
+  f->text = 0;
+  f->length = 0U;
+  f->base = 0;
+  f->base_size = 0U;
+}
+
+//
+// the manager
+//
+
+inline
+source_manager make_source_manager(arena ma) {
+  source_manager result;
+
+  result.ma       = ma;
+  result.paths    = make_interner(ma, 64U);
+  result.capacity = 64U;
+  result.files    = (source_file**)arena_alloc(ma, result.capacity * sizeof(source_file*));
+
+  return result;
+}
+
+// the file at path, mapped on the first call; null when it can't be opened,
+// which is tried again on the next call
+
+inline
+const source_file* open_source(source_manager* m, cstring path) {
+  u32 count = m->paths.count;
+  u32 symbol = intern(&m->paths, path);
+  source_file* f;
+
+  if(symbol == count) {
+    if(symbol == m->capacity) {
+      source_file** files = (source_file**)arena_alloc(m->ma, 2U * m->capacity * sizeof(source_file*));
+
+      memcpy(files, m->files, m->capacity * sizeof(source_file*));
+
+      m->files = files;
+      m->capacity *= 2U;
+    }
+
+    f = (source_file*)arena_alloc(m->ma, sizeof(source_file));
+    m->files[symbol] = f;
+
+    map_source_file(f, intern_string(&m->paths, symbol).ptr);
+  } else {
+    f = m->files[symbol];
+
+    if(f->text == 0)
+      map_source_file(f, intern_string(&m->paths, symbol).ptr);
+  }
+
+  return f->text ? f : 0;
+}
+
+inline
+void free_source_manager(source_manager* m) {
+  for(u32 i = 0U; i < m->paths.count; ++i)
+    unmap_source_file(m->files[i]);
+}
+
+#endif
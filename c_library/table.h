@@ -0,0 +1,490 @@
+/**
+ *  table.h
+ *
+ *  A small columnar table: named array_u32 columns sharing one row count.
+ *
+ *  The table header and the columns it creates are allocated from an arena,
+ *  so a whole table is released by popping/resetting that arena.
+ *
+ *  Queries work on selection vectors (ascending row ids, as array_u32):
+ *  table_select/table_refine  - filter rows with a comparison against a constant
+ *  table_gather               - materialize a column for a selection
+ *  table_aggregate            - count/sum/min/max of a column
+ *  table_group_by             - the same aggregates per distinct key, through a hash table
+ *
+ *  Execution is morsel-driven: rows are handed out to threads in morsels of
+ *  TABLE_MORSEL_COUNT from a shared counter. Filters reuse the SIMD
+ *  comparison kernels of array_u32_filter.h and compact the result in a
+ *  second morsel pass, so selection vectors stay in row order. Group-by
+ *  builds one hash table per thread and merges them at the end; these
+ *  per-thread tables are scratch memory from std_alloc, as arenas can't be
+ *  shared between threads.
+ */
+
+#ifndef CPEAK_TABLE_H
+#define CPEAK_TABLE_H
+
+#include <assert.h>
+#include <string.h>
+#include "types.h"
+#include "macro.h"
+#include "alloc.h"
+#include "arena.h"
+#include "bits.h"
+#include "parallel.h"
+#include "array_u32.h"
+#include "bitset.h"
+#include "array_u32_filter.h"
+#include "array_u32_permute.h"
+
+#define TABLE_MAX_COLUMNS 64U
+#define TABLE_MORSEL_COUNT (16U * 1024U) // rows per morsel, a multiple of 64
+
+typedef struct table {
+  arena     ma;
+  size_type row_count;
+  u32       column_count;
+  cstring   names[TABLE_MAX_COLUMNS];
+  array_u32 columns[TABLE_MAX_COLUMNS];
+} table;
+
+typedef struct aggregate_u32 {
+  u64 count;
+  u64 sum;
+  u32 min;
+  u32 max;
+} aggregate_u32;
+
+typedef struct group_result {
+  array_u32 keys;
+  array_u32 counts;
+  array_u32 mins;
+  array_u32 maxs;
+  u64*      sums;
+} group_result;
+
+//
+// construction
+//
+
+inline
+table* make_table(arena a, size_type row_count) {
+  table* result = (table*)arena_alloc(a, sizeof(table));
+
+  result->ma = a;
+  result->row_count = row_count;
+  result->column_count = 0U;
+
+  return result;
+}
+
+// adds an existing column (not copied, it has to outlive the table)
+
+inline
+void add_column(table* t, cstring name, array_u32 column) {
+  assert(t->column_count < TABLE_MAX_COLUMNS);
+  assert(column.count == t->row_count);
+
+  t->names[t->column_count] = name;
+  t->columns[t->column_count] = column;
+  ++t->column_count;
+}
+
+// adds a zeroed column allocated from the table's arena
+
+inline
+array_u32 add_column(table* t, cstring name) {
+  array_u32 result;
+
+  result.ptr = (u32*)arena_alloc(t->ma, t->row_count * sizeof(u32));
+  result.count = t->row_count;
+
+  memset(result.ptr, 0, result.count * sizeof(u32));
+
+  add_column(t, name, result);
+
+  return result;
+}
+
+// index of the named column, -1 if there is none
+
+inline
+i32 column_index(table* t, cstring name) {
+  for(u32 i = 0U; i < t->column_count; ++i) {
+    if(strcmp(t->names[i], name) == 0)
+      return (i32)i;
+  }
+
+  return -1;
+}
+
+inline
+array_u32 column(table* t, cstring name) {
+  i32 index = column_index(t, name);
+
+  assert(index >= 0);
+
+  return t->columns[index];
+}
+
+//
+// filters
+//
+
+inline
+bool table_compare_scalar(u32 op, u32 x, u32 y) {
+  switch(op) {
+    case compare_op_eq: return compare_scalar<compare_op_eq>(x, y);
+    case compare_op_ne: return compare_scalar<compare_op_ne>(x, y);
+    case compare_op_lt: return compare_scalar<compare_op_lt>(x, y);
+    case compare_op_le: return compare_scalar<compare_op_le>(x, y);
+    case compare_op_gt: return compare_scalar<compare_op_gt>(x, y);
+    default:            return compare_scalar<compare_op_ge>(x, y);
+  }
+}
+
+inline
+u64 table_compare_word(u32 op, const u32* x, u32 y) {
+  switch(op) {
+    case compare_op_eq: return compare_word<compare_op_eq>(x, &y, 0U);
+    case compare_op_ne: return compare_word<compare_op_ne>(x, &y, 0U);
+    case compare_op_lt: return compare_word<compare_op_lt>(x, &y, 0U);
+    case compare_op_le: return compare_word<compare_op_le>(x, &y, 0U);
+    case compare_op_gt: return compare_word<compare_op_gt>(x, &y, 0U);
+    default:            return compare_word<compare_op_ge>(x, &y, 0U);
+  }
+}
+
+// rows of 'selection' (all rows if null) where column op value holds
+
+inline
+array_u32 table_filter(allocator a, table* t, const array_u32* selection, cstring name, u32 op, u32 value, u32 thread_count) {
+  array_u32 result;
+  array_u32 col = column(t, name);
+
+  size_type count = selection ? selection->count : t->row_count;
+  size_type morsel_count = (count + TABLE_MORSEL_COUNT - 1U) / TABLE_MORSEL_COUNT;
+
+  thread_count = parallel_thread_count_for(count, thread_count, TABLE_MORSEL_COUNT);
+
+  bitset mask = make_bitset(a, count);
+  u32* morsel_offsets = (u32*)cpeak_alloc(a, (morsel_count + 1U) * sizeof(u32));
+
+  // pass 1: comparison bits and the number of hits per morsel
+
+  parallel_for_morsels(thread_count, count, TABLE_MORSEL_COUNT, [&](u32, size_type begin, size_type end) {
+    u32 buffer[64];
+    u32 hits = 0U;
+
+    for(size_type i = begin; i < end; i += 64U) {
+      size_type n = MINIMUM(end - i, (size_type)64U);
+      u64 bits = 0U;
+
+      if(n == 64U) {
+        const u32* x = col.ptr + i;
+
+        if(selection) {
+          for(u32 j = 0U; j < 64U; ++j)
+            buffer[j] = col.ptr[selection->ptr[i + j]];
+
+          x = buffer;
+        }
+
+        bits = table_compare_word(op, x, value);
+      } else {
+        for(u32 j = 0U; j < n; ++j) {
+          u32 row = selection ? selection->ptr[i + j] : (u32)(i + j);
+          bits |= (u64)table_compare_scalar(op, col.ptr[row], value) << j;
+        }
+      }
+
+      mask.words[i / 64U] = bits;
+      hits += bits_popcount_u64(bits);
+    }
+
+    morsel_offsets[begin / TABLE_MORSEL_COUNT] = hits;
+  });
+
+  // morsel output offsets
+
+  u32 total = 0U;
+
+  for(size_type m = 0; m < morsel_count; ++m) {
+    u32 hits = morsel_offsets[m];
+
+    morsel_offsets[m] = total;
+    total += hits;
+  }
+
+  result.count = total;
+  result.ptr   = (u32*)cpeak_alloc(a, total * sizeof(u32));
+
+  // pass 2: compaction, every morsel writes its own slice in row order
+
+  parallel_for_morsels(thread_count, count, TABLE_MORSEL_COUNT, [&](u32, size_type begin, size_type end) {
+    u32* out = result.ptr + morsel_offsets[begin / TABLE_MORSEL_COUNT];
+
+    for(size_type w = begin / 64U; w * 64U < end; ++w) {
+      u64 bits = mask.words[w];
+
+      while(bits != 0U) {
+        size_type i = w * 64U + bits_ctz_u64(bits);
+
+        *out = selection ? selection->ptr[i] : (u32)i;
+        out += 1;
+        bits &= bits - 1U;
+      }
+    }
+  });
+
+  cpeak_free(a, morsel_offsets);
+  cpeak_free(a, mask.words);
+
+  return result;
+}
+
+inline
+array_u32 table_select(allocator a, table* t, cstring name, u32 op, u32 value, u32 thread_count) {
+  return table_filter(a, t, 0, name, op, value, thread_count);
+}
+
+inline
+array_u32 table_refine(allocator a, table* t, array_u32 selection, cstring name, u32 op, u32 value, u32 thread_count) {
+  return table_filter(a, t, &selection, name, op, value, thread_count);
+}
+
+inline
+array_u32 table_gather(allocator a, table* t, cstring name, array_u32 selection) {
+  return gather(a, column(t, name), selection);
+}
+
+//
+// aggregates
+//
+
+inline
+aggregate_u32 make_aggregate() {
+  aggregate_u32 result;
+
+  result.count = 0U;
+  result.sum   = 0U;
+  result.min   = 0xFFFFFFFFU;
+  result.max   = 0U;
+
+  return result;
+}
+
+inline
+void aggregate_merge(aggregate_u32* acc, aggregate_u32 other) {
+  acc->count += other.count;
+  acc->sum   += other.sum;
+  acc->min    = MINIMUM(acc->min, other.min);
+  acc->max    = MAXIMUM(acc->max, other.max);
+}
+
+// note: min/max of an empty selection are 0xFFFFFFFF and 0
+
+inline
+aggregate_u32 table_aggregate(table* t, const array_u32* selection, cstring name, u32 thread_count) {
+  aggregate_u32 partial[PARALLEL_MAX_THREADS];
+  array_u32 col = column(t, name);
+
+  size_type count = selection ? selection->count : t->row_count;
+  thread_count = parallel_thread_count_for(count, thread_count, TABLE_MORSEL_COUNT);
+
+  for(u32 i = 0U; i < thread_count; ++i)
+    partial[i] = make_aggregate();
+
+  parallel_for_morsels(thread_count, count, TABLE_MORSEL_COUNT, [&](u32 thread, size_type begin, size_type end) {
+    aggregate_u32 acc = partial[thread];
+
+    acc.count += end - begin;
+
+    for(size_type i = begin; i < end; ++i) {
+      u32 v = selection ? col.ptr[selection->ptr[i]] : col.ptr[i];
+
+      acc.sum += v;
+      acc.min  = MINIMUM(acc.min, v);
+      acc.max  = MAXIMUM(acc.max, v);
+    }
+
+    partial[thread] = acc;
+  });
+
+  aggregate_u32 result = make_aggregate();
+
+  for(u32 i = 0U; i < thread_count; ++i)
+    aggregate_merge(&result, partial[i]);
+
+  return result;
+}
+
+//
+// group-by hash table (linear probing, an entry with count 0 is empty)
+//
+
+typedef struct group_entry {
+  u32 key;
+  u32 count;
+  u32 min;
+  u32 max;
+  u64 sum;
+} group_entry;
+
+typedef struct group_table {
+  group_entry* entries;
+  u32          bits;
+  u32          size;
+} group_table;
+
+inline
+group_table make_group_table(u32 bits) {
+  group_table result;
+  usize capacity = (usize)1U << bits;
+
+  result.entries = (group_entry*)cpeak_alloc(std_alloc, capacity * sizeof(group_entry));
+  result.bits = bits;
+  result.size = 0U;
+
+  memset(result.entries, 0, capacity * sizeof(group_entry));
+
+  return result;
+}
+
+inline
+void free_group_table(group_table* gt) {
+  cpeak_free(std_alloc, gt->entries);
+  gt->entries = 0;
+}
+
+inline
+u32 group_table_slot(u32 key, u32 bits) {
+  return (key * 0x9E3779B1U) >> (32U - bits);
+}
+
+inline
+void group_table_add(group_table* gt, group_entry e);
+
+inline
+void group_table_grow(group_table* gt) {
+  group_table old = *gt;
+  usize old_capacity = (usize)1U << old.bits;
+
+  *gt = make_group_table(old.bits + 1U);
+
+  for(usize i = 0U; i < old_capacity; ++i) {
+    if(old.entries[i].count != 0U)
+      group_table_add(gt, old.entries[i]);
+  }
+
+  free_group_table(&old);
+}
+
+inline
+void group_table_add(group_table* gt, group_entry e) {
+  u32 mask = (1U << gt->bits) - 1U;
+  u32 slot = group_table_slot(e.key, gt->bits);
+
+  for(;;) {
+    group_entry* cur = gt->entries + slot;
+
+    if(cur->count == 0U) {
+      *cur = e;
+      ++gt->size;
+
+      // keep the load factor at or below 1/2
+      if(2U * gt->size > mask + 1U)
+        group_table_grow(gt);
+
+      return;
+    }
+
+    if(cur->key == e.key) {
+      cur->count += e.count;
+      cur->sum   += e.sum;
+      cur->min    = MINIMUM(cur->min, e.min);
+      cur->max    = MAXIMUM(cur->max, e.max);
+
+      return;
+    }
+
+    slot = (slot + 1U) & mask;
+  }
+}
+
+// groups the rows of 'selection' (all rows if null) by 'key' and aggregates 'value' per group
+// the groups come out in hash table order
+
+inline
+group_result table_group_by(allocator a, table* t, const array_u32* selection, cstring key, cstring value, u32 thread_count) {
+  group_result result;
+  group_table local[PARALLEL_MAX_THREADS];
+
+  array_u32 key_col = column(t, key);
+  array_u32 value_col = column(t, value);
+
+  size_type count = selection ? selection->count : t->row_count;
+  thread_count = parallel_thread_count_for(count, thread_count, TABLE_MORSEL_COUNT);
+
+  for(u32 i = 0U; i < thread_count; ++i)
+    local[i] = make_group_table(10U);
+
+  parallel_for_morsels(thread_count, count, TABLE_MORSEL_COUNT, [&](u32 thread, size_type begin, size_type end) {
+    group_table* gt = local + thread;
+
+    for(size_type i = begin; i < end; ++i) {
+      u32 row = selection ? selection->ptr[i] : (u32)i;
+      u32 v = value_col.ptr[row];
+      group_entry e = { key_col.ptr[row], 1U, v, v, v };
+
+      group_table_add(gt, e);
+    }
+  });
+
+  // merge the thread-local tables into the first one
+
+  group_table* merged = local;
+
+  for(u32 i = 1U; i < thread_count; ++i) {
+    usize capacity = (usize)1U << local[i].bits;
+
+    for(usize j = 0U; j < capacity; ++j) {
+      if(local[i].entries[j].count != 0U)
+        group_table_add(merged, local[i].entries[j]);
+    }
+
+    free_group_table(local + i);
+  }
+
+  size_type group_count = merged->size;
+
+  result.keys.ptr   = (u32*)cpeak_alloc(a, group_count * sizeof(u32));
+  result.counts.ptr = (u32*)cpeak_alloc(a, group_count * sizeof(u32));
+  result.mins.ptr   = (u32*)cpeak_alloc(a, group_count * sizeof(u32));
+  result.maxs.ptr   = (u32*)cpeak_alloc(a, group_count * sizeof(u32));
+  result.sums       = (u64*)cpeak_alloc(a, group_count * sizeof(u64));
+
+  result.keys.count = result.counts.count = result.mins.count = result.maxs.count = group_count;
+
+  usize capacity = (usize)1U << merged->bits;
+  size_type g = 0U;
+
+  for(usize j = 0U; j < capacity; ++j) {
+    group_entry e = merged->entries[j];
+
+    if(e.count != 0U) {
+      result.keys.ptr[g]   = e.key;
+      result.counts.ptr[g] = e.count;
+      result.mins.ptr[g]   = e.min;
+      result.maxs.ptr[g]   = e.max;
+      result.sums[g]       = e.sum;
+      ++g;
+    }
+  }
+
+  free_group_table(merged);
+
+  return result;
+}
+
+#endif
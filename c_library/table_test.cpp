@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "arena.h"
+#include "array_u32.h"
+#include "table.h"
+
+int main(int argc, char** argv) {
+  arena a = make_system_arena(64U * 1024U * 1024U);
+  allocator ai = get_arena_alloc(a);
+
+  const size_type row_count = 1000000U;
+  u32 thread_count = parallel_default_thread_count();
+
+  table* t = make_table(a, row_count);
+
+  array_u32 id    = add_column(t, "id");
+  array_u32 shop  = add_column(t, "shop");
+  array_u32 price = add_column(t, "price");
+
+  for(size_type i = 0; i < row_count; ++i) {
+    id.ptr[i]    = (u32)i;
+    shop.ptr[i]  = (u32)(i % 7U);
+    price.ptr[i] = (u32)((i * 2654435761U) % 1000U);
+  }
+
+  // price >= 900 and shop != 3
+
+  array_u32 sel = table_select(ai, t, "price", compare_op_ge, 900U, thread_count);
+  sel = table_refine(ai, t, sel, "shop", compare_op_ne, 3U, thread_count);
+
+  printf("selected rows: %u\n", (u32)sel.count);
+  print(take_at_most(table_gather(ai, t, "id", sel), 8));
+  printf("\n");
+
+  aggregate_u32 agg = table_aggregate(t, &sel, "price", thread_count);
+  printf("count: %llu, sum: %llu, min: %u, max: %u\n", agg.count, agg.sum, agg.min, agg.max);
+
+  group_result groups = table_group_by(ai, t, &sel, "shop", "price", thread_count);
+
+  for(size_type g = 0; g < groups.keys.count; ++g) {
+    printf("shop %u: count: %u, sum: %llu, min: %u, max: %u\n",
+      groups.keys.ptr[g], groups.counts.ptr[g], groups.sums[g], groups.mins.ptr[g], groups.maxs.ptr[g]);
+  }
+
+  free_system_arena(a);
+
+  return 0;
+}
@@ -24,14 +24,25 @@ typedef u64 size_type;
 typedef i64 index_type;
 typedef u64 usize;
 typedef i64 isize;
+
+#define CPEAK_SIZE_TYPE_MAX 0xFFFFFFFFFFFFFFFFULL
 #else
 typedef u32 size_type;
 typedef i32 index_type;
 typedef u32 usize;
 typedef i32 isize;
+
+#define CPEAK_SIZE_TYPE_MAX 0xFFFFFFFFU
 #endif
 
 typedef const char* cstring;
 typedef char*       cstring_mutable;
 
+// length chars starting at ptr, not necessarily zero-terminated
+
+typedef struct string_slice {
+  const char* ptr;
+  size_type   length;
+} string_slice;
+
 #endif
@@ -3,10 +3,15 @@
 #define CPEAK_AST_DATA_H
 
 #include "ast.h"
+#include "../c_library/intern.h"
+
+// symbol is the interned name, INTERN_NONE when the node was made from a
+// bare name; names with symbols compare by symbol
 
 struct ast_data_var {
   cstring name;
   usize   name_len;
+  u32     symbol;
   ast_ptr type;
 };
 
@@ -18,11 +23,24 @@ ast_ptr make_ast_var(arena a, cstring name, usize name_len, ast_ptr type) {
 
   data->name = name;
   data->name_len = name_len;
+  data->symbol = INTERN_NONE;
   data->type = type;
 
   return result;
 }
 
+inline
+ast_ptr make_ast_var(arena a, const interner* names, u32 symbol, ast_ptr type) {
+  string_slice name = intern_string(names, symbol);
+  ast_ptr result = make_ast_var(a, name.ptr, name.length, type);
+
+  ast_data_var* data = AST_NODE_DATA(ast_data_var, result);
+
+  data->symbol = symbol;
+
+  return result;
+}
+
 inline
 ast_ptr make_ast_var(arena a, cstring name, usize name_len, ast_ptr type, ast_ptr parent) {
   ast_ptr result = make_ast_var(a, name, name_len, type);
@@ -43,6 +61,7 @@ enum ast_type_category_enum {
 struct ast_data_type_atom {
   cstring name;
   usize   name_len;
+  u32     symbol;
   usize   category;
 };
 
@@ -54,11 +73,44 @@ ast_ptr make_ast_type_atom(arena a, cstring name, usize name_len, usize category
 
   data->name = name;
   data->name_len = name_len;
+  data->symbol = INTERN_NONE;
   data->category = category;  
 
   return result; 
 }
 
+inline
+ast_ptr make_ast_type_atom(arena a, const interner* names, u32 symbol, usize category) {
+  string_slice name = intern_string(names, symbol);
+  ast_ptr result = make_ast_type_atom(a, name.ptr, name.length, category);
+
+  ast_data_type_atom* data = AST_NODE_DATA(ast_data_type_atom, result);
+
+  data->symbol = symbol;
+
+  return result;
+}
+
+// same name, by symbol when both have one
+
+inline
+bool ast_same_name(cstring name_a, usize len_a, u32 symbol_a, cstring name_b, usize len_b, u32 symbol_b) {
+  if(symbol_a != INTERN_NONE && symbol_b != INTERN_NONE)
+    return symbol_a == symbol_b;
+
+  return len_a == len_b && memcmp(name_a, name_b, len_a) == 0;
+}
+
+inline
+bool ast_same_name(const ast_data_var* a, const ast_data_var* b) {
+  return ast_same_name(a->name, a->name_len, a->symbol, b->name, b->name_len, b->symbol);
+}
+
+inline
+bool ast_same_name(const ast_data_type_atom* a, const ast_data_type_atom* b) {
+  return ast_same_name(a->name, a->name_len, a->symbol, b->name, b->name_len, b->symbol);
+}
+
 inline
 cstring ast_type_atom_category_name(usize category) {
   cstring result = "nil";
@@ -11,6 +11,15 @@ int main(int argc, char** argv) {
   ast_ptr func_foo = make_ast_node(a, ast_tag_def, 0ULL, file_scope);
   ast_ptr param0 = make_ast_var(a, "x_var", 5, make_ast_type_atom(a, "u32", 3, ast_type_category_integer));
   add_last(func_foo, param0);
+
+  // the same through interned names, the type name is stored once
+
+  interner names = make_interner(a, 16U);
+  u32 u32_symbol = intern(&names, "u32");
+  ast_ptr param1 = make_ast_var(a, &names, intern(&names, "y_var"), make_ast_type_atom(a, &names, u32_symbol, ast_type_category_integer));
+  ast_ptr param2 = make_ast_var(a, &names, intern(&names, "z_var"), make_ast_type_atom(a, &names, intern(&names, "u32"), ast_type_category_integer));
+  add_last(func_foo, param1);
+  add_last(func_foo, param2);
   //make_ast_node(a, ast_tag_var, sizeof(ast_tag_var), func_foo);
   //ast_ptr param1 = make_ast_node(a, ast_tag_var, sizeof(ast_tag_var), func_foo);
   //ast_ptr ret0 = make_ast_node(a, ast_tag_var, sizeof(ast_tag_var), func_foo);
@@ -19,5 +28,12 @@ int main(int argc, char** argv) {
 
   print(file_scope);
 
+  ast_data_var* y_var = AST_NODE_DATA(ast_data_var, param1);
+  ast_data_var* z_var = AST_NODE_DATA(ast_data_var, param2);
+
+  printf("\n%u symbols, same type name: %d, same var name: %d\n", names.count,
+         ast_same_name(AST_NODE_DATA(ast_data_type_atom, y_var->type), AST_NODE_DATA(ast_data_type_atom, z_var->type)),
+         ast_same_name(y_var, z_var));
+
   return 0;
 }
\ No newline at end of file